@@ -31,7 +31,8 @@ save(sprintf('%s/venue_subgraph', data_directory), 'A', 'labels', ...
      'reverse_map');
 
 D = sum(connected);
-L = diag(D) - connected;
+% sparse: a dense diag(D) takes num_largest^2 doubles
+L = spdiags(D', 0, num_largest, num_largest) - connected;
 
 [u, s] = svds(L, num_principal_components, 'smallestnz');
 
@@ -54,6 +54,8 @@ label_oracle        = get_label_oracle(@lookup_oracle, labels);
 %% setup model
 model       = get_model(@knn_model, weights, alpha);
 model       = get_model(@model_memory_wrapper, model);
+% the native ENS scores may stand in for this model (see README.md)
+problem.use_native_ens = true;
 
 if visualize
   callback = @(problem, train_ind, observed_labels) ...
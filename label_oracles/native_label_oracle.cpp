@@ -0,0 +1,102 @@
+#include "mex.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../native/label_oracle.h"
+#include "../models/knn_mex.h"
+
+/*
+ * labels = native_label_oracle(kind, query_ind, arg, seed)
+ *
+ * Labels of all of query_ind in one call (see native/label_oracle.h),
+ * as a column vector:
+ *
+ *   'lookup'  arg: label of every point (1 for targets, 0 for none,
+ *             anything else a non-target); querying a point without a
+ *             label is an error, as for 'replay'
+ *   'replay'  arg: replay stream file; it is read once and kept until
+ *             another file is asked for, so each call only looks labels
+ *             up. Unrecorded points are an error.
+ *   'fixed'   arg: the label
+ *   'argmax', 'soft', 'sample'
+ *             arg: the probabilities of query_ind being targets; sample
+ *             draws from seed (default 0) and the point only, so the
+ *             labels do not depend on how queries are batched
+ */
+
+#define KIND_ARG      prhs[0]
+#define QUERY_IND_ARG prhs[1]
+#define ARG           prhs[2]
+#define SEED_ARG      prhs[3]
+
+#define LABELS_ARG    plhs[0]
+
+static Label_oracle replay;
+static std::string replay_path;
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  Label_oracle oracle;
+  const Label_oracle *use = &oracle;
+  const double *probs = NULL;
+  std::string error;
+  int num_queries;
+
+  if (nrhs < 3)
+    mexErrMsgIdAndTxt("native_label_oracle:nargin",
+            "at least 3 inputs required");
+
+  /* get input */
+  char *kind_string = mxArrayToString(KIND_ARG);
+  std::string kind = kind_string ? kind_string : "";
+  mxFree(kind_string);
+  std::vector<int> query = indices_from_mx(QUERY_IND_ARG);
+  num_queries = (int)query.size();
+
+  if (kind == "lookup"){
+    size_t i, n = mxGetNumberOfElements(ARG);
+    oracle.kind = LABEL_ORACLE_LOOKUP;
+    oracle.labels.assign(mxGetPr(ARG), mxGetPr(ARG) + n);
+    /* 0 marks a missing label (label_oracle.h), kept as it is */
+    for (i = 0; i < n; i++){
+      if (oracle.labels[i] != 1 && oracle.labels[i] != 0)
+        oracle.labels[i] = 2;
+    }
+  }
+  else if (kind == "replay"){
+    char *path = mxArrayToString(ARG);
+    std::string p = path ? path : "";
+    mxFree(path);
+    if (p != replay_path){
+      replay_path.clear();
+      if (!label_oracle_read_replay(replay, p.c_str(), &error))
+        mexErrMsgIdAndTxt("native_label_oracle:replay", "%s",
+                error.c_str());
+      replay_path = p;
+    }
+    use = &replay;
+  }
+  else if (kind == "fixed"){
+    oracle.kind = LABEL_ORACLE_FIXED;
+    oracle.fixed_label = mxGetScalar(ARG);
+  }
+  else if (kind == "argmax" || kind == "soft" || kind == "sample"){
+    oracle.kind = kind == "argmax" ? LABEL_ORACLE_ARGMAX :
+            kind == "soft" ? LABEL_ORACLE_SOFT : LABEL_ORACLE_SAMPLE;
+    if ((int)mxGetNumberOfElements(ARG) != num_queries)
+      mexErrMsgIdAndTxt("native_label_oracle:probs",
+              "one probability per query required");
+    probs = mxGetPr(ARG);
+    oracle.seed = (nrhs > 3 && !mxIsEmpty(SEED_ARG)) ?
+            (uint64_t)mxGetScalar(SEED_ARG) : 0;
+  }
+  else
+    mexErrMsgIdAndTxt("native_label_oracle:kind", "unknown oracle kind");
+
+  LABELS_ARG = mxCreateDoubleMatrix(num_queries, 1, mxREAL);
+  if (!label_oracle_labels(*use, query.data(), num_queries, probs,
+          mxGetPr(LABELS_ARG)))
+    mexErrMsgIdAndTxt("native_label_oracle:missing",
+            "no label for one of the queried points");
+}
@@ -0,0 +1,46 @@
+% READ_REPLAY_STREAM reads a stream of recorded observations.
+%
+% This reads a replay stream (see REPLAY_ORACLE) the way
+% native/label_oracle.h does: one observation per line, "point label",
+% separated by commas or white space, with blank lines and lines starting
+% with % or # skipped and any fields after the label ignored. A point
+% recorded twice keeps its last label.
+%
+% Usage:
+%
+%   recorded = read_replay_stream(replay_file)
+%
+% Input:
+%
+%   replay_file: the recorded stream
+%
+% Output:
+%
+%   recorded: the recorded label of every point up to the largest one in
+%             the stream (1 for targets, 2 otherwise, 0 if unrecorded)
+%
+% See also REPLAY_ORACLE.
+
+function recorded = read_replay_stream(replay_file)
+
+  f = fopen(replay_file, 'r');
+  if f < 0
+    error('replay_oracle:open', 'cannot open %s', replay_file);
+  end
+  lines = textscan(f, '%s', 'Delimiter', '\n', 'Whitespace', '');
+  fclose(f);
+
+  % drop the comments by hand: textscan reads a pair of CommentStyle
+  % markers as the start and end of a block comment
+  lines = strtrim(lines{1});
+  lines = lines(~cellfun(@isempty, lines) & ~startsWith(lines, {'%', '#'}));
+  data = textscan(strjoin(lines, '\n'), '%f %f %*[^\n]', ...
+    'Delimiter', {',', ' ', '\t'}, 'MultipleDelimsAsOne', true);
+
+  points = data{1};
+  labels = 2 * ones(size(points));
+  labels(data{2} == 1) = 1;
+  recorded = zeros(max([points; 0]), 1);
+  recorded(points) = labels;  % the last observation of a point wins
+
+end
@@ -0,0 +1,61 @@
+% REPLAY_ORACLE label oracle replaying recorded observations.
+%
+% This provides a label oracle that answers every query with the label
+% recorded for the point in a stream on disk, e.g. the results of a
+% screening campaign, so that policies can be re-simulated offline. The
+% stream is a text file with one observation per line, "point label"
+% (1-based point, label 1 for targets; lines starting with % or # are
+% skipped, see native/label_oracle.h). A point recorded twice keeps its
+% last label.
+%
+% Usage:
+%
+%   label = replay_oracle(problem, train_ind, observed_labels, ...
+%                         query_ind, replay_file)
+%
+% Inputs:
+%
+%           problem: a struct describing the problem (unused)
+%         train_ind: a list of indices into problem.points indicating
+%                    the thus-far observed points (unused)
+%   observed_labels: a list of labels corresponding to the
+%                    observations in train_ind (unused)
+%         query_ind: an index into problem.points specifying the
+%                    point(s) to be queried
+%       replay_file: the recorded stream
+%
+% Output:
+%
+%   label: the recorded labels of query_ind (1 or 2), in one call for a
+%          whole batch; querying an unrecorded point is an error
+%
+% With label_oracles/native_label_oracle.cpp compiled the stream is read
+% once natively and kept between calls.
+%
+% Example:
+%
+%   label_oracle = get_label_oracle(@replay_oracle, 'screen.txt');
+%
+% See also LABEL_ORACLES, FIXED_ORACLE, READ_REPLAY_STREAM.
+
+function label = replay_oracle(~, ~, ~, query_ind, replay_file)
+
+  if exist('native_label_oracle', 'file') == 3
+    label = native_label_oracle('replay', query_ind, replay_file);
+    return;
+  end
+
+  persistent recorded recorded_file
+  if ~isequal(recorded_file, replay_file)
+    recorded = read_replay_stream(replay_file);
+    recorded_file = replay_file;
+  end
+
+  query_ind = query_ind(:);
+  if any(query_ind > numel(recorded)) || any(recorded(query_ind) == 0)
+    error('replay_oracle:missing', ...
+      'no label recorded for one of the queried points');
+  end
+  label = recorded(query_ind);
+
+end
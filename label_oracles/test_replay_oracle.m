@@ -0,0 +1,34 @@
+%% test the native replay stream reader against read_replay_stream
+%% Writes a stream with commas, tabs, repeated points, blank lines and % and
+%% # comment lines, and compares native_label_oracle('replay', ...) (see
+%% native/label_oracle.h, compiled from label_oracles/native_label_oracle.cpp)
+%% with the Matlab reader on every recorded point
+rng(2019);
+n = 50;
+file = [tempname '.txt'];
+comments = {'% header', '# 7 1', '  % 3,1', sprintf('\t# note'), '%', ...
+  '#', '', '   '};
+separators = {' ', ',', sprintf('\t'), ', ', '  '};
+want = zeros(n, 1);
+f = fopen(file, 'w');
+for i = 1:3*n
+  if randi(3) == 1
+    fprintf(f, '%s\n', comments{randi(numel(comments))});
+    continue;
+  end
+  point = randi(n);
+  label = randi(2);
+  fprintf(f, '%d%s%d\n', point, separators{randi(numel(separators))}, label);
+  want(point) = label;
+end
+fclose(f);
+
+recorded = read_replay_stream(file);
+recorded(end+1:n) = 0;
+points = find(want);
+native = native_label_oracle('replay', points, file);
+delete(file);
+fprintf('%d mismatches with the recorded labels\n', ...
+  sum(recorded ~= want));
+fprintf('%d mismatches between the native and the Matlab reader\n', ...
+  sum(native ~= recorded(points)));
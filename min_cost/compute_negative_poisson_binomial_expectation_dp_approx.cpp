@@ -31,7 +31,9 @@ void mexFunction(int nlhs,       mxArray *plhs[],
   n = mxGetNumberOfElements(Q_ARG);
   m = mxGetNumberOfElements(P_ARG);
   
-  double *pp = new double[m-1];
+  /* kept across calls, so a selection step allocates nothing */
+  static Npb_workspace ws;
+  double *pp = npb_workspace_probs(ws, m-1);
   i = 0;
   j = 0;
   ii = 0;
@@ -68,8 +70,7 @@ void mexFunction(int nlhs,       mxArray *plhs[],
     mexPrintf("ii %d\n", ii);
   }
   
-  expectation = approx_exp_of_neg_poisson_binom(m-1, pp, remaining_goal, 
+  expectation = approx_exp_of_neg_poisson_binom(ws, m-1, pp, remaining_goal, 
           approx_one);
-  delete pp;
   EXP_ARG = mxCreateDoubleScalar(expectation);
 }
\ No newline at end of file
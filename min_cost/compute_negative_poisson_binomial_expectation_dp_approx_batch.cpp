@@ -0,0 +1,79 @@
+#include "mex.h"
+#include "math.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "npb_batch.h"
+
+/*
+ * expectations = compute_negative_poisson_binomial_expectation_dp_approx_batch(
+ *     p, excluded, q, remaining_goals, approx_one)
+ *
+ * Batched version of compute_negative_poisson_binomial_expectation_dp_approx:
+ * p holds the current probabilities in descending order, and query i
+ * removes the coins p(excluded{i}), merges in the coins q{i}, and asks
+ * for the expected number of coins to get remaining_goals(i) heads.
+ * The DP over the shared part of p is done once (see npb_batch.h) and
+ * kept until a call with another p or approx_one, so a caller can split
+ * its queries into several calls (e.g. to prune in between) at no extra
+ * cost; "clear" the mex to free it.
+ */
+
+#define P_ARG          prhs[0]
+#define EXCLUDED_ARG   prhs[1]
+#define Q_ARG          prhs[2]
+#define REM_GOALS_ARG  prhs[3]
+#define APPROX_ONE     prhs[4]
+
+#define EXP_ARG        plhs[0]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *p, *rem_goals, approx_one;
+  int n, num_queries, i, j;
+
+  if (nrhs < 5)
+    mexErrMsgIdAndTxt("npb_batch:nargin", "5 inputs required");
+  if (!mxIsCell(EXCLUDED_ARG) || !mxIsCell(Q_ARG))
+    mexErrMsgIdAndTxt("npb_batch:cell", "excluded and q must be cell arrays");
+
+  /* get input */
+  p = mxGetPr(P_ARG);
+  n = (int)mxGetNumberOfElements(P_ARG);
+  rem_goals = mxGetPr(REM_GOALS_ARG);
+  num_queries = (int)mxGetNumberOfElements(REM_GOALS_ARG);
+  approx_one = (double)(mxGetScalar(APPROX_ONE));
+
+  /* copy queries into 0-based, sorted form */
+  std::vector<std::vector<int> > excluded(num_queries);
+  std::vector<std::vector<double> > q(num_queries);
+  std::vector<Npb_query> queries(num_queries);
+  for (i = 0; i < num_queries; i++){
+    const mxArray *ex = mxGetCell(EXCLUDED_ARG, i);
+    const mxArray *qi = mxGetCell(Q_ARG, i);
+    if (ex){
+      double *ex_pr = mxGetPr(ex);
+      for (j = 0; j < (int)mxGetNumberOfElements(ex); j++)
+        excluded[i].push_back((int)ex_pr[j] - 1);
+      std::sort(excluded[i].begin(), excluded[i].end());
+      excluded[i].erase(std::unique(excluded[i].begin(), excluded[i].end()),
+              excluded[i].end());
+    }
+    if (qi){
+      double *q_pr = mxGetPr(qi);
+      q[i].assign(q_pr, q_pr + mxGetNumberOfElements(qi));
+      std::sort(q[i].begin(), q[i].end(), std::greater<double>());
+    }
+    queries[i].excluded = excluded[i].data();
+    queries[i].num_excluded = (int)excluded[i].size();
+    queries[i].q = q[i].data();
+    queries[i].num_q = (int)q[i].size();
+    queries[i].num_heads = (int)rem_goals[i];
+  }
+
+  static Npb_batch_bases bases;  /* kept across calls */
+  EXP_ARG = mxCreateDoubleMatrix(num_queries, 1, mxREAL);
+  npb_expectations_batch(bases, p, n, queries.data(), num_queries, approx_one,
+          mxGetPr(EXP_ARG));
+}
@@ -21,7 +21,8 @@ void mexFunction(int nlhs,       mxArray *plhs[],
   approx_one = (double)(mxGetScalar(APPROX_ONE));  // 1 for dp, 2 for Monte Carlo
   m = mxGetNumberOfElements(P_ARG);
 
-  expectation = approx_exp_of_neg_poisson_binom(m-1, p, remaining_goal, 
+  static Npb_workspace ws;  /* kept across calls */
+  expectation = approx_exp_of_neg_poisson_binom(ws, m-1, p, remaining_goal, 
           approx_one);
 
   EXP_ARG = mxCreateDoubleScalar(expectation);
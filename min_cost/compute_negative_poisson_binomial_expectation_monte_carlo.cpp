@@ -2,6 +2,19 @@
 #include "math.h"
 #include <random>
 #include "negative_binomial_distribution.h"
+#include "npb_monte_carlo.h"
+
+/*
+ * [expectation, std_error, num_samples] =
+ *   compute_negative_poisson_binomial_expectation_monte_carlo(p, q,
+ *   top_ind, remaining_goal, method, num_samples, ci_half_width,
+ *   num_threads, seed)
+ *
+ * method 1 is the DP, 2 Monte Carlo with at most num_samples samples,
+ * stopping once the 95% confidence interval is within ci_half_width
+ * (default 0: all samples), on num_threads threads (default all cores)
+ * with the given seed (default 1); see npb_monte_carlo.h.
+ */
 
 #define P_ARG       prhs[0]
 #define Q_ARG       prhs[1]
@@ -10,6 +23,11 @@
 #define EXP_ARG     plhs[0]
 #define METHOD      prhs[4]
 #define NUM_SAMPLE  prhs[5]
+#define CI_ARG      prhs[6]
+#define THREADS_ARG prhs[7]
+#define SEED_ARG    prhs[8]
+#define STD_ERR_ARG plhs[1]
+#define SAMPLES_ARG plhs[2]
 #define P_IND ((int)(top_ind[j]) - 1)
 
 void mexFunction(int nlhs,       mxArray *plhs[],
@@ -29,7 +47,9 @@ void mexFunction(int nlhs,       mxArray *plhs[],
   n = mxGetNumberOfElements(Q_ARG);
   m = mxGetNumberOfElements(P_ARG);
   
-  double *pp = new double[m-1];
+  /* kept across calls, so a selection step allocates nothing */
+  static Npb_workspace ws;
+  double *pp = npb_workspace_probs(ws, m-1);
   i = 0;
   j = 0;
   ii = 0;
@@ -66,19 +86,29 @@ void mexFunction(int nlhs,       mxArray *plhs[],
     mexPrintf("ii %d\n", ii);
   }
   
-  double expectation = 0;
+  double expectation = 0, std_error = 0;
+  int num_samples = 0;
   if (method == 1){
     Neg_poisson_binomial_dist dist;
     double approx_one = 1-1e-9;
-    dist = approx_pmf_of_neg_poisson_binom(m-1, pp, remaining_goal, 
+    dist = approx_pmf_of_neg_poisson_binom(ws, m-1, pp, remaining_goal, 
             approx_one);
     expectation = dist.expectation;
   }
   else if (method == 2){
     // Monte Carlo
-    int num_samples = (int)(mxGetScalar(NUM_SAMPLE));
-    expectation = expectation_of_neg_poisson_binom(m-1, pp, remaining_goal,
-        2, num_samples, 1);
+    double ci_half_width = nrhs > 6 ? mxGetScalar(CI_ARG) : 0;
+    int num_threads = nrhs > 7 ? (int)mxGetScalar(THREADS_ARG) : 0;
+    uint64_t seed = nrhs > 8 ? (uint64_t)mxGetScalar(SEED_ARG) : 1;
+    Npb_mc_result res = npb_monte_carlo(m-1, pp, remaining_goal,
+        (int)(mxGetScalar(NUM_SAMPLE)), seed, ci_half_width, num_threads);
+    expectation = res.expectation;
+    std_error = res.std_error;
+    num_samples = res.num_samples;
   }
   EXP_ARG = mxCreateDoubleScalar(expectation);
+  if (nlhs > 1)
+    STD_ERR_ARG = mxCreateDoubleScalar(std_error);
+  if (nlhs > 2)
+    SAMPLES_ARG = mxCreateDoubleScalar(num_samples);
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "mex.h"
+#include "math.h"
+#include <cstring>
+#include "npb_normal.h"
+
+/*
+ * [expectation, error, used_dp] =
+ *   compute_negative_poisson_binomial_expectation_normal(p, remaining_goal,
+ *   tolerance, approx_one)
+ *
+ * Same arguments and coins as
+ * compute_negative_poisson_binomial_expectation_dp_approx_direct, but
+ * answered by the Edgeworth approximation of npb_normal.h: O(n) for the
+ * prefix sums of p (built every call, as p changes between calls), then
+ * O(log n). If its estimated error is more than tolerance times the
+ * expectation, the DP with approx_one is used instead (error 0, used_dp
+ * true).
+ *
+ * [bound, ~, used_dp] = compute_negative_poisson_binomial_expectation_normal(
+ *   p, remaining_goal, tolerance, approx_one, 'bound')
+ *
+ * gives a rigorous lower bound on the DP instead (npb_normal_lower_bound,
+ * O(n)), or the DP itself if the bound is more than tolerance times the
+ * approximation below it.
+ */
+
+#define P_ARG       prhs[0]
+#define REM_GOAL    prhs[1]
+#define TOL_ARG     prhs[2]
+#define APPROX_ONE  prhs[3]
+#define MODE_ARG    prhs[4]
+
+#define EXP_ARG     plhs[0]
+#define ERROR_ARG   plhs[1]
+#define USED_DP_ARG plhs[2]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *p, tolerance, approx_one, expectation, error;
+  int remaining_goal, m;
+  bool used_dp, bound = false;
+
+  if (nrhs < 4)
+    mexErrMsgIdAndTxt("npb_normal:nargin",
+            "p, remaining_goal, tolerance and approx_one required");
+  p = mxGetPr(P_ARG);
+  remaining_goal = (int)(mxGetScalar(REM_GOAL));
+  tolerance = mxGetScalar(TOL_ARG);
+  approx_one = mxGetScalar(APPROX_ONE);
+  m = mxGetNumberOfElements(P_ARG);
+  if (nrhs > 4){
+    char *mode = mxArrayToString(MODE_ARG);
+    bound = mode && strcmp(mode, "bound") == 0;
+    mxFree(mode);
+    if (!bound)
+      mexErrMsgIdAndTxt("npb_normal:mode", "unknown mode");
+  }
+
+  static Npb_workspace ws;  /* kept across calls */
+  Npb_prefix_sums sums;
+  npb_prefix_sums_init(sums, p, m-1);
+  if (bound){
+    expectation = npb_lower_bound_with_fallback(ws, sums, p, remaining_goal,
+            tolerance, approx_one, &used_dp);
+    error = 0;
+  }
+  else
+    expectation = npb_expectation_with_fallback(ws, sums, p,
+            remaining_goal, tolerance, approx_one, &error, &used_dp);
+
+  EXP_ARG = mxCreateDoubleScalar(expectation);
+  if (nlhs > 1)
+    ERROR_ARG = mxCreateDoubleScalar(error);
+  if (nlhs > 2)
+    USED_DP_ARG = mxCreateLogicalScalar(used_dp);
+}
@@ -1,7 +1,14 @@
+#ifndef NEGATIVE_BINOMIAL_DISTRIBUTION_H
+#define NEGATIVE_BINOMIAL_DISTRIBUTION_H
+
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include <iostream>
+#include "poisson_binomial_row.h"
+#include "npb_product_tree.h"
 
-double* pmf_of_poisson_binom(int n, double *probs, int num_heads)
+inline double* pmf_of_poisson_binom(int n, double *probs, int num_heads)
 {
   /* compute probability table of Poisson binomial distribution */
   
@@ -16,35 +23,29 @@ double* pmf_of_poisson_binom(int n, double *probs, int num_heads)
   
   double log_cumprod = log(1 - probs[0]);
   
-  p_table[0] = 1;  /* toss one coin, get one head with probability 1 */
+  /* toss zero coins, get zero heads with probability 1 */
+  p_table[0] = 1;
+  for (j = 1; j < N_COL; j++){
+    p_table[j] = 0;
+  }
   
   for (i = 1; i < N_ROW; i++){
+    /*
+     * toss i coins, get j heads (j >= 1)
+     * probability can be computed as follows:
+     * Pr(the i-th coin is head) * Pr(first i-1 coins with j-1 heads)
+     * + Pr(the i-th coin is tail) * Pr(first i-1 coins with j heads)
+     * (this is zero when j > i, i.e. more heads than coins)
+     */
+    poisson_binomial_row(p_table + i*N_COL, p_table + (i-1)*N_COL, N_COL,
+            probs[i-1]);
     /*
      * toss i coins with 0 head,
      * probability is product of (1-p_k), k=1..i
      */
     p_table[i*N_COL] = exp(log_cumprod);
-    log_cumprod += log(1 - probs[i]);
-  }
-  
-  for (j = 1; j < N_COL; j++){
-    for (i = 0; i < j; i++){
-      /*
-       * when tossing i coins,
-       * it's not possible to get more than i heads, hence zero prob
-       */
-      p_table[i*N_COL+j] = 0;
-    }
-    for (i = j; i < N_ROW; i++){
-      /*
-       * toss i coins, get j heads (j >= i)
-       * probability can be computed as follows:
-       * Pr(the i-th coin is head) * Pr(first i-1 coins with j-1 heads)
-       * + Pr(the i-th coin is tail) * Pr(first i-1 coins with j heads)
-       */
-      p_table[i*N_COL+j] = probs[i-1] * p_table[(i-1)*N_COL+j-1] +
-              (1 - probs[i-1]) * p_table[(i-1)*N_COL+j];
-    }
+    if (i < n)
+      log_cumprod += log(1 - probs[i]);
   }
   return p_table;
 }
@@ -58,63 +59,135 @@ struct Neg_poisson_binomial_dist{
   int max_increment = n;
 };
 
-Neg_poisson_binomial_dist approx_pmf_of_neg_poisson_binom(int n, 
-        double *probs, int num_heads, double approx_one)
+/*
+ * Reusable scratch memory for the dynamic programs below.
+ *
+ * The buffers only grow, so a workspace that is kept alive across calls
+ * (e.g. a static one in a mex file) allocates nothing once it has seen
+ * the largest goal of a selection step.
+ */
+const size_t NPB_ALIGNMENT = 64;  /* cache line, enough for AVX-512 */
+
+inline double* npb_aligned_alloc(size_t count)
+{
+  /* stash the offset right before the aligned pointer */
+  char *raw = new char[count * sizeof(double) + NPB_ALIGNMENT];
+  size_t offset = NPB_ALIGNMENT - ((size_t)raw % NPB_ALIGNMENT);
+  raw[offset - 1] = (char)offset;
+  return (double*)(raw + offset);
+}
+
+inline void npb_aligned_free(double *ptr)
 {
-  /* compute approximate negative Poisson binomial distribution */
+  if (ptr == NULL) return;
+  char *aligned = (char*)ptr;
+  delete [] (aligned - (unsigned char)aligned[-1]);
+}
+
+struct Npb_workspace{
+  int max_heads = -1;        /* p_old and p_new hold max_heads+1 values */
+  int max_pmf = 0;           /* pm holds max_pmf values */
+  int max_probs = 0;         /* probs holds max_probs values */
+  double *p_old = NULL;
+  double *p_new = NULL;
+  double *pm = NULL;
+  double *probs = NULL;      /* for callers merging their own coin list */
+
+  Npb_workspace() {}
+  Npb_workspace(const Npb_workspace&) = delete;
+  Npb_workspace& operator=(const Npb_workspace&) = delete;
+  ~Npb_workspace(){
+    npb_aligned_free(p_old);
+    npb_aligned_free(p_new);
+    npb_aligned_free(pm);
+    npb_aligned_free(probs);
+  }
+};
+
+inline void npb_workspace_reserve(Npb_workspace &ws, int n,
+        int num_heads)
+{
+  /* make sure the DP of n coins and num_heads heads fits */
+  if (num_heads > ws.max_heads){
+    npb_aligned_free(ws.p_old);
+    npb_aligned_free(ws.p_new);
+    ws.p_old = npb_aligned_alloc(num_heads+1);
+    ws.p_new = npb_aligned_alloc(num_heads+1);
+    ws.max_heads = num_heads;
+  }
+  if (n - num_heads + 1 > ws.max_pmf){
+    npb_aligned_free(ws.pm);
+    ws.pm = npb_aligned_alloc(n - num_heads + 1);
+    ws.max_pmf = n - num_heads + 1;
+  }
+}
+
+inline double* npb_workspace_probs(Npb_workspace &ws, int n)
+{
+  /* scratch vector of n coin probabilities */
+  if (n > ws.max_probs){
+    npb_aligned_free(ws.probs);
+    ws.probs = npb_aligned_alloc(n);
+    ws.max_probs = n;
+  }
+  return ws.probs;
+}
+
+inline Neg_poisson_binomial_dist approx_pmf_of_neg_poisson_binom(
+        Npb_workspace &ws, int n, double *probs, int num_heads,
+        double approx_one)
+{
+  /*
+   * compute approximate negative Poisson binomial distribution
+   * (the returned pmf lives in ws and is valid until its next use)
+   */
+  npb_workspace_reserve(ws, n, num_heads);
 
   /* define arrays to store the dynamic programming table 
    * alternate to save memory
    */
-  double *p_old = new double[num_heads+1];
-  double *p_new = new double[num_heads+1];
+  double *p_old = ws.p_old;
+  double *p_new = ws.p_new;
   double *tmp;  /* for swapping */
   
-  double *pm = new double[n-num_heads+1];
-  int n_heads, n_coins, increment;
+  double *pm = ws.pm;
+  int n_heads, n_coins, increment = n - num_heads + 1;
   double expectation = 0;
   
   double npb_sum = 0;  /* cumulative sum of probabilities */
 
-  p_old[0] = 1;  /* toss one coin, get one head with probability 1 */
-
-  for (n_heads = 1; n_heads <= num_heads; n_heads++){
-    /*
-     * toss i coins with i heads,
-     * probability is product of p_k, k=1..i
-     */
-    p_old[n_heads] = p_old[n_heads-1] * probs[n_heads-1];
+  /*
+   * p_old[n_heads] is the probability of n_heads heads (< num_heads)
+   * with the coins tossed so far; go through the coins one by one so
+   * each step is a vectorized row update (see poisson_binomial_row.h)
+   */
+  for (n_heads = 0; n_heads < num_heads; n_heads++){
+    p_old[n_heads] = p_new[n_heads] = 0;
   }
+  p_old[0] = 1;  /* toss zero coins, get zero heads with probability 1 */
   
-  pm[0] = p_old[num_heads];
-  expectation += pm[0] * num_heads;
-  npb_sum += pm[0];
-  
-  for (increment = 1; increment <= n - num_heads; increment++){
-    
-    p_new[0] = p_old[0] * (1 - probs[increment-1]);
-    
-    for (n_heads = 1; n_heads < num_heads; n_heads++){
-      /* 
-       * If Pr(n, r) denote the probability of n coins with r heads, then
-       * p_new[n_heads] is Pr(n_heads+increment,   n_heads)
-       * p_old[n_heads] is Pr(n_heads+increment-1, n_heads)
+  for (n_coins = 1; n_coins <= n; n_coins++){
+    if (n_coins >= num_heads){
+      /*
+       * the n_coins-th coin is the num_heads-th head:
+       * it is a head, and the previous coins gave num_heads-1 heads
        */
-      n_coins = n_heads + increment;
-      p_new[n_heads] = probs[n_coins-1] * p_new[n_heads-1] + 
-              (1-probs[n_coins-1]) * p_old[n_heads];
+      increment = n_coins - num_heads;
+      pm[increment] = probs[n_coins-1] * p_old[num_heads-1];
+      expectation += pm[increment] * n_coins;
+      npb_sum += pm[increment];
+      if (increment > 0 && npb_sum > approx_one)
+        break;
+      increment = n - num_heads + 1;
     }
     
-    pm[increment] = probs[num_heads+increment-1] * p_new[num_heads-1];
-    expectation += pm[increment] * (num_heads + increment);
+    p_new[0] = p_old[0] * (1 - probs[n_coins-1]);
+    poisson_binomial_row(p_new, p_old, std::min(n_coins+1, num_heads),
+            probs[n_coins-1]);
     
     tmp = p_old;
     p_old = p_new;
     p_new = tmp;
-    
-    npb_sum += pm[increment];
-    if (npb_sum > approx_one)
-      break;
   }
   Neg_poisson_binomial_dist res;
   res.n = n;
@@ -125,98 +198,133 @@ Neg_poisson_binomial_dist approx_pmf_of_neg_poisson_binom(int n,
   res.approx_one = approx_one;
   res.max_increment = increment;
   
-  delete p_old;
-  delete p_new;
-  delete pm;
-  
   return res;
 }
 
-double approx_exp_of_neg_poisson_binom(int n, 
+inline Neg_poisson_binomial_dist approx_pmf_of_neg_poisson_binom(int n, 
         double *probs, int num_heads, double approx_one)
 {
-  /* compute approximate negative Poisson binomial distribution */
-
-  /* define arrays to store the dynamic programming table 
-   * alternate to save memory
+  /*
+   * same as above with a one-off workspace; the returned pmf is a copy
+   * owned by the caller (free with delete [])
    */
-  double *p_old = new double[num_heads+1];
-  double *p_new = new double[num_heads+1];
-  double *tmp;  /* for swapping */
-  
-  double pm;
-  int n_heads, n_coins, increment;
-  double expectation = 0;
-  
-  double npb_sum = 0;  /* cumulative sum of probabilities */
+  Npb_workspace ws;
+  Neg_poisson_binomial_dist res = approx_pmf_of_neg_poisson_binom(ws, n,
+          probs, num_heads, approx_one);
+  double *pmf = new double[n-num_heads+1];
+  for (int i = 0; i <= res.max_increment && i <= n - num_heads; i++){
+    pmf[i] = res.pmf[i];
+  }
+  res.pmf = pmf;
+  return res;
+}
 
-  p_old[0] = 1;  /* toss one coin, get one head with probability 1 */
+struct Npb_dp_state{
+  int n_coins = 0;         /* number of coins tossed so far */
+  double expectation = 0;  /* accumulated expectation */
+  double npb_sum = 0;      /* cumulative sum of probabilities */
+  bool done = false;       /* npb_sum exceeded approx_one */
+};
 
-  for (n_heads = 1; n_heads <= num_heads; n_heads++){
-    /*
-     * toss i coins with i heads,
-     * probability is product of p_k, k=1..i
-     */
-    p_old[n_heads] = p_old[n_heads-1] * probs[n_heads-1];
+inline void npb_dp_start(Npb_workspace &ws, Npb_dp_state &st,
+        int num_heads)
+{
+  /* toss zero coins, get zero heads with probability 1 */
+  npb_workspace_reserve(ws, 0, num_heads);
+  for (int n_heads = 0; n_heads < num_heads; n_heads++){
+    ws.p_old[n_heads] = ws.p_new[n_heads] = 0;
   }
+  ws.p_old[0] = 1;
+  st = Npb_dp_state();
+}
+
+template <typename Coins, typename Checkpoint>
+void npb_dp_advance(Npb_workspace &ws, Npb_dp_state &st, Coins next_coin,
+        int n, int num_heads, double approx_one, Checkpoint checkpoint)
+{
+  /*
+   * continue the coin-by-coin dynamic program of approx_exp_of_neg_poisson_binom
+   * until n coins are tossed or the probabilities sum to approx_one;
+   * ws.p_old holds the probabilities of 0..num_heads-1 heads so far,
+   * next_coin() returns the probability of the next coin, and
+   * checkpoint(st, ws.p_old) is called before every toss
+   */
+  double p, pm;
+  int n_coins;
   
-  expectation += p_old[num_heads] * num_heads;
-  npb_sum += p_old[num_heads];
-  
-  for (increment = 1; increment <= n - num_heads; increment++){
-    
-    p_new[0] = p_old[0] * (1 - probs[increment-1]);
-    
-    for (n_heads = 1; n_heads < num_heads; n_heads++){
-      /* 
-       * If Pr(n, r) denote the probability of n coins with r heads, then
-       * p_new[n_heads] is Pr(n_heads+increment,   n_heads)
-       * p_old[n_heads] is Pr(n_heads+increment-1, n_heads)
-       */
-      n_coins = n_heads + increment;
-      p_new[n_heads] = probs[n_coins-1] * p_new[n_heads-1] + 
-              (1-probs[n_coins-1]) * p_old[n_heads];
+  while (!st.done && st.n_coins < n){
+    checkpoint(st, (const double*)ws.p_old);
+    p = next_coin();
+    n_coins = st.n_coins + 1;
+    if (n_coins >= num_heads){
+      pm = p * ws.p_old[num_heads-1];
+      st.expectation += pm * n_coins;
+      st.npb_sum += pm;
+      if (n_coins > num_heads && st.npb_sum > approx_one){
+        st.done = true;
+        break;
+      }
     }
     
-    pm = probs[num_heads+increment-1] * p_new[num_heads-1];
-    expectation += pm * (num_heads + increment);
-    
-    tmp = p_old;
-    p_old = p_new;
-    p_new = tmp;
-    
-    npb_sum += pm;
-    if (npb_sum > approx_one)
-      break;
+    ws.p_new[0] = ws.p_old[0] * (1 - p);
+    poisson_binomial_row(ws.p_new, ws.p_old, std::min(n_coins+1, num_heads),
+            p);
+    std::swap(ws.p_old, ws.p_new);
+    st.n_coins = n_coins;
   }
+}
 
-  delete p_old;
-  delete p_new;
+inline double approx_exp_of_neg_poisson_binom(Npb_workspace &ws, int n, 
+        double *probs, int num_heads, double approx_one)
+{
+  /* compute approximate expectation of negative Poisson binomial distribution */
+  if (num_heads <= 0)
+    return 0;  /* nothing to find */
+  /* exact answer asked for a large goal: see npb_product_tree.h */
+  if (approx_one >= 1 && npb_use_product_tree(n, num_heads))
+    return npb_product_tree_expectation(n, probs, num_heads);
   
-  return expectation;
+  /* same coin-by-coin dynamic program as approx_pmf_of_neg_poisson_binom */
+  Npb_dp_state st;
+  npb_dp_start(ws, st, num_heads);
+  npb_dp_advance(ws, st, [&probs](){ return *probs++; }, n, num_heads,
+          approx_one, [](const Npb_dp_state&, const double*){});
+  return st.expectation;
 }
 
-double* pmf_of_neg_poisson_binom(int n, double *probs, int num_heads)
+inline double approx_exp_of_neg_poisson_binom(int n, 
+        double *probs, int num_heads, double approx_one)
 {
-  /* compute negative Poisson binomial distribution */
-  
-  double *p_table = pmf_of_poisson_binom(n, probs, num_heads);
+  Npb_workspace ws;
+  return approx_exp_of_neg_poisson_binom(ws, n, probs, num_heads, approx_one);
+}
+
+inline double* pmf_of_neg_poisson_binom(int n, double *probs, int num_heads)
+{
+  /*
+   * compute negative Poisson binomial distribution: pgnb[i-num_heads] is
+   * the probability of tossing i coins (i >= num_heads) to get
+   * "num_heads" heads, i.e. Pr(the i-th coin is head) * Pr(the first i-1
+   * coins with "num_heads-1" heads); freed by the caller (delete [])
+   *
+   * The DP keeps one row of the table of pmf_of_poisson_binom at a time,
+   * so memory is O(n) instead of O(n num_heads); large goals go to the
+   * product tree of npb_product_tree.h instead.
+   */
   double *pgnb = new double[n-num_heads+1];
-  int N_COL = num_heads+1;
-  for (int i = num_heads; i <= n; i++){
-    /*
-     * to get "num_heads" heads
-     * the probability of tossing i coins is (i>=num_heads):
-     * (note the i-th coin must be head)
-     * Pr(the i-th coin is head) * Pr(the first i-1 coins with
-     * "num_heads-1" heads)
-     */
-    pgnb[i-num_heads] = probs[i-1]*p_table[(i-1)*N_COL+num_heads-1];
+  if (npb_use_product_tree(n, num_heads)){
+    npb_product_tree_pmf(n, probs, num_heads, pgnb);
+    return pgnb;
   }
+  Npb_workspace ws;
+  /* approx_one = INFINITY: toss all n coins */
+  Neg_poisson_binomial_dist dist = approx_pmf_of_neg_poisson_binom(ws, n,
+          probs, num_heads, INFINITY);
+  std::copy(dist.pmf, dist.pmf + (n-num_heads+1), pgnb);
   return pgnb;
 }
 
-double* generate_uniform_random_vector(int n, int seed){
+inline double* generate_uniform_random_vector(int n, int seed){
   std::default_random_engine generator;
   generator.seed(seed);
   std::uniform_real_distribution<double> uniform(0.0, 1.0);
@@ -227,7 +335,7 @@ double* generate_uniform_random_vector(int n, int seed){
   return probs;
 }
 
-int* sample_from_neg_poisson_binom(int n, double *probs,
+inline int* sample_from_neg_poisson_binom(int n, double *probs,
         int num_heads, int num_samples, int seed){
   /*
    * return samples from a negative Poisson binomial distribution (NPBD)
@@ -243,7 +351,9 @@ int* sample_from_neg_poisson_binom(int n, double *probs,
    *  num_samples: number of Monte Carlo samples
    *
    * Returns:
-   *  samples: samples of the given NPBD
+   *  samples: samples of the given NPBD, 0 where the n coins do not give
+   *           num_heads heads (see npb_monte_carlo.h for a parallel
+   *           version)
    */
   
   int count_heads, i, j;
@@ -256,6 +366,7 @@ int* sample_from_neg_poisson_binom(int n, double *probs,
   
   for (i = 0; i < num_samples; i++){
     count_heads = 0;
+    samples[i] = 0;
     for (j = 0; j < n; j++){
       rand_num = uniform(generator);
       if (rand_num <= probs[j]){
@@ -271,8 +382,8 @@ int* sample_from_neg_poisson_binom(int n, double *probs,
   return samples;
 }
 
-double expectation_of_neg_poisson_binom(int n, double *probs, int num_heads, 
-        int method, int num_samples, int seed)
+inline double expectation_of_neg_poisson_binom(int n, double *probs,
+        int num_heads, int method, int num_samples, int seed)
 {
   /* compute expectation of negative Poisson binomial distribution */
   
@@ -282,6 +393,7 @@ double expectation_of_neg_poisson_binom(int n, double *probs, int num_heads,
     for (int i = num_heads; i <= n; i++){
       expectation += pgnb[i-num_heads] * double(i);
     }
+    delete [] pgnb;
   }
   else if (method == 2){
     int *samples = sample_from_neg_poisson_binom(n, probs, num_heads, 
@@ -290,7 +402,9 @@ double expectation_of_neg_poisson_binom(int n, double *probs, int num_heads,
       expectation += (double)samples[i];
     }
     expectation /= (double)num_samples;
+    delete [] samples;
   }
   return expectation;
 }
 
+#endif
@@ -0,0 +1,196 @@
+#ifndef NPB_BATCH_H
+#define NPB_BATCH_H
+
+/*
+ * Batched expectations of negative Poisson binomial distributions that
+ * all share one base list of coins.
+ *
+ * In ens_min_cost.m every candidate asks for the expectation over the
+ * current probabilities (sorted in descending order) with a few coins
+ * removed (the candidate and the points it influences) and a few new
+ * coins merged in (their fictional probabilities q). Until the first
+ * removed or inserted coin, the merged list is the same as the base
+ * list, so is the dynamic program. We therefore run the DP over the base
+ * list once per goal, keeping its state every "stride" coins, and each
+ * query restarts from the last checkpoint before its first difference.
+ * If the base DP has already reached approx_one before that point, the
+ * answer is the base answer and no DP is needed at all.
+ *
+ * A caller that asks in several batches over the same base list (as
+ * ens_min_cost.m does, to prune between batches) keeps the base DPs in
+ * an Npb_batch_bases: they are only recomputed when the list or
+ * approx_one change, so each step runs one base DP per goal in total.
+ *
+ * Results are identical to calling approx_exp_of_neg_poisson_binom on
+ * each merged list, which is what
+ * compute_negative_poisson_binomial_expectation_dp_approx.cpp does
+ * (up to rounding when approx_one >= 1 and the goal is large enough for
+ * that to use the product tree of npb_product_tree.h).
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "negative_binomial_distribution.h"
+
+struct Npb_query{
+  const int *excluded = NULL;  /* 0-based positions in the base, ascending */
+  int num_excluded = 0;
+  const double *q = NULL;      /* coins to merge in, descending */
+  int num_q = 0;
+  int num_heads = 0;           /* remaining goal */
+};
+
+struct Npb_base_dp{
+  int num_heads = 0;
+  int stride = 16;             /* coins between two checkpoints */
+  std::vector<double> rows;    /* DP rows (num_heads values) at checkpoints */
+  std::vector<Npb_dp_state> states;
+  Npb_dp_state final_state;
+};
+
+/* base DPs of one list of coins, by goal */
+struct Npb_batch_bases{
+  std::vector<double> p;       /* copy of the coins they were run on */
+  double approx_one = 0;
+  std::map<int, Npb_base_dp> by_goal;
+};
+
+/* checkpoints are thinned out beyond this many doubles */
+const size_t NPB_MAX_CHECKPOINT_DOUBLES = (size_t)1 << 23;
+
+inline void npb_base_dp_init(Npb_base_dp &base, Npb_workspace &ws,
+        const double *p, int n, int num_heads, double approx_one)
+{
+  Npb_dp_state st;
+  base.num_heads = num_heads;
+  base.stride = 16;
+  base.rows.clear();
+  base.states.clear();
+
+  npb_dp_start(ws, st, num_heads);
+  npb_dp_advance(ws, st, [&p](){ return *p++; }, n, num_heads, approx_one,
+          [&base, num_heads](const Npb_dp_state &s, const double *row){
+    if (s.n_coins % base.stride) return;
+    if (base.rows.size() + num_heads > NPB_MAX_CHECKPOINT_DOUBLES){
+      /* keep every other checkpoint */
+      size_t i, kept = 0;
+      for (i = 0; i < base.states.size(); i += 2, kept++){
+        std::copy(base.rows.begin() + i*num_heads,
+                base.rows.begin() + (i+1)*num_heads,
+                base.rows.begin() + kept*num_heads);
+        base.states[kept] = base.states[i];
+      }
+      base.rows.resize(kept * num_heads);
+      base.states.resize(kept);
+      base.stride *= 2;
+      if (s.n_coins % base.stride) return;
+    }
+    base.rows.insert(base.rows.end(), row, row + num_heads);
+    base.states.push_back(s);
+  });
+  base.final_state = st;
+}
+
+inline double npb_query_expectation(const Npb_base_dp &base,
+        Npb_workspace &ws, const double *p, int n, const Npb_query &query,
+        double approx_one)
+{
+  int num_heads = base.num_heads;
+  int first_diff = n, checkpoint, j, e, k;
+  Npb_dp_state st;
+
+  if (num_heads <= 0)
+    return 0;
+
+  /* first base position where the merged list differs */
+  if (query.num_excluded > 0)
+    first_diff = query.excluded[0];
+  if (query.num_q > 0){
+    /* q[0] goes before the first coin that is not larger (see merge) */
+    j = (int)(std::lower_bound(p, p + n, query.q[0],
+            [](double a, double b){ return a > b; }) - p);
+    first_diff = std::min(first_diff, j);
+  }
+  /* (the coin that reached approx_one is not counted in n_coins) */
+  if (base.final_state.done && base.final_state.n_coins < first_diff)
+    return base.final_state.expectation;
+
+  /* restart from the last checkpoint before the difference */
+  checkpoint = std::min(first_diff / base.stride,
+          (int)base.states.size() - 1);
+  if (checkpoint < 0){
+    npb_dp_start(ws, st, num_heads);  /* empty base */
+  }
+  else {
+    npb_workspace_reserve(ws, 0, num_heads);
+    std::copy(base.rows.begin() + (size_t)checkpoint * num_heads,
+            base.rows.begin() + (size_t)(checkpoint+1) * num_heads, ws.p_old);
+    std::fill(ws.p_new, ws.p_new + num_heads, 0.0);
+    st = base.states[checkpoint];
+  }
+
+  /* continue with the merged list, skipping excluded coins */
+  j = st.n_coins;
+  e = 0;
+  k = 0;
+  const int *excluded = query.excluded;
+  const double *q = query.q;
+  int num_excluded = query.num_excluded, num_q = query.num_q;
+  npb_dp_advance(ws, st, [&](){
+    while (e < num_excluded && excluded[e] == j){
+      j++;
+      e++;
+    }
+    if (j < n && (k >= num_q || p[j] > q[k]))
+      return p[j++];
+    return q[k++];
+  }, n - num_excluded + num_q, num_heads, approx_one,
+          [](const Npb_dp_state&, const double*){});
+  return st.expectation;
+}
+
+inline void npb_expectations_batch(Npb_batch_bases &bases,
+        const double *p, int n, const Npb_query *queries, int num_queries,
+        double approx_one, double *expectations)
+{
+  /*
+   * one base DP per distinct goal, shared by all queries with that goal
+   * and kept in bases for the next call with the same p and approx_one
+   */
+  Npb_workspace ws;
+  int i;
+
+  if (bases.approx_one != approx_one || bases.p.size() != (size_t)n ||
+          !std::equal(p, p + n, bases.p.begin())){
+    bases.p.assign(p, p + n);
+    bases.approx_one = approx_one;
+    bases.by_goal.clear();
+  }
+  for (i = 0; i < num_queries; i++){
+    int num_heads = queries[i].num_heads;
+    if (num_heads > 0 && bases.by_goal.find(num_heads) == bases.by_goal.end())
+      npb_base_dp_init(bases.by_goal[num_heads], ws, p, n, num_heads,
+              approx_one);
+  }
+  for (i = 0; i < num_queries; i++){
+    if (queries[i].num_heads <= 0){
+      expectations[i] = 0;
+      continue;
+    }
+    expectations[i] = npb_query_expectation(
+            bases.by_goal[queries[i].num_heads], ws, p, n, queries[i],
+            approx_one);
+  }
+}
+
+inline void npb_expectations_batch(const double *p, int n,
+        const Npb_query *queries, int num_queries, double approx_one,
+        double *expectations)
+{
+  Npb_batch_bases bases;
+  npb_expectations_batch(bases, p, n, queries, num_queries, approx_one,
+          expectations);
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef NPB_MONTE_CARLO_H
+#define NPB_MONTE_CARLO_H
+
+/*
+ * Parallel Monte Carlo estimate of the expectation of a negative Poisson
+ * binomial distribution (see negative_binomial_distribution.h).
+ *
+ * Sample i tosses the coins with the uniforms of a counter-based
+ * generator (Philox4x32-10) keyed by the seed and counting (i, block), so
+ * every sample has its own stream and the result depends on the seed
+ * only, not on the number of threads or the order samples are drawn in.
+ * Uniforms are made NPB_MC_LANES Philox blocks at a time, a loop over
+ * lanes the compiler vectorizes, and compared as 32-bit integers with
+ * the coin probabilities scaled to [0, 2^32].
+ *
+ * Samples are drawn in rounds of NPB_MC_ROUND; after each round the
+ * estimate stops if its 95% confidence interval is within ci_half_width.
+ * A sample that tosses all n coins without num_heads heads counts 0,
+ * as in the DP, which sums over the outcomes where the goal is reached.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../native/parallel_for.h"
+
+const int NPB_MC_LANES = 8;      /* Philox blocks per batch */
+const int NPB_MC_BATCH = 4 * NPB_MC_LANES;  /* uniforms per batch */
+const int NPB_MC_CHUNK = 256;    /* samples per work item */
+const int NPB_MC_ROUND = 4096;   /* samples between two stopping checks */
+const double NPB_MC_Z95 = 1.959963984540054;
+
+struct Npb_mc_result{
+  double expectation = 0;
+  double std_error = 0;  /* standard error of the estimate */
+  int num_samples = 0;   /* samples actually drawn */
+};
+
+inline void philox4x32_lanes(uint32_t counters[4][NPB_MC_LANES],
+        uint64_t seed, uint32_t out[NPB_MC_BATCH])
+{
+  /* Philox4x32-10 of NPB_MC_LANES counters; out is lane-major */
+  const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+  uint32_t c0[NPB_MC_LANES], c1[NPB_MC_LANES], c2[NPB_MC_LANES],
+          c3[NPB_MC_LANES];
+  uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+  int r, l;
+
+  for (l = 0; l < NPB_MC_LANES; l++){
+    c0[l] = counters[0][l];
+    c1[l] = counters[1][l];
+    c2[l] = counters[2][l];
+    c3[l] = counters[3][l];
+  }
+  for (r = 0; r < 10; r++){
+    for (l = 0; l < NPB_MC_LANES; l++){
+      uint64_t p0 = (uint64_t)M0 * c0[l], p1 = (uint64_t)M1 * c2[l];
+      uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+      uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+      c0[l] = hi1 ^ c1[l] ^ k0;
+      c1[l] = lo1;
+      c2[l] = hi0 ^ c3[l] ^ k1;
+      c3[l] = lo0;
+    }
+    k0 += W0;
+    k1 += W1;
+  }
+  for (l = 0; l < NPB_MC_LANES; l++){
+    out[4*l] = c0[l];
+    out[4*l + 1] = c1[l];
+    out[4*l + 2] = c2[l];
+    out[4*l + 3] = c3[l];
+  }
+}
+
+inline int npb_mc_sample(int n, const uint64_t *thresholds, int num_heads,
+        uint64_t seed, uint32_t sample)
+{
+  /*
+   * number of coins tossed to get num_heads heads in sample "sample",
+   * 0 if n coins are not enough; thresholds[j] = probs[j] * 2^32, so a
+   * probability of 1 is always a head
+   */
+  uint32_t counters[4][NPB_MC_LANES], uniforms[NPB_MC_BATCH];
+  uint32_t block = 0;
+  int count_heads = 0, j = 0, b, l;
+
+  for (l = 0; l < NPB_MC_LANES; l++){
+    counters[0][l] = sample;
+    counters[2][l] = 0;
+    counters[3][l] = 0;
+  }
+  while (j < n){
+    for (l = 0; l < NPB_MC_LANES; l++)
+      counters[1][l] = block + l;
+    block += NPB_MC_LANES;
+    philox4x32_lanes(counters, seed, uniforms);
+    for (b = 0; b < NPB_MC_BATCH && j < n; b++, j++){
+      if (uniforms[b] < thresholds[j] && ++count_heads == num_heads)
+        return j + 1;
+    }
+  }
+  return 0;
+}
+
+inline Npb_mc_result npb_monte_carlo(int n, const double *probs,
+        int num_heads, int max_samples, uint64_t seed, double ci_half_width,
+        int num_threads)
+{
+  /*
+   * estimate the expectation from at most max_samples samples, stopping
+   * early once NPB_MC_Z95 standard errors are within ci_half_width
+   * (0: always draw max_samples); num_threads <= 0 uses all cores
+   */
+  Npb_mc_result res;
+  std::vector<uint64_t> thresholds(n);
+  std::vector<double> sums, squares;
+  double sum = 0, sum_squares = 0, var;
+  int j, drawn = 0;
+
+  if (num_heads <= 0 || max_samples <= 0)
+    return res;
+  if (num_threads <= 0)
+    num_threads = default_num_threads();
+  for (j = 0; j < n; j++)
+    thresholds[j] = (uint64_t)(std::min(std::max(probs[j], 0.0), 1.0) *
+            4294967296.0);
+
+  while (drawn < max_samples){
+    int round = std::min(NPB_MC_ROUND, max_samples - drawn);
+    int num_chunks = (round + NPB_MC_CHUNK - 1) / NPB_MC_CHUNK;
+    sums.assign(num_chunks, 0);
+    squares.assign(num_chunks, 0);
+    parallel_for(num_chunks, std::min(num_threads, num_chunks),
+            [&](int c, int){
+      int i, last = std::min(round, (c + 1) * NPB_MC_CHUNK);
+      double x;
+      for (i = c * NPB_MC_CHUNK; i < last; i++){
+        x = npb_mc_sample(n, thresholds.data(), num_heads, seed,
+                (uint32_t)(drawn + i));
+        sums[c] += x;
+        squares[c] += x * x;
+      }
+    });
+    /* in chunk order, so the sums do not depend on the threads */
+    for (j = 0; j < num_chunks; j++){
+      sum += sums[j];
+      sum_squares += squares[j];
+    }
+    drawn += round;
+
+    res.num_samples = drawn;
+    res.expectation = sum / drawn;
+    var = drawn > 1 ? (sum_squares - sum * res.expectation) / (drawn - 1) : 0;
+    res.std_error = sqrt(std::max(var, 0.0) / drawn);
+    if (ci_half_width > 0 && drawn > 1 &&
+            NPB_MC_Z95 * res.std_error <= ci_half_width)
+      break;
+  }
+  return res;
+}
+
+#endif
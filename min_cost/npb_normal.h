@@ -0,0 +1,319 @@
+#ifndef NPB_NORMAL_H
+#define NPB_NORMAL_H
+
+/*
+ * Closed-form approximation of the expectation of a negative Poisson
+ * binomial distribution, with a fallback to the dynamic program of
+ * negative_binomial_distribution.h when its error estimate is too large.
+ *
+ * With S_k the number of heads in the first k coins and T the number of
+ * coins tossed for num_heads heads, the expectation the DP computes is
+ *
+ *   E[T; T <= n] = sum_{k<n} Pr(S_k < num_heads) - n Pr(S_n < num_heads).
+ *
+ * Each Pr(S_k < num_heads) comes from the Edgeworth expansion of the
+ * Poisson binomial distribution to second order (normal, skewness term,
+ * then the fourth cumulant and squared skewness terms and the second
+ * order lattice term of the continuity correction), whose mean and
+ * cumulants are prefix sums over the coins. Only the k where it is
+ * neither ~1 nor ~0 matter; that window is found by binary search and
+ * summed at NPB_NORMAL_NODES points with the trapezoid rule, so a query
+ * costs O(log n) once the prefix sums are built (O(n), so reuse them).
+ *
+ * The error estimate adds up, over the window, the size of the second
+ * order terms of each probability (each of them |term|, so no
+ * cancellation hides them), plus the quadrature error of each pair of
+ * panels against the trapezoid rule over both. The terms left out are
+ * an order smaller, so this is an asymptotic estimate rather than a
+ * bound. Against the DP (test_npb_normal.cpp: uniform, small, sorted
+ * and mixed coins, n up to 2e4) it was 2.5 to 1e4 times the actual
+ * error, and below 1% of the expectation for goals from about 20 on
+ * (0.5% from 10 on for sorted coins, as ens_min_cost passes them);
+ * smaller goals mostly fall back to the DP.
+ *
+ * Where a bound is needed (the upper bounds of ens_min_cost.m prune
+ * candidates on it), npb_normal_lower_bound gives a rigorous one instead:
+ * each Pr(S_k < num_heads) is bounded with the Berry-Esseen inequality
+ * and Bernstein's inequality rather than estimated, at O(n).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "negative_binomial_distribution.h"
+
+const int NPB_NORMAL_NODES = 128;       /* quadrature nodes (even) */
+const double NPB_NORMAL_Z = 8.5;        /* Phi(-8.5) ~ 1e-17 */
+/*
+ * Berry-Esseen constant for sums of independent, not identically
+ * distributed variables (Shevtsova 2010)
+ */
+const double NPB_BERRY_ESSEEN = 0.56;
+
+struct Npb_prefix_sums{
+  int n = 0;
+  std::vector<double> mean;      /* sum of p over the first k coins */
+  std::vector<double> var;       /* sum of p (1-p) */
+  std::vector<double> third;     /* sum of p (1-p) (1-2p) */
+  std::vector<double> fourth;    /* sum of p (1-p) (1 - 6p (1-p)) */
+  std::vector<double> abs_third; /* sum of p (1-p) (1 - 2p (1-p)) */
+};
+
+struct Npb_normal_result{
+  double expectation = 0;
+  double error = 0;      /* estimated absolute error */
+};
+
+inline void npb_prefix_sums_init(Npb_prefix_sums &s, const double *p, int n)
+{
+  int k;
+  double q;
+  s.n = n;
+  s.mean.assign(n + 1, 0.0);
+  s.var.assign(n + 1, 0.0);
+  s.third.assign(n + 1, 0.0);
+  s.fourth.assign(n + 1, 0.0);
+  s.abs_third.assign(n + 1, 0.0);
+  for (k = 0; k < n; k++){
+    q = p[k] * (1 - p[k]);
+    s.mean[k+1] = s.mean[k] + p[k];
+    s.var[k+1] = s.var[k] + q;
+    s.third[k+1] = s.third[k] + q * (1 - 2 * p[k]);
+    s.fourth[k+1] = s.fourth[k] + q * (1 - 6 * q);
+    s.abs_third[k+1] = s.abs_third[k] + q * (1 - 2 * q);
+  }
+}
+
+inline double npb_normal_z(const Npb_prefix_sums &s, int k, int num_heads)
+{
+  /* standardized num_heads - 1/2 after k coins (+-inf if S_k is fixed) */
+  double x = num_heads - 0.5 - s.mean[k];
+  if (s.var[k] <= 0)
+    return x > 0 ? INFINITY : -INFINITY;
+  return x / sqrt(s.var[k]);
+}
+
+inline double npb_normal_below(const Npb_prefix_sums &s, int k,
+        int num_heads, double *error)
+{
+  /*
+   * Edgeworth approximation of Pr(S_k < num_heads) to second order;
+   * error (optional) gets the size of the second order terms
+   */
+  double x = npb_normal_z(s, k, num_heads), var, gamma, kappa, phi, he3,
+          he5, terms[3], g;
+  if (error)
+    *error = 0;
+  if (std::isinf(x))
+    return x > 0 ? 1 : 0;
+  var = s.var[k];
+  gamma = s.third[k] / (var * sqrt(var));
+  kappa = s.fourth[k] / (var * var);
+  phi = exp(-x * x / 2) / sqrt(2 * acos(-1.0));
+  he3 = x * x * x - 3 * x;
+  he5 = x * x * x * x * x - 10 * x * x * x + 15 * x;
+  terms[0] = -kappa / 24 * he3;
+  terms[1] = -gamma * gamma / 72 * he5;
+  terms[2] = x / (24 * var);     /* lattice: Euler-Maclaurin at k - 1/2 */
+  g = 0.5 * erfc(-x / sqrt(2.0)) + phi * (gamma / 6 * (1 - x * x) +
+          terms[0] + terms[1] + terms[2]);
+  if (error)
+    *error = phi * (fabs(terms[0]) + fabs(terms[1]) + fabs(terms[2]));
+  return std::min(std::max(g, 0.0), 1.0);
+}
+
+inline int npb_normal_first(const Npb_prefix_sums &s, int num_heads,
+        double z)
+{
+  /* first k with z_k < z (z_k decreases with k), n + 1 if none */
+  int lo = 0, hi = s.n + 1, mid;
+  while (lo < hi){
+    mid = lo + (hi - lo) / 2;
+    if (npb_normal_z(s, mid, num_heads) < z)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+inline Npb_normal_result npb_normal_expectation(const Npb_prefix_sums &s,
+        int num_heads)
+{
+  Npb_normal_result res;
+  int n = s.n, a, b, j, k, prev = 0, prev2 = 0;
+  double value = 0, bound = 0, panel = 0, g, e, g_prev = 0, e_prev = 0,
+          g_prev2 = 0, g_first = 0, g_last = 0;
+
+  if (num_heads <= 0 || n <= 0)
+    return res;
+  /* Pr(S_k < num_heads) ~ 1 before a and ~ 0 from b on */
+  a = std::min(npb_normal_first(s, num_heads, NPB_NORMAL_Z), n);
+  b = std::min(npb_normal_first(s, num_heads, -NPB_NORMAL_Z), n);
+
+  if (b - a <= NPB_NORMAL_NODES){
+    for (k = a; k < b; k++){
+      value += npb_normal_below(s, k, num_heads, &e);
+      bound += e;
+    }
+  }
+  else {
+    /*
+     * sum_{a<=k<b} g(k) ~ trapezoid of g over [a, b] + (g(a) - g(b))/2,
+     * at integer nodes. g is only smooth in k if the coins change slowly
+     * (as sorted ones do), so the error of each pair of panels is taken
+     * apart, as its difference with the rule over both at once
+     */
+    for (j = 0; j <= NPB_NORMAL_NODES; j++){
+      k = a + (int)((double)(b - a) * j / NPB_NORMAL_NODES);
+      g = npb_normal_below(s, k, num_heads, &e);
+      if (j == 0)
+        g_first = g;
+      else {
+        panel += (k - prev) * (g + g_prev) / 2;
+        bound += (k - prev) * (e + e_prev) / 2;
+      }
+      if (j % 2 == 0 && j > 0){
+        res.error += fabs(panel - (k - prev2) * (g + g_prev2) / 2);
+        value += panel;
+        panel = 0;
+      }
+      if (j % 2 == 0){
+        prev2 = k;
+        g_prev2 = g;
+      }
+      prev = k;
+      g_prev = g;
+      e_prev = e;
+    }
+    g_last = g_prev;
+    value += (g_first - g_last) / 2;
+  }
+  res.expectation = a + value;
+  /* the step from ~1 to ~0 at a is approximate as well */
+  if (a < n){
+    npb_normal_below(s, a, num_heads, &e);
+    bound += e;
+  }
+  res.error += bound;
+
+  /* outcomes where n coins are not enough */
+  if (b >= n){
+    res.expectation -= n * npb_normal_below(s, n, num_heads, &e);
+    res.error += n * e;
+  }
+  res.expectation = std::max(res.expectation, 0.0);
+  return res;
+}
+
+inline double npb_bernstein_tail(double t, double var)
+{
+  /*
+   * bound on Pr(X - E X >= t) and on Pr(E X - X >= t), for X a sum of
+   * independent variables in [0, 1] with variance var and t > 0
+   */
+  return exp(-t * t / (2 * (var + t / 3)));
+}
+
+inline double npb_below_bound(const Npb_prefix_sums &s, int k, double x,
+        bool upper)
+{
+  /*
+   * rigorous lower (or, if upper, upper) bound on Pr(S_k < x) for an
+   * integer x, where Pr(S_k < x) = Pr(S_k <= x - 1): Berry-Esseen gives
+   * |Pr(S_k <= y) - Phi((y - mean) / sd)| <= NPB_BERRY_ESSEEN
+   * sum E|X - p|^3 / sd^3 at every y, taken at y -> x from below for the
+   * lower bound and at y = x - 1 for the upper one, and Bernstein's
+   * inequality is tighter in the tails
+   */
+  double mean = s.mean[k], var = s.var[k], be, t, bound;
+  if (var <= 0)
+    return mean < x ? 1 : 0;  /* all coins are 0 or 1 */
+  be = NPB_BERRY_ESSEEN * s.abs_third[k] / (var * sqrt(var));
+  if (upper){
+    /* Pr(S_k <= x - 1) */
+    t = mean - (x - 1);
+    bound = 0.5 * erfc(-(x - 1 - mean) / sqrt(2 * var)) + be;
+    if (t > 0)
+      bound = std::min(bound, npb_bernstein_tail(t, var));
+    return std::min(bound, 1.0);
+  }
+  /* Pr(S_k < x) = 1 - Pr(S_k >= x) */
+  t = x - mean;
+  bound = 0.5 * erfc(-t / sqrt(2 * var)) - be;
+  if (t > 0)
+    bound = std::max(bound, 1 - npb_bernstein_tail(t, var));
+  return std::max(bound, 0.0);
+}
+
+inline double npb_normal_lower_bound(const Npb_prefix_sums &s,
+        int num_heads, double approx_one)
+{
+  /*
+   * lower bound on what approx_exp_of_neg_poisson_binom returns for the
+   * same coins. The DP stops after T coins, at n or once the pmf sums
+   * to more than approx_one, and returns
+   *
+   *   sum_{k<T} (Pr(S_k < num_heads) - Pr(S_T < num_heads)),
+   *
+   * where every term is >= 0 and Pr(S_T < num_heads) is at most
+   * u = max(1 - approx_one, Pr(S_n < num_heads)). Each term of a k < T is
+   * then at least its lower bound minus u, and the terms of the k >= T
+   * have lower bounds <= 1 - approx_one <= u, so summing
+   * max(0, bound - u) over all k < n never exceeds the DP
+   */
+  int n = s.n, k;
+  double u, bound = 0, g;
+
+  if (num_heads <= 0 || n <= 0)
+    return 0;
+  u = std::max(1 - approx_one, npb_below_bound(s, n, num_heads, true));
+  for (k = 0; k < n; k++){
+    g = npb_below_bound(s, k, num_heads, false) - u;
+    if (g > 0)
+      bound += g;
+  }
+  return bound;
+}
+
+inline double npb_expectation_with_fallback(Npb_workspace &ws,
+        const Npb_prefix_sums &s, double *p, int num_heads,
+        double tolerance, double approx_one, double *error, bool *used_dp)
+{
+  /*
+   * the normal approximation if its error estimate is within tolerance
+   * times the approximation, else the DP with approx_one (error 0);
+   * s holds the prefix sums of p
+   */
+  Npb_normal_result res = npb_normal_expectation(s, num_heads);
+  bool dp = res.error > tolerance * res.expectation;
+  if (dp){
+    res.expectation = approx_exp_of_neg_poisson_binom(ws, s.n, p,
+            num_heads, approx_one);
+    res.error = 0;
+  }
+  if (error) *error = res.error;
+  if (used_dp) *used_dp = dp;
+  return res.expectation;
+}
+
+inline double npb_lower_bound_with_fallback(Npb_workspace &ws,
+        const Npb_prefix_sums &s, double *p, int num_heads,
+        double tolerance, double approx_one, bool *used_dp)
+{
+  /*
+   * npb_normal_lower_bound if it is within tolerance times the normal
+   * approximation below it, else the DP with approx_one; never above
+   * the DP either way
+   */
+  double bound = npb_normal_lower_bound(s, num_heads, approx_one);
+  double estimate = npb_normal_expectation(s, num_heads).expectation;
+  bool dp = estimate - bound > tolerance * estimate;
+  if (dp)
+    bound = approx_exp_of_neg_poisson_binom(ws, s.n, p, num_heads,
+            approx_one);
+  if (used_dp) *used_dp = dp;
+  return bound;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef NPB_PRODUCT_TREE_H
+#define NPB_PRODUCT_TREE_H
+
+/*
+ * Negative Poisson binomial distribution by divide and conquer over the
+ * coins, for goals too large for the O(n num_heads) dynamic program.
+ *
+ * The n-th coin is the num_heads-th head with probability
+ * p_n [z^(num_heads-1)] prod_{j<n} (1 - p_j + p_j z). Over a range of
+ * coins [l, r) only the r-l+1 coefficients of the incoming product just
+ * below z^num_heads can still reach the goal, so npb_tree_solve takes
+ * that window, answers the left half with its upper part, moves the
+ * window across the left half by one convolution with the product of the
+ * left factors, and answers the right half. Each call also returns the
+ * product of its factors for its parent, so every level of the recursion
+ * costs two convolutions of its length: O(n log^2 n) with FFT
+ * convolutions, whatever the goal. Short ranges (NPB_TREE_LEAF coins)
+ * use the coin-by-coin recurrence instead.
+ *
+ * The FFTs round to about 1e-15 of the largest coefficient, so tiny
+ * probabilities carry absolute (not relative) errors of that size;
+ * negative results are clipped to 0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+const int NPB_TREE_LEAF = 64;         /* coins handled without recursion */
+const int NPB_DIRECT_CONVOLUTION = 48;  /* shorter factors skip the FFT */
+const double NPB_TREE_CROSSOVER = 24;   /* see npb_use_product_tree */
+
+inline void npb_fft(std::vector<std::complex<double> > &a, bool invert)
+{
+  /*
+   * in-place radix-2 FFT, a.size() a power of 2; products are written
+   * out, since std::complex operator* also checks for infinities
+   */
+  int n = (int)a.size(), i, j, len, k, stride;
+  double sign = invert ? -1 : 1, angle = 2 * acos(-1.0) / n;
+  std::vector<double> cos_table(n / 2), sin_table(n / 2);
+  double *re = (double*)a.data();  /* interleaved real and imaginary */
+
+  for (k = 0; k < n / 2; k++){
+    cos_table[k] = cos(angle * k);
+    sin_table[k] = sign * sin(angle * k);
+  }
+  for (i = 1, j = 0; i < n; i++){
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(a[i], a[j]);
+  }
+  for (len = 2, stride = n / 2; len <= n; len <<= 1, stride >>= 1){
+    int half = len / 2;
+    for (i = 0; i < n; i += len){
+      for (k = 0; k < half; k++){
+        double wr = cos_table[k * stride], wi = sin_table[k * stride];
+        double *u = re + 2 * (i + k), *x = re + 2 * (i + k + half);
+        double vr = x[0] * wr - x[1] * wi, vi = x[0] * wi + x[1] * wr;
+        x[0] = u[0] - vr;
+        x[1] = u[1] - vi;
+        u[0] += vr;
+        u[1] += vi;
+      }
+    }
+  }
+  if (invert){
+    for (i = 0; i < 2 * n; i++)
+      re[i] /= n;
+  }
+}
+
+inline void npb_convolve(const double *a, int na, const double *b, int nb,
+        std::vector<double> &out)
+{
+  /* out = a * b (na + nb - 1 coefficients) */
+  int i, j, n = 1;
+  out.assign(na + nb - 1, 0.0);
+  if (std::min(na, nb) <= NPB_DIRECT_CONVOLUTION){
+    for (i = 0; i < na; i++){
+      for (j = 0; j < nb; j++)
+        out[i+j] += a[i] * b[j];
+    }
+    return;
+  }
+  /* one complex FFT for both: (a + ib)^2 = a^2 - b^2 + 2i ab */
+  while (n < na + nb - 1)
+    n <<= 1;
+  std::vector<std::complex<double> > c(n);
+  for (i = 0; i < na; i++)
+    c[i].real(a[i]);
+  for (i = 0; i < nb; i++)
+    c[i].imag(b[i]);
+  npb_fft(c, false);
+  for (i = 0; i < n; i++){
+    double re = c[i].real(), im = c[i].imag();
+    c[i] = std::complex<double>(re * re - im * im, 2 * re * im);
+  }
+  npb_fft(c, true);
+  for (i = 0; i < na + nb - 1; i++)
+    out[i] = c[i].imag() / 2;
+}
+
+inline void npb_tree_solve(const double *probs, int l, int r,
+        const double *window, int num_heads, double *pm,
+        std::vector<double> &product)
+{
+  /*
+   * window[t] (t = 0..r-l) is the probability of num_heads-1-(r-l)+t heads
+   * with the coins before l; sets pm[i] for l <= i < r to the probability
+   * that coin i is the num_heads-th head, and product to the coefficients
+   * of prod_{l<=j<r} (1 - p_j + p_j z)
+   */
+  int len = r - l, i, t;
+  double p;
+
+  if (len <= NPB_TREE_LEAF){
+    std::vector<double> w(window, window + len + 1);
+    double *d = w.data();
+    product.assign(len + 1, 0.0);
+    product[0] = 1;
+    for (i = l; i < r; i++){
+      /* d holds r-i+1 values, the last for num_heads-1 heads */
+      p = probs[i];
+      pm[i] = p * d[r-i];
+      for (t = r - i; t >= 1; t--)
+        d[t] = d[t] * (1 - p) + d[t-1] * p;
+      d++;
+      for (t = i - l + 1; t >= 1; t--)
+        product[t] = product[t] * (1 - p) + product[t-1] * p;
+      product[0] *= 1 - p;
+    }
+    return;
+  }
+
+  int m = l + len / 2;
+  std::vector<double> left, right, moved;
+  npb_tree_solve(probs, l, m, window + (r - m), num_heads, pm, left);
+  /* window across the left half: the upper r-m+1 of window * left */
+  npb_convolve(window, len + 1, left.data(), m - l + 1, moved);
+  npb_tree_solve(probs, m, r, moved.data() + (m - l), num_heads, pm, right);
+  npb_convolve(left.data(), m - l + 1, right.data(), r - m + 1, product);
+}
+
+inline void npb_product_tree_pm(int n, const double *probs, int num_heads,
+        std::vector<double> &pm)
+{
+  /*
+   * pm[i] = probability that coin i (0-based) is the num_heads-th head
+   * (1 <= num_heads <= n)
+   */
+  std::vector<double> window(n + 1, 0.0), product;
+  window[n - num_heads + 1] = 1;  /* no heads before the first coin */
+  pm.assign(n, 0.0);
+  npb_tree_solve(probs, 0, n, window.data(), num_heads, pm.data(), product);
+  for (int i = 0; i < n; i++)
+    pm[i] = std::max(pm[i], 0.0);
+}
+
+inline void npb_product_tree_pmf(int n, const double *probs, int num_heads,
+        double *pgnb)
+{
+  /* pgnb[i-num_heads], i = num_heads..n, as pmf_of_neg_poisson_binom */
+  std::vector<double> pm;
+  npb_product_tree_pm(n, probs, num_heads, pm);
+  std::copy(pm.begin() + (num_heads - 1), pm.end(), pgnb);
+}
+
+inline double npb_product_tree_expectation(int n, const double *probs,
+        int num_heads)
+{
+  /* sum of i Pr(the i-th coin is the num_heads-th head), i <= n */
+  std::vector<double> pm;
+  double expectation = 0;
+  npb_product_tree_pm(n, probs, num_heads, pm);
+  for (int i = num_heads - 1; i < n; i++)
+    expectation += pm[i] * (i + 1);
+  return expectation;
+}
+
+inline bool npb_use_product_tree(int n, int num_heads)
+{
+  /*
+   * the DP costs about n num_heads row updates and the tree about
+   * NPB_TREE_CROSSOVER n log2(n)^2 of them (measured with AVX2 for
+   * n = 1e4..1e6); tiny probabilities also make the DP rows denormal,
+   * which slows it down much more than the FFTs, so the crossover is
+   * on the low side
+   */
+  double lg = log2((double)std::max(n, 2));
+  return num_heads >= 1 && num_heads <= n &&
+          num_heads > NPB_TREE_CROSSOVER * lg * lg;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef POISSON_BINOMIAL_ROW_H
+#define POISSON_BINOMIAL_ROW_H
+
+/*
+ * Vectorized step of the Poisson binomial dynamic program.
+ *
+ * If in[r] is the probability of r heads among the first c-1 coins,
+ * then after tossing coin c (head with probability p)
+ *
+ *   out[r] = p * in[r-1] + (1-p) * in[r],   r = 1..len-1
+ *
+ * Within one coin every r is independent, so going through the table
+ * coin by coin (instead of along the number of heads, where each cell
+ * needs its left neighbor) lets the whole row be done with SIMD. Each
+ * cell is computed with the same multiplications and addition as the
+ * scalar code, so the results agree with it (up to the compiler
+ * contracting the scalar version into fused multiply-adds).
+ *
+ * The AVX-512 or AVX2 path is picked at compile time, e.g. with
+ *   mex CXXFLAGS='$CXXFLAGS -mavx2' ...
+ * and the scalar loop is used otherwise. out[0] is left to the caller.
+ */
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+inline void poisson_binomial_row(double *out, const double *in, int len,
+        double p)
+{
+  double q = 1 - p;
+  int r = 1;
+
+#if defined(__AVX512F__)
+  __m512d vp8 = _mm512_set1_pd(p), vq8 = _mm512_set1_pd(q);
+  for (; r + 8 <= len; r += 8){
+    __m512d heads = _mm512_mul_pd(vp8, _mm512_loadu_pd(in + r - 1));
+    __m512d tails = _mm512_mul_pd(vq8, _mm512_loadu_pd(in + r));
+    _mm512_storeu_pd(out + r, _mm512_add_pd(heads, tails));
+  }
+#endif
+#if defined(__AVX512F__) || defined(__AVX2__)
+  __m256d vp4 = _mm256_set1_pd(p), vq4 = _mm256_set1_pd(q);
+  for (; r + 4 <= len; r += 4){
+    __m256d heads = _mm256_mul_pd(vp4, _mm256_loadu_pd(in + r - 1));
+    __m256d tails = _mm256_mul_pd(vq4, _mm256_loadu_pd(in + r));
+    _mm256_storeu_pd(out + r, _mm256_add_pd(heads, tails));
+  }
+#endif
+  for (; r < len; r++){
+    out[r] = p * in[r-1] + q * in[r];
+  }
+}
+
+#endif
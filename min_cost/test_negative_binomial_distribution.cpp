@@ -2,7 +2,9 @@
 #include <random>
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
 #include "negative_binomial_distribution.h"
+#include "npb_monte_carlo.h"
 
 using namespace std;
 
@@ -80,6 +82,19 @@ int test_expectation(int n, double* probs, int num_heads,
     printf("%10d samples: average error: %f time: %f (longer than DP? %d)\n", 
             num_samples, ave_errors[i], clock_time_monte[i], greater);
   }
+  
+  /* parallel sampler, stopping at a 95% interval of +-0.1% (wall time) */
+  auto wall_start = std::chrono::steady_clock::now();
+  Npb_mc_result mc = npb_monte_carlo(n, probs, num_heads, 1<<24, 1,
+          1e-3 * expectation1, 0);
+  double wall_time = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - wall_start).count();
+  printf("parallel Monte Carlo: %d samples, error: %f, standard error: %f "
+          "time: %f\n", mc.num_samples, fabs(expectation1 - mc.expectation),
+          mc.std_error, wall_time);
+  delete [] errors;
+  delete [] ave_errors;
+  delete [] clock_time_monte;
   return 0;
 }
 
@@ -97,6 +112,7 @@ int main(int argc, char* argv[]){
     }
     printf("\n");
     test_expectation(n, probs, num_heads, N, num_repeats);
+    delete [] probs;
   }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "npb_batch.h"
+
+/*
+ * Checks npb_expectations_batch against approx_exp_of_neg_poisson_binom
+ * on each merged list, with the queries of a step split into chunks that
+ * share one Npb_batch_bases (as ens_min_cost.m calls the mex), and with
+ * the coins or approx_one changed between steps so that kept base DPs
+ * must be dropped. Returns 1 on failure.
+ */
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double approx_ones[] = {1.0, 1 - 1e-6, 1 - 1e-6, 0.99};
+  Npb_batch_bases bases;
+  int n = 500, step, i, j, errors = 0;
+  std::vector<double> p(n);
+
+  for (step = 0; step < 8; step++){
+    double approx_one = approx_ones[step % 4];
+    int num_queries = 40, chunk = 7, num_heads = 5 + step;
+    /* new coins every other step, so some steps only change approx_one */
+    if (step % 2 == 0){
+      for (i = 0; i < n; i++)
+        p[i] = 0.3 * uniform(gen);
+      std::sort(p.begin(), p.end(), std::greater<double>());
+    }
+
+    std::vector<std::vector<int> > excluded(num_queries);
+    std::vector<std::vector<double> > q(num_queries);
+    std::vector<Npb_query> queries(num_queries);
+    std::vector<double> expectations(num_queries);
+    for (i = 0; i < num_queries; i++){
+      for (j = 0; j < n; j++){
+        if (gen() % 100 == 0)
+          excluded[i].push_back(j);
+      }
+      for (j = (int)(gen() % 5); j > 0; j--)
+        q[i].push_back(uniform(gen));
+      std::sort(q[i].begin(), q[i].end(), std::greater<double>());
+      queries[i].excluded = excluded[i].data();
+      queries[i].num_excluded = (int)excluded[i].size();
+      queries[i].q = q[i].data();
+      queries[i].num_q = (int)q[i].size();
+      queries[i].num_heads = num_heads - (int)(i % 2);
+    }
+    for (i = 0; i < num_queries; i += chunk)
+      npb_expectations_batch(bases, p.data(), n, queries.data() + i,
+              std::min(chunk, num_queries - i), approx_one,
+              expectations.data() + i);
+
+    for (i = 0; i < num_queries; i++){
+      std::vector<double> coins(q[i]);
+      size_t e = 0;
+      for (j = 0; j < n; j++){
+        if (e < excluded[i].size() && excluded[i][e] == j)
+          e++;
+        else
+          coins.push_back(p[j]);
+      }
+      std::stable_sort(coins.begin(), coins.end(), std::greater<double>());
+      double want = approx_exp_of_neg_poisson_binom((int)coins.size(),
+              coins.data(), queries[i].num_heads, approx_one);
+      if (fabs(expectations[i] - want) > 1e-9 * want){
+        if (errors < 10)
+          printf("step %d query %d: %.12f, want %.12f\n", step, i,
+                  expectations[i], want);
+        errors++;
+      }
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
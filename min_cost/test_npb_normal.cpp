@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "npb_normal.h"
+
+/*
+ * Checks the approximation of npb_normal.h against the exact DP on coins
+ * drawn in several ways (uniform, small, small and sorted as ens_min_cost
+ * passes them, mostly tiny with a few large): the error estimate must
+ * cover the actual error, it must be within 1% of the expectation from
+ * goal 20 on (so that the approximation is used there), and the
+ * fallback must give the DP when the tolerance is 0. The rigorous lower
+ * bound must never exceed the DP, also when approx_one stops it early,
+ * and be within 5% of it from goal 50 on. Returns 1 on failure.
+ */
+
+int main()
+{
+  const char *names[] = {"uniform", "small", "sorted", "mixed"};
+  const int goals[] = {2, 5, 10, 20, 50, 100, 200, 500, 1000};
+  const double approx_ones[] = {1.0, 1 - 1e-6, 0.99};
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  Npb_workspace ws;
+  int kind, size, i, g, a, errors = 0;
+
+  for (kind = 0; kind < 4; kind++){
+    for (size = 0; size < 2; size++){
+      int n = size == 0 ? 2000 : 20000;
+      std::vector<double> p(n);
+      Npb_prefix_sums s;
+      for (i = 0; i < n; i++){
+        double r = uniform(gen);
+        if (kind == 0)
+          p[i] = r;
+        else if (kind <= 2)
+          p[i] = 0.3 * r * r;
+        else
+          p[i] = uniform(gen) < 0.1 ? r : 0.05 * r;
+      }
+      if (kind == 2)
+        std::sort(p.begin(), p.end(), std::greater<double>());
+      npb_prefix_sums_init(s, p.data(), n);
+
+      for (g = 0; g < (int)(sizeof(goals) / sizeof(goals[0])); g++){
+        int num_heads = goals[g];
+        double exact, fallback;
+        bool used_dp;
+        if (num_heads > 0.9 * s.mean[n]) continue;
+        exact = approx_exp_of_neg_poisson_binom(ws, n, p.data(), num_heads,
+                1.0);
+        Npb_normal_result res = npb_normal_expectation(s, num_heads);
+        if (fabs(res.expectation - exact) > res.error){
+          printf("%s n=%d goal %d: %.6f, exact %.6f, error estimate %g\n",
+                  names[kind], n, num_heads, res.expectation, exact,
+                  res.error);
+          errors++;
+        }
+        if (num_heads >= 20 && res.error > 0.01 * exact){
+          printf("%s n=%d goal %d: error estimate %g of %.3f\n",
+                  names[kind], n, num_heads, res.error, exact);
+          errors++;
+        }
+        fallback = npb_expectation_with_fallback(ws, s, p.data(),
+                num_heads, 0, 1.0, NULL, &used_dp);
+        if (!used_dp || fallback != exact){
+          printf("%s n=%d goal %d: fallback %.6f, exact %.6f\n",
+                  names[kind], n, num_heads, fallback, exact);
+          errors++;
+        }
+
+        for (a = 0; a < 3; a++){
+          double dp = approx_exp_of_neg_poisson_binom(ws, n, p.data(),
+                  num_heads, approx_ones[a]);
+          double bound = npb_normal_lower_bound(s, num_heads,
+                  approx_ones[a]);
+          if (bound > dp || (num_heads >= 50 && bound < 0.95 * dp)){
+            printf("%s n=%d goal %d approx_one %g: bound %.6f, DP %.6f\n",
+                    names[kind], n, num_heads, approx_ones[a], bound, dp);
+            errors++;
+          }
+        }
+        fallback = npb_lower_bound_with_fallback(ws, s, p.data(), num_heads,
+                0, 1.0, &used_dp);
+        if (!used_dp || fallback != exact){
+          printf("%s n=%d goal %d: bound fallback %.6f, exact %.6f\n",
+                  names[kind], n, num_heads, fallback, exact);
+          errors++;
+        }
+      }
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
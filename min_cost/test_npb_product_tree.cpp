@@ -0,0 +1,98 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "negative_binomial_distribution.h"
+
+/*
+ * Checks npb_product_tree_pm and npb_product_tree_expectation against the
+ * coin-by-coin DP of approx_pmf_of_neg_poisson_binom (all n coins) for n
+ * on both sides of NPB_TREE_LEAF (no recursion) and of the factor lengths
+ * at which npb_convolve switches to the FFT (NPB_DIRECT_CONVOLUTION), with
+ * goals from 1 to n and coins from uniform to tiny; then checks that
+ * approx_exp_of_neg_poisson_binom agrees with the DP for goals on both
+ * sides of the npb_use_product_tree crossover. The FFTs round to about
+ * 1e-15 of the largest coefficient, so each probability is compared with
+ * an absolute tolerance of 1e-15 and the expectation with n times the sum
+ * of those, n^2 1e-15. Returns 1 on failure.
+ */
+
+const double PM_TOLERANCE = 1e-15;
+
+static int compare(int n, const double *probs, int num_heads, double scale)
+{
+  Npb_workspace ws;
+  Neg_poisson_binomial_dist dist = approx_pmf_of_neg_poisson_binom(ws, n,
+          (double*)probs, num_heads, INFINITY);
+  std::vector<double> pm;
+  double max_error = 0, expectation;
+  int i, errors = 0;
+
+  npb_product_tree_pm(n, probs, num_heads, pm);
+  for (i = 0; i < n; i++){
+    double want = i < num_heads - 1 ? 0 : dist.pmf[i - (num_heads - 1)];
+    max_error = std::max(max_error, fabs(pm[i] - want));
+  }
+  if (max_error > PM_TOLERANCE){
+    printf("n %d goal %d scale %g: probabilities off by %.3g\n", n,
+            num_heads, scale, max_error);
+    errors++;
+  }
+  expectation = npb_product_tree_expectation(n, probs, num_heads);
+  if (fabs(expectation - dist.expectation) > PM_TOLERANCE * n * n){
+    printf("n %d goal %d scale %g: expectation %.15g, want %.15g\n", n,
+            num_heads, scale, expectation, dist.expectation);
+    errors++;
+  }
+  return errors;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const int sizes[] = {1, 2, NPB_DIRECT_CONVOLUTION,
+          NPB_TREE_LEAF - 1, NPB_TREE_LEAF, NPB_TREE_LEAF + 1,
+          2 * NPB_DIRECT_CONVOLUTION - 1, 2 * NPB_DIRECT_CONVOLUTION,
+          2 * NPB_DIRECT_CONVOLUTION + 1, 2 * NPB_DIRECT_CONVOLUTION + 2,
+          2 * NPB_TREE_LEAF, 2 * NPB_TREE_LEAF + 1, 257, 1000, 4097};
+  const double scales[] = {1, 0.3, 0.01};
+  int s, c, g, i, errors = 0;
+
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++){
+    int n = sizes[s];
+    std::vector<double> probs(n);
+    for (c = 0; c < 3; c++){
+      for (i = 0; i < n; i++)
+        probs[i] = scales[c] * uniform(gen);
+      int goals[] = {1, 2, n / 3, n / 2, n - 1, n};
+      for (g = 0; g < 6; g++){
+        if (goals[g] >= 1 && goals[g] <= n)
+          errors += compare(n, probs.data(), goals[g], scales[c]);
+      }
+    }
+  }
+
+  /* approx_one = 1 switches to the tree above the crossover */
+  int n = 20000;
+  double lg = log2((double)n), crossover = NPB_TREE_CROSSOVER * lg * lg;
+  std::vector<double> probs(n);
+  for (i = 0; i < n; i++)
+    probs[i] = 0.5 * uniform(gen);
+  int goals[] = {(int)crossover - 100, (int)crossover + 100, n / 2};
+  for (g = 0; g < 3; g++){
+    Npb_workspace ws;
+    double got = approx_exp_of_neg_poisson_binom(n, probs.data(), goals[g],
+            1.0);
+    double want = approx_pmf_of_neg_poisson_binom(ws, n, probs.data(),
+            goals[g], INFINITY).expectation;
+    if (npb_use_product_tree(n, goals[g]) != (goals[g] > crossover) ||
+            fabs(got - want) > PM_TOLERANCE * n * n){
+      printf("n %d goal %d: expectation %.15g, want %.15g\n", n, goals[g],
+              got, want);
+      errors++;
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
@@ -0,0 +1,82 @@
+#include "mex.h"
+#include <algorithm>
+#include <vector>
+#include "knn_mex.h"
+
+/*
+ * probabilities = knn_fictional_probabilities(weights, alpha, train_ind, ...
+ *     observed_labels, fake_ind, fake_labels, test_ind)
+ *
+ * Column j of probabilities is
+ *
+ *   model(problem, [train_ind; fake_ind], ...
+ *         [observed_labels; fake_labels(:, j)], test_ind)
+ *
+ * for the k-NN model, i.e. the probabilities of test_ind under each
+ * column of fictional labels of fake_ind (as in batch_ens.m). The real
+ * observations are accumulated once; the fictional ones are pushed and
+ * popped (see knn_model.h), and the columns are visited in
+ * lexicographic order of their labels, so columns sharing a prefix of
+ * labels only redo the points after it.
+ */
+
+#define WEIGHTS_ARG     prhs[0]
+#define ALPHA_ARG       prhs[1]
+#define TRAIN_IND_ARG   prhs[2]
+#define LABELS_ARG      prhs[3]
+#define FAKE_IND_ARG    prhs[4]
+#define FAKE_LABELS_ARG prhs[5]
+#define TEST_IND_ARG    prhs[6]
+
+#define PROBS_ARG       plhs[0]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *fake_labels, *probs;
+  int num_fake, num_columns, num_test, j;
+
+  if (nrhs < 7)
+    mexErrMsgIdAndTxt("knn_fictional_probabilities:nargin",
+            "7 inputs required");
+
+  /* get input */
+  Knn_weights weights = knn_weights_from_mx(WEIGHTS_ARG,
+          "knn_fictional_probabilities:weights");
+  std::vector<int> train = indices_from_mx(TRAIN_IND_ARG);
+  std::vector<int> fake = indices_from_mx(FAKE_IND_ARG);
+  std::vector<int> test = indices_from_mx(TEST_IND_ARG);
+  num_fake = (int)fake.size();
+  num_test = (int)test.size();
+  num_columns = num_fake > 0 ?
+          (int)(mxGetNumberOfElements(FAKE_LABELS_ARG) / num_fake) : 1;
+  if (num_fake > 0 && (int)mxGetM(FAKE_LABELS_ARG) != num_fake)
+    mexErrMsgIdAndTxt("knn_fictional_probabilities:fake_labels",
+            "fake_labels must have numel(fake_ind) rows");
+  fake_labels = num_fake > 0 ? mxGetPr(FAKE_LABELS_ARG) : NULL;
+
+  Knn_posterior posterior;
+  knn_posterior_init(posterior, weights, mxGetPr(ALPHA_ARG), train.data(),
+          mxGetPr(LABELS_ARG), (int)train.size());
+
+  std::vector<int> order(num_columns);
+  for (j = 0; j < num_columns; j++)
+    order[j] = j;
+  std::sort(order.begin(), order.end(), [=](int a, int b){
+    return std::lexicographical_compare(
+            fake_labels + (size_t)a * num_fake,
+            fake_labels + (size_t)(a+1) * num_fake,
+            fake_labels + (size_t)b * num_fake,
+            fake_labels + (size_t)(b+1) * num_fake);
+  });
+
+  PROBS_ARG = mxCreateDoubleMatrix(num_test, num_columns, mxREAL);
+  probs = mxGetPr(PROBS_ARG);
+  for (j = 0; j < num_columns; j++){
+    int c = order[j];
+    knn_posterior_rebase(posterior, weights, fake.data(),
+            fake_labels + (size_t)c * num_fake, num_fake);
+    knn_probabilities(posterior, test.data(), num_test,
+            probs + (size_t)c * num_test);
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef KNN_MEX_H
+#define KNN_MEX_H
+
+/*
+ * Conversions from Matlab arguments shared by the mex files that call
+ * the native k-NN model; everything else lives in the Matlab-free
+ * headers (see native/active_search.h for the C API over them).
+ */
+
+#include "mex.h"
+#include <vector>
+#include "knn_model.h"
+
+inline Knn_weights knn_weights_from_mx(const mxArray *weights,
+        const char *error_id)
+{
+  /* view of the sparse weights matrix, no copy */
+  if (!mxIsSparse(weights))
+    mexErrMsgIdAndTxt(error_id, "weights must be sparse");
+  Knn_weights w;
+  w.n = (int)mxGetN(weights);
+  w.col_ptr = mxGetJc(weights);
+  w.row_ind = mxGetIr(weights);
+  w.vals = mxGetPr(weights);
+  return w;
+}
+
+inline std::vector<int> indices_from_mx(const mxArray *ind)
+{
+  /* Matlab indices are 1-based */
+  int i, num = (int)mxGetNumberOfElements(ind);
+  std::vector<int> out(num);
+  double *pr = num > 0 ? mxGetPr(ind) : NULL;
+  for (i = 0; i < num; i++)
+    out[i] = (int)pr[i] - 1;
+  return out;
+}
+
+#endif
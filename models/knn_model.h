@@ -0,0 +1,174 @@
+#ifndef KNN_MODEL_H
+#define KNN_MODEL_H
+
+/*
+ * Native version of the k-NN model (knn_model.m in the active_search
+ * toolbox) used by all policies in this repo.
+ *
+ * The weights are the (n x n) sparse matrix built by load_data.m, where
+ * weights(i, j) > 0 means point j is one of the nearest neighbors of i.
+ * We keep Matlab's column-compressed layout, so column j directly lists
+ * the points whose posterior changes when point j gets labeled; this is
+ * the same list as find(weights(:, j)) in the Matlab code.
+ *
+ * The posterior probability of point i being a target is
+ *
+ *   Pr(y_i = 1 | D) = (alpha(1) + successes_i) /
+ *                     (alpha(1) + alpha(2) + successes_i + failures_i)
+ *
+ * where successes_i (failures_i) is the sum of weights(i, j) over the
+ * observed positive (negative) points j.
+ *
+ * Fictional labels (as in batch_ens.m) are pushed on top of the real
+ * observations and popped again: a push adds column j of the weights to
+ * the counts (O(k) for k neighbors, no matter how many points are
+ * observed) and saves the counts it overwrote, so a pop restores them
+ * exactly.
+ */
+
+#include <cstddef>
+#include <vector>
+
+struct Knn_weights{
+  int n = 0;                     /* number of points */
+  const size_t *col_ptr = NULL;  /* n+1 column offsets (Matlab jc) */
+  const size_t *row_ind = NULL;  /* row of each nonzero (Matlab ir) */
+  const double *vals = NULL;     /* value of each nonzero (Matlab pr) */
+};
+
+struct Knn_posterior{
+  double alpha_success = 0;
+  double alpha_failure = 0;
+  std::vector<double> successes;
+  std::vector<double> failures;
+  std::vector<char> observed;    /* 1 if the point is in train_ind */
+
+  /* stack of fictional observations, see knn_posterior_push */
+  std::vector<int> pushed;            /* pushed points */
+  std::vector<char> pushed_positive;  /* their labels */
+  std::vector<char> pushed_observed;  /* observed flag before the push */
+  std::vector<double> saved_counts;   /* counts overwritten by the pushes */
+};
+
+inline void knn_posterior_add(Knn_posterior &post, const Knn_weights &w,
+        int j, bool positive)
+{
+  /* add one more observation of point j (0-based) */
+  std::vector<double> &counts = positive ? post.successes : post.failures;
+  size_t k;
+  post.observed[j] = 1;
+  for (k = w.col_ptr[j]; k < w.col_ptr[j+1]; k++){
+    counts[w.row_ind[k]] += w.vals[k];
+  }
+}
+
+inline void knn_posterior_init(Knn_posterior &post, const Knn_weights &w,
+        const double *alpha, const int *train_ind, const double *labels,
+        int num_train)
+{
+  /*
+   * accumulate successes and failures of all points given the
+   * observations (train_ind is 0-based, label 1 means target)
+   */
+  int i;
+  post.alpha_success = alpha[0];
+  post.alpha_failure = alpha[1];
+  post.successes.assign(w.n, 0);
+  post.failures.assign(w.n, 0);
+  post.observed.assign(w.n, 0);
+  post.pushed.clear();
+  post.pushed_positive.clear();
+  post.pushed_observed.clear();
+  post.saved_counts.clear();
+
+  for (i = 0; i < num_train; i++){
+    knn_posterior_add(post, w, train_ind[i], labels[i] == 1);
+  }
+}
+
+inline double knn_probability(const Knn_posterior &post, int i)
+{
+  double a = post.alpha_success + post.successes[i];
+  return a / (a + post.alpha_failure + post.failures[i]);
+}
+
+inline void knn_posterior_push(Knn_posterior &post, const Knn_weights &w,
+        int j, bool positive)
+{
+  /* add a fictional observation of point j that can be popped again */
+  std::vector<double> &counts = positive ? post.successes : post.failures;
+  size_t k;
+  post.pushed.push_back(j);
+  post.pushed_positive.push_back(positive);
+  post.pushed_observed.push_back(post.observed[j]);
+  post.observed[j] = 1;
+  for (k = w.col_ptr[j]; k < w.col_ptr[j+1]; k++){
+    post.saved_counts.push_back(counts[w.row_ind[k]]);
+    counts[w.row_ind[k]] += w.vals[k];
+  }
+}
+
+inline void knn_posterior_pop(Knn_posterior &post, const Knn_weights &w)
+{
+  /* undo the last knn_posterior_push */
+  int j = post.pushed.back();
+  std::vector<double> &counts = post.pushed_positive.back() ?
+          post.successes : post.failures;
+  size_t k;
+  for (k = w.col_ptr[j+1]; k > w.col_ptr[j]; k--){
+    counts[w.row_ind[k-1]] = post.saved_counts.back();
+    post.saved_counts.pop_back();
+  }
+  post.observed[j] = post.pushed_observed.back();
+  post.pushed.pop_back();
+  post.pushed_positive.pop_back();
+  post.pushed_observed.pop_back();
+}
+
+inline void knn_posterior_rebase(Knn_posterior &post, const Knn_weights &w,
+        const int *points, const double *labels, int num)
+{
+  /*
+   * make the fictional observations equal to points with labels (1 means
+   * target), popping only down to the longest common prefix with what
+   * is pushed now; going through label samples that share most of their
+   * labels therefore only pushes the few that differ
+   */
+  int depth = 0, i;
+  while (depth < num && depth < (int)post.pushed.size() &&
+          post.pushed[depth] == points[depth] &&
+          post.pushed_positive[depth] == (labels[depth] == 1))
+    depth++;
+  while ((int)post.pushed.size() > depth)
+    knn_posterior_pop(post, w);
+  for (i = depth; i < num; i++)
+    knn_posterior_push(post, w, points[i], labels[i] == 1);
+}
+
+inline void knn_probabilities(const Knn_posterior &post, const int *test_ind,
+        int num_test, double *probs)
+{
+  /* same as model(problem, train_ind, observed_labels, test_ind) */
+  int i;
+  for (i = 0; i < num_test; i++){
+    probs[i] = knn_probability(post, test_ind[i]);
+  }
+}
+
+inline double knn_fake_probability(const Knn_posterior &post, int i,
+        double weight, bool positive)
+{
+  /*
+   * probability of point i after additionally observing one of its
+   * neighbors (with weights(i, neighbor) = weight) with the given label
+   */
+  double a = post.alpha_success + post.successes[i];
+  double b = post.alpha_failure + post.failures[i];
+  if (positive)
+    a += weight;
+  else
+    b += weight;
+  return a / (a + b);
+}
+
+#endif
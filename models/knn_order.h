@@ -0,0 +1,325 @@
+#ifndef KNN_ORDER_H
+#define KNN_ORDER_H
+
+/*
+ * Unlabeled points in descending order of their k-NN posterior
+ * probability, kept up to date as observations are added, pushed and
+ * popped (see knn_model.h).
+ *
+ * Labeling point j only changes the probabilities of j and its k
+ * neighbors, so instead of sorting all of them again every step (the
+ * sort(..., 'descend') of ens_min_cost.m, two_step_score.m and
+ * batch_ens.m) knn_order_refresh moves just those points. The order is a
+ * treap whose nodes are the points themselves: node i keeps the
+ * probability of point i as its key, and the size and probability sum
+ * of its subtree, so that
+ *
+ *   - the point at a rank and the rank of a point,
+ *   - the sum of the top "count" probabilities (cumsum in Matlab), and
+ *   - the number of probabilities above a value
+ *
+ * cost O(log n) each, and a refresh O(k log n). Nothing is allocated
+ * after knn_order_init. Ties go to the smaller index, as the stable sort
+ * of ens_context_init, and the priorities are a hash of the point, so
+ * the shape of the tree only depends on the probabilities.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "knn_model.h"
+
+struct Knn_order{
+  int root = -1;
+  std::vector<double> key;         /* probability when last placed */
+  std::vector<int> left;           /* children, -1 if none */
+  std::vector<int> right;
+  std::vector<int> size;           /* points in the subtree, 0 if absent */
+  std::vector<double> sum;         /* sum of their keys */
+  std::vector<uint32_t> priority;  /* heap order, larger on top */
+};
+
+inline bool knn_order_before(const Knn_order &order, int a, int b)
+{
+  /* a comes first: larger probability, then smaller index */
+  return order.key[a] > order.key[b] ||
+          (order.key[a] == order.key[b] && a < b);
+}
+
+inline int knn_order_size_of(const Knn_order &order, int t)
+{
+  return t < 0 ? 0 : order.size[t];
+}
+
+inline double knn_order_sum_of(const Knn_order &order, int t)
+{
+  return t < 0 ? 0 : order.sum[t];
+}
+
+inline void knn_order_update(Knn_order &order, int t)
+{
+  int l = order.left[t], r = order.right[t];
+  order.size[t] = knn_order_size_of(order, l) + 1 +
+          knn_order_size_of(order, r);
+  order.sum[t] = knn_order_sum_of(order, l) + order.key[t] +
+          knn_order_sum_of(order, r);
+}
+
+inline int knn_order_merge(Knn_order &order, int a, int b)
+{
+  /* join two subtrees, every point of a before every point of b */
+  if (a < 0)
+    return b;
+  if (b < 0)
+    return a;
+  if (order.priority[a] > order.priority[b]){
+    order.right[a] = knn_order_merge(order, order.right[a], b);
+    knn_order_update(order, a);
+    return a;
+  }
+  order.left[b] = knn_order_merge(order, a, order.left[b]);
+  knn_order_update(order, b);
+  return b;
+}
+
+inline void knn_order_split(Knn_order &order, int t, int i, int &a,
+        int &b)
+{
+  /* subtree t into a, the points before point i, and b, the others */
+  if (t < 0){
+    a = b = -1;
+    return;
+  }
+  if (knn_order_before(order, t, i)){
+    knn_order_split(order, order.right[t], i, order.right[t], b);
+    a = t;
+  }
+  else {
+    knn_order_split(order, order.left[t], i, a, order.left[t]);
+    b = t;
+  }
+  knn_order_update(order, t);
+}
+
+inline int knn_order_insert_into(Knn_order &order, int t, int i)
+{
+  /* subtree t with point i added (its key set, its links cleared) */
+  if (t < 0 || order.priority[i] > order.priority[t]){
+    knn_order_split(order, t, i, order.left[i], order.right[i]);
+    knn_order_update(order, i);
+    return i;
+  }
+  if (knn_order_before(order, i, t))
+    order.left[t] = knn_order_insert_into(order, order.left[t], i);
+  else
+    order.right[t] = knn_order_insert_into(order, order.right[t], i);
+  knn_order_update(order, t);
+  return t;
+}
+
+inline int knn_order_erase_from(Knn_order &order, int t, int i)
+{
+  /* subtree t without point i, which must be in it */
+  if (t == i){
+    int joined = knn_order_merge(order, order.left[i], order.right[i]);
+    order.left[i] = order.right[i] = -1;
+    order.size[i] = 0;
+    order.sum[i] = 0;
+    return joined;
+  }
+  if (knn_order_before(order, i, t))
+    order.left[t] = knn_order_erase_from(order, order.left[t], i);
+  else
+    order.right[t] = knn_order_erase_from(order, order.right[t], i);
+  knn_order_update(order, t);
+  return t;
+}
+
+inline uint32_t knn_order_priority(uint32_t i)
+{
+  /* murmur3 finalizer */
+  i ^= i >> 16;
+  i *= 0x85EBCA6BU;
+  i ^= i >> 13;
+  i *= 0xC2B2AE35U;
+  i ^= i >> 16;
+  return i;
+}
+
+inline void knn_order_sums(Knn_order &order, int t)
+{
+  /* sizes and sums of a freshly linked subtree, children first */
+  if (t < 0)
+    return;
+  knn_order_sums(order, order.left[t]);
+  knn_order_sums(order, order.right[t]);
+  knn_order_update(order, t);
+}
+
+inline void knn_order_init(Knn_order &order, const Knn_posterior &post,
+        int n)
+{
+  /* every unobserved point of post, placed by its probability */
+  std::vector<int> sorted, stack;
+  int i;
+
+  order.key.assign(n, 0);
+  order.left.assign(n, -1);
+  order.right.assign(n, -1);
+  order.size.assign(n, 0);
+  order.sum.assign(n, 0);
+  order.priority.resize(n);
+  for (i = 0; i < n; i++){
+    order.priority[i] = knn_order_priority((uint32_t)i);
+    if (post.observed[i]) continue;
+    order.key[i] = knn_probability(post, i);
+    sorted.push_back(i);
+  }
+  std::sort(sorted.begin(), sorted.end(), [&order](int a, int b){
+    return knn_order_before(order, a, b);
+  });
+
+  /* treap of a sorted list in linear time: the right spine is a stack */
+  for (int x : sorted){
+    int last = -1;
+    while (!stack.empty() &&
+            order.priority[stack.back()] < order.priority[x]){
+      last = stack.back();
+      stack.pop_back();
+    }
+    order.left[x] = last;
+    if (!stack.empty())
+      order.right[stack.back()] = x;
+    stack.push_back(x);
+  }
+  order.root = stack.empty() ? -1 : stack.front();
+  knn_order_sums(order, order.root);
+}
+
+inline void knn_order_place(Knn_order &order, const Knn_posterior &post,
+        int i)
+{
+  /* put point i where its current probability belongs, if unobserved */
+  if (order.size[i] > 0){
+    if (!post.observed[i] && order.key[i] == knn_probability(post, i))
+      return;
+    order.root = knn_order_erase_from(order, order.root, i);
+  }
+  if (post.observed[i])
+    return;
+  order.key[i] = knn_probability(post, i);
+  order.root = knn_order_insert_into(order, order.root, i);
+}
+
+inline void knn_order_refresh(Knn_order &order, const Knn_posterior &post,
+        const Knn_weights &w, int j)
+{
+  /*
+   * after knn_posterior_add, knn_posterior_push or knn_posterior_pop of
+   * point j: move j and the points whose probability it changed
+   */
+  size_t k;
+  knn_order_place(order, post, j);
+  for (k = w.col_ptr[j]; k < w.col_ptr[j+1]; k++)
+    knn_order_place(order, post, (int)w.row_ind[k]);
+}
+
+inline int knn_order_size(const Knn_order &order)
+{
+  /* number of unobserved points */
+  return knn_order_size_of(order, order.root);
+}
+
+inline int knn_order_at(const Knn_order &order, int rank)
+{
+  /* point at a 0-based rank, -1 if rank is out of range */
+  int t = order.root;
+  if (rank < 0 || rank >= knn_order_size(order))
+    return -1;
+  while (true){
+    int before = knn_order_size_of(order, order.left[t]);
+    if (rank == before)
+      return t;
+    if (rank < before)
+      t = order.left[t];
+    else {
+      rank -= before + 1;
+      t = order.right[t];
+    }
+  }
+}
+
+inline int knn_order_rank(const Knn_order &order, int i)
+{
+  /* 0-based rank of point i, -1 if it is observed */
+  int t = order.root, rank = 0;
+  if (order.size[i] == 0)
+    return -1;
+  while (t != i){
+    if (knn_order_before(order, i, t))
+      t = order.left[t];
+    else {
+      rank += knn_order_size_of(order, order.left[t]) + 1;
+      t = order.right[t];
+    }
+  }
+  return rank + knn_order_size_of(order, order.left[i]);
+}
+
+inline double knn_order_top_sum(const Knn_order &order, int count)
+{
+  /* sum of the top "count" probabilities (all of them if fewer) */
+  int t = order.root;
+  double sum = 0;
+  while (t >= 0 && count > 0){
+    int before = knn_order_size_of(order, order.left[t]);
+    if (count <= before)
+      t = order.left[t];
+    else {
+      sum += knn_order_sum_of(order, order.left[t]) + order.key[t];
+      count -= before + 1;
+      t = order.right[t];
+    }
+  }
+  return sum;
+}
+
+inline int knn_order_count_greater(const Knn_order &order, double value)
+{
+  /* number of probabilities larger than value */
+  int t = order.root, count = 0;
+  while (t >= 0){
+    if (order.key[t] > value){
+      count += knn_order_size_of(order, order.left[t]) + 1;
+      t = order.right[t];
+    }
+    else
+      t = order.left[t];
+  }
+  return count;
+}
+
+inline void knn_order_collect(const Knn_order &order, int t, int num,
+        int *top_ind, int &count)
+{
+  /* in-order walk of subtree t, stopping after num points */
+  if (t < 0 || count >= num)
+    return;
+  knn_order_collect(order, order.left[t], num, top_ind, count);
+  if (count < num)
+    top_ind[count++] = t;
+  knn_order_collect(order, order.right[t], num, top_ind, count);
+}
+
+inline int knn_order_top(const Knn_order &order, int num, int *top_ind)
+{
+  /*
+   * the first num points (all if fewer) in order, as top_ind of
+   * sort(probs, 'descend'); returns how many were written
+   */
+  int count = 0;
+  knn_order_collect(order, order.root, num, top_ind, count);
+  return count;
+}
+
+#endif
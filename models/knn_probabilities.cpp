@@ -0,0 +1,40 @@
+#include "mex.h"
+#include <vector>
+#include "knn_mex.h"
+
+/*
+ * probabilities = knn_probabilities(weights, alpha, train_ind, ...
+ *     observed_labels, test_ind)
+ *
+ * Native version of model(problem, train_ind, observed_labels, test_ind)
+ * for the k-NN model (see knn_model.h).
+ */
+
+#define WEIGHTS_ARG   prhs[0]
+#define ALPHA_ARG     prhs[1]
+#define TRAIN_IND_ARG prhs[2]
+#define LABELS_ARG    prhs[3]
+#define TEST_IND_ARG  prhs[4]
+
+#define PROBS_ARG     plhs[0]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  if (nrhs < 5)
+    mexErrMsgIdAndTxt("knn_probabilities:nargin", "5 inputs required");
+
+  /* get input */
+  Knn_weights weights = knn_weights_from_mx(WEIGHTS_ARG,
+          "knn_probabilities:weights");
+  std::vector<int> train = indices_from_mx(TRAIN_IND_ARG);
+  std::vector<int> test = indices_from_mx(TEST_IND_ARG);
+
+  Knn_posterior posterior;
+  knn_posterior_init(posterior, weights, mxGetPr(ALPHA_ARG), train.data(),
+          mxGetPr(LABELS_ARG), (int)train.size());
+
+  PROBS_ARG = mxCreateDoubleMatrix(test.size(), 1, mxREAL);
+  knn_probabilities(posterior, test.data(), (int)test.size(),
+          mxGetPr(PROBS_ARG));
+}
@@ -0,0 +1,80 @@
+#ifndef TEST_KNN_GRAPH_H
+#define TEST_KNN_GRAPH_H
+
+/*
+ * Random k-NN graphs for the test programs, both as the neighbor lists of
+ * knn_graph_file.h and as the sparse weights of knn_model.h (column j
+ * lists the points that have j among their neighbors, as Matlab's
+ * weights(:, j)). A point drawn twice as the neighbor of the same point
+ * is kept once.
+ */
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "knn_model.h"
+
+struct Test_graph{
+  std::vector<uint64_t> neighbor_ptr;   /* n+1 offsets of the lists */
+  std::vector<uint32_t> neighbor_ind;
+  std::vector<double> neighbor_val;
+  std::vector<size_t> col_ptr, row_ind;  /* the transpose, by column */
+  std::vector<double> vals;
+  Knn_weights w;                         /* points into the columns */
+};
+
+inline void test_graph_point_weights(Test_graph &g)
+{
+  /* point g.w at g's columns, e.g. after copying g */
+  g.w.n = (int)g.col_ptr.size() - 1;
+  g.w.col_ptr = g.col_ptr.data();
+  g.w.row_ind = g.row_ind.data();
+  g.w.vals = g.vals.data();
+}
+
+inline void test_random_graph(Test_graph &g, int n, int k,
+        int num_neighbors, bool integer_weights, std::mt19937_64 &gen)
+{
+  /*
+   * up to k neighbors per point among the first num_neighbors points
+   * (with num_neighbors < n the columns of the others are empty, as for
+   * the points of real data that are nobody's neighbor); weights are
+   * uniform in (0, 1), or 1, 2 or 3 with integer_weights, so that many
+   * probabilities tie and sums are exact
+   */
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<std::vector<std::pair<size_t, double> > > columns(n);
+  int i, j;
+  uint64_t e;
+
+  g.neighbor_ptr.assign(1, 0);
+  g.neighbor_ind.clear();
+  g.neighbor_val.clear();
+  for (i = 0; i < n; i++){
+    for (j = 0; j < k; j++){
+      uint32_t neighbor = (uint32_t)(gen() % num_neighbors);
+      double val = integer_weights ? (double)(1 + gen() % 3) : uniform(gen);
+      bool repeated = neighbor == (uint32_t)i;
+      for (e = g.neighbor_ptr.back(); e < g.neighbor_ind.size(); e++)
+        repeated = repeated || g.neighbor_ind[e] == neighbor;
+      if (repeated) continue;
+      g.neighbor_ind.push_back(neighbor);
+      g.neighbor_val.push_back(val);
+      columns[neighbor].push_back(std::make_pair((size_t)i, val));
+    }
+    g.neighbor_ptr.push_back(g.neighbor_ind.size());
+  }
+  g.col_ptr.assign(1, 0);
+  g.row_ind.clear();
+  g.vals.clear();
+  for (j = 0; j < n; j++){
+    for (size_t c = 0; c < columns[j].size(); c++){
+      g.row_ind.push_back(columns[j][c].first);
+      g.vals.push_back(columns[j][c].second);
+    }
+    g.col_ptr.push_back(g.row_ind.size());
+  }
+  test_graph_point_weights(g);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "knn_order.h"
+#include "test_knn_graph.h"
+
+/*
+ * Checks the treap order of knn_order.h against sort(probs, 'descend')
+ * of the unlabeled points (a stable sort, ties to the smaller index)
+ * after every observation, push and pop on a random graph: the point at
+ * each rank, the rank of each point, the top "count" sums (cumsum), the
+ * number of probabilities above a value and knn_order_top. The weights
+ * are small integers, so that many probabilities tie. Returns 1 on
+ * failure.
+ */
+
+static int check(const char *what, int step, const Knn_order &order,
+        const Knn_posterior &post, int n)
+{
+  /* the order against a stable sort of the current probabilities */
+  std::vector<int> want, top(n);
+  std::vector<double> probs(n, 0);
+  int i, r, count, errors = 0;
+  double sum = 0;
+
+  for (i = 0; i < n; i++){
+    if (post.observed[i]) continue;
+    probs[i] = knn_probability(post, i);
+    want.push_back(i);
+  }
+  std::stable_sort(want.begin(), want.end(), [&probs](int a, int b){
+    return probs[a] > probs[b];
+  });
+  int num = (int)want.size();
+  if (knn_order_size(order) != num ||
+          knn_order_top(order, n, top.data()) != num){
+    printf("%s %d: %d points, want %d\n", what, step,
+            knn_order_size(order), num);
+    return 1;
+  }
+  for (r = 0; r < num; r++){
+    sum += probs[want[r]];
+    if (knn_order_at(order, r) != want[r] || top[r] != want[r] ||
+            knn_order_rank(order, want[r]) != r){
+      if (errors < 10)
+        printf("%s %d: rank %d holds %d, want %d\n", what, step, r,
+                knn_order_at(order, r), want[r]);
+      errors++;
+    }
+    if (fabs(knn_order_top_sum(order, r + 1) - sum) > 1e-12 * num){
+      if (errors < 10)
+        printf("%s %d: top %d sum %.17g, want %.17g\n", what, step, r + 1,
+                knn_order_top_sum(order, r + 1), sum);
+      errors++;
+    }
+    /* every probability and one just below it as thresholds */
+    double value = probs[want[r]];
+    for (int pass = 0; pass < 2; pass++){
+      count = 0;
+      for (i = 0; i < num; i++)
+        count += probs[want[i]] > value;
+      if (knn_order_count_greater(order, value) != count){
+        if (errors < 10)
+          printf("%s %d: %d above %.17g, want %d\n", what, step,
+                  knn_order_count_greater(order, value), value, count);
+        errors++;
+      }
+      value = nextafter(value, 0.0);
+    }
+  }
+  for (i = 0; i < n; i++){
+    if (post.observed[i] && knn_order_rank(order, i) != -1){
+      printf("%s %d: observed %d has a rank\n", what, step, i);
+      errors++;
+    }
+  }
+  if (knn_order_at(order, num) != -1 || knn_order_at(order, -1) != -1)
+    errors++;
+  return errors;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  double alpha[2] = {0.1, 0.9};
+  int n = 300, step, errors = 0;
+  Test_graph g;
+  Knn_posterior post;
+  Knn_order order;
+  std::vector<int> train;
+  std::vector<double> labels;
+
+  test_random_graph(g, n, 6, n, true, gen);
+  for (int i = 0; i < 10; i++){
+    train.push_back(i * 7);
+    labels.push_back(i % 3 == 0 ? 1 : 0);
+  }
+  knn_posterior_init(post, g.w, alpha, train.data(), labels.data(),
+          (int)train.size());
+  knn_order_init(order, post, n);
+  errors += check("init", 0, order, post, n);
+
+  for (step = 1; step <= 60 && errors == 0; step++){
+    /* an observation, then fictional ones pushed and popped again */
+    int x = (int)(gen() % n), depth, d;
+    if (!post.observed[x]){
+      knn_posterior_add(post, g.w, x, gen() % 2);
+      knn_order_refresh(order, post, g.w, x);
+      errors += check("add", step, order, post, n);
+    }
+    depth = 1 + (int)(gen() % 4);
+    for (d = 0; d < depth; d++){
+      x = (int)(gen() % n);
+      knn_posterior_push(post, g.w, x, gen() % 2);
+      knn_order_refresh(order, post, g.w, x);
+      errors += check("push", step, order, post, n);
+    }
+    for (d = 0; d < depth; d++){
+      x = post.pushed.back();
+      knn_posterior_pop(post, g.w);
+      knn_order_refresh(order, post, g.w, x);
+      errors += check("pop", step, order, post, n);
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
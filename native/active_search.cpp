@@ -0,0 +1,407 @@
+#include <new>
+#include <vector>
+#include "active_search.h"
+#include "../models/knn_model.h"
+#include "../models/knn_order.h"
+#include "../score_functions/ens_score.h"
+#include "../query_strategies/batch_ens_score.h"
+#include "../query_strategies/top_k_select.h"
+#include "../min_cost/npb_batch.h"
+#include "knn_graph_file.h"
+
+/*
+ * Implementation of the C API in active_search.h. Everything here only
+ * checks arguments, owns memory and catches exceptions; the work is done
+ * by the same headers the mex files use.
+ */
+
+struct as_graph{
+  std::vector<size_t> ptr;
+  std::vector<size_t> row_ind;
+  std::vector<double> vals;
+  Knn_graph_map map;    /* if opened from a file */
+  Knn_weights weights;  /* points into the vectors or the map */
+};
+
+struct as_model{
+  const as_graph *graph = NULL;
+  Knn_posterior posterior;
+  Knn_order order;      /* unlabeled points by probability */
+  int num_observed = 0;
+};
+
+static int exception_status()
+{
+  /* status code of the exception being handled */
+  try {
+    throw;
+  }
+  catch (const std::bad_alloc&) {
+    return AS_ERROR_MEMORY;
+  }
+  catch (...) {
+    return AS_ERROR_INTERNAL;
+  }
+}
+
+static bool valid_indices(const int *ind, int num, int n)
+{
+  int i;
+  if (num > 0 && ind == NULL)
+    return false;
+  for (i = 0; i < num; i++){
+    if (ind[i] < 0 || ind[i] >= n)
+      return false;
+  }
+  return true;
+}
+
+int as_api_version(void)
+{
+  return AS_API_VERSION;
+}
+
+const char* as_status_string(int status)
+{
+  switch (status){
+    case AS_OK:             return "ok";
+    case AS_ERROR_ARGUMENT: return "invalid argument";
+    case AS_ERROR_MEMORY:   return "out of memory";
+    case AS_ERROR_INTERNAL: return "internal error";
+    case AS_ERROR_IO:       return "cannot read file";
+  }
+  return "unknown status";
+}
+
+int as_graph_create(int n, const size_t *ptr, const size_t *row_ind,
+        const double *vals, as_graph **graph)
+{
+  int j;
+  size_t k;
+  if (graph == NULL || n < 0 || ptr == NULL)
+    return AS_ERROR_ARGUMENT;
+  *graph = NULL;
+  if (ptr[0] != 0)
+    return AS_ERROR_ARGUMENT;
+  for (j = 0; j < n; j++){
+    if (ptr[j+1] < ptr[j])
+      return AS_ERROR_ARGUMENT;
+  }
+  if (ptr[n] > 0 && (row_ind == NULL || vals == NULL))
+    return AS_ERROR_ARGUMENT;
+  for (k = 0; k < ptr[n]; k++){
+    if (row_ind[k] >= (size_t)n)
+      return AS_ERROR_ARGUMENT;
+  }
+
+  try {
+    as_graph *g = new as_graph;
+    g->ptr.assign(ptr, ptr + n + 1);
+    g->row_ind.assign(row_ind, row_ind + ptr[n]);
+    g->vals.assign(vals, vals + ptr[n]);
+    g->weights.n = n;
+    g->weights.col_ptr = g->ptr.data();
+    g->weights.row_ind = g->row_ind.data();
+    g->weights.vals = g->vals.data();
+    *graph = g;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_graph_open(const char *path, as_graph **graph)
+{
+  if (path == NULL || graph == NULL)
+    return AS_ERROR_ARGUMENT;
+  *graph = NULL;
+  try {
+    as_graph *g = new as_graph;
+    if (!knn_graph_map_open(g->map, path, NULL)){
+      delete g;
+      return AS_ERROR_IO;
+    }
+    g->weights = g->map.weights;
+    *graph = g;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+void as_graph_free(as_graph *graph)
+{
+  delete graph;
+}
+
+int as_graph_num_points(const as_graph *graph)
+{
+  return graph ? graph->weights.n : 0;
+}
+
+int as_model_create(const as_graph *graph, double alpha_success,
+        double alpha_failure, as_model **model)
+{
+  if (graph == NULL || model == NULL ||
+          !(alpha_success > 0) || !(alpha_failure > 0))
+    return AS_ERROR_ARGUMENT;
+  *model = NULL;
+
+  try {
+    double alpha[2] = {alpha_success, alpha_failure};
+    as_model *m = new as_model;
+    m->graph = graph;
+    knn_posterior_init(m->posterior, graph->weights, alpha, NULL, NULL, 0);
+    knn_order_init(m->order, m->posterior, graph->weights.n);
+    *model = m;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+void as_model_free(as_model *model)
+{
+  delete model;
+}
+
+int as_model_reset(as_model *model)
+{
+  if (model == NULL)
+    return AS_ERROR_ARGUMENT;
+  try {
+    double alpha[2] = {model->posterior.alpha_success,
+            model->posterior.alpha_failure};
+    knn_posterior_init(model->posterior, model->graph->weights, alpha,
+            NULL, NULL, 0);
+    knn_order_init(model->order, model->posterior, model->graph->weights.n);
+    model->num_observed = 0;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_model_observe(as_model *model, int index, int positive)
+{
+  if (model == NULL || !model->posterior.pushed.empty() ||
+          !valid_indices(&index, 1, model->graph->weights.n))
+    return AS_ERROR_ARGUMENT;
+  knn_posterior_add(model->posterior, model->graph->weights, index,
+          positive != 0);
+  knn_order_refresh(model->order, model->posterior, model->graph->weights,
+          index);
+  model->num_observed++;
+  return AS_OK;
+}
+
+int as_model_num_observed(const as_model *model)
+{
+  return model ? model->num_observed : 0;
+}
+
+int as_model_push(as_model *model, int index, int positive)
+{
+  if (model == NULL || !valid_indices(&index, 1, model->graph->weights.n))
+    return AS_ERROR_ARGUMENT;
+  try {
+    knn_posterior_push(model->posterior, model->graph->weights, index,
+            positive != 0);
+    knn_order_refresh(model->order, model->posterior, model->graph->weights,
+            index);
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_model_pop(as_model *model)
+{
+  int index;
+  if (model == NULL || model->posterior.pushed.empty())
+    return AS_ERROR_ARGUMENT;
+  index = model->posterior.pushed.back();
+  knn_posterior_pop(model->posterior, model->graph->weights);
+  knn_order_refresh(model->order, model->posterior, model->graph->weights,
+          index);
+  return AS_OK;
+}
+
+int as_model_num_pushed(const as_model *model)
+{
+  return model ? (int)model->posterior.pushed.size() : 0;
+}
+
+int as_model_probabilities(const as_model *model, const int *test_ind,
+        int num_test, double *probs)
+{
+  if (model == NULL || num_test < 0 || (num_test > 0 && probs == NULL) ||
+          !valid_indices(test_ind, num_test, model->graph->weights.n))
+    return AS_ERROR_ARGUMENT;
+  knn_probabilities(model->posterior, test_ind, num_test, probs);
+  return AS_OK;
+}
+
+int as_model_num_unlabeled(const as_model *model)
+{
+  return model ? knn_order_size(model->order) : 0;
+}
+
+int as_model_top(const as_model *model, int num, int *top_ind)
+{
+  if (model == NULL || num < 0 || num > knn_order_size(model->order) ||
+          (num > 0 && top_ind == NULL))
+    return AS_ERROR_ARGUMENT;
+  knn_order_top(model->order, num, top_ind);
+  return AS_OK;
+}
+
+int as_model_rank(const as_model *model, int index, int *rank)
+{
+  if (model == NULL || rank == NULL ||
+          !valid_indices(&index, 1, model->graph->weights.n))
+    return AS_ERROR_ARGUMENT;
+  *rank = knn_order_rank(model->order, index);
+  return AS_OK;
+}
+
+int as_model_top_sum(const as_model *model, int count, double *sum)
+{
+  if (model == NULL || sum == NULL || count < 0)
+    return AS_ERROR_ARGUMENT;
+  *sum = knn_order_top_sum(model->order, count);
+  return AS_OK;
+}
+
+int as_ens_scores(const as_model *model, const int *candidates,
+        int num_candidates, int budget, const double *upper_bound,
+        double *scores, char *pruned, int *best)
+{
+  const Knn_weights *w;
+  if (model == NULL || !model->posterior.pushed.empty() ||
+          num_candidates < 0 || (num_candidates > 0 && scores == NULL))
+    return AS_ERROR_ARGUMENT;
+  w = &model->graph->weights;
+  if (!valid_indices(candidates, num_candidates, w->n))
+    return AS_ERROR_ARGUMENT;
+
+  try {
+    Ens_context ctx;
+    ens_context_init_ordered(ctx, *w, model->posterior, model->order);
+    int b = ens_scores(ctx, candidates, num_candidates, budget, upper_bound,
+            scores, pruned);
+    if (best)
+      *best = b;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_batch_ens_scores(const as_model *model, const int *selected,
+        int num_selected, const double *samples,
+        const double *sample_weights, int num_samples,
+        const int *candidates, const double *probs, int num_candidates,
+        int budget, const double *upper_bound, int num_threads,
+        double *scores, char *pruned, int *best)
+{
+  const Knn_weights *w;
+  if (model == NULL || !model->posterior.pushed.empty() ||
+          num_selected < 0 || num_samples <= 0 ||
+          num_candidates < 0 || sample_weights == NULL ||
+          (num_selected > 0 && samples == NULL) ||
+          (num_candidates > 0 && (probs == NULL || scores == NULL)))
+    return AS_ERROR_ARGUMENT;
+  w = &model->graph->weights;
+  if (!valid_indices(selected, num_selected, w->n) ||
+          !valid_indices(candidates, num_candidates, w->n))
+    return AS_ERROR_ARGUMENT;
+  if (num_threads <= 0)
+    num_threads = default_num_threads();
+
+  try {
+    Batch_ens_samples s;
+    batch_ens_samples_init(s, *w, model->posterior, selected, num_selected,
+            samples, num_samples, budget, num_threads);
+    int b = batch_ens_scores(s, sample_weights, candidates, probs,
+            num_candidates, budget, upper_bound, num_threads, scores,
+            pruned, NULL);
+    if (best)
+      *best = b;
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_top_k_select(const double *probs, int n, int num_greedy,
+        int num_uncertain, int *greedy, int *uncertain)
+{
+  if (n < 0 || (n > 0 && probs == NULL) || num_greedy < 0 ||
+          num_uncertain < 0 || (num_greedy > 0 && greedy == NULL) ||
+          (num_uncertain > 0 && uncertain == NULL))
+    return AS_ERROR_ARGUMENT;
+  try {
+    top_k_select(probs, n, num_greedy, num_uncertain, greedy, uncertain,
+            NULL);
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_npb_expectation(const double *p, int n, int num_heads,
+        double approx_one, double *expectation)
+{
+  if (n < 0 || (n > 0 && p == NULL) || expectation == NULL)
+    return AS_ERROR_ARGUMENT;
+  try {
+    *expectation = approx_exp_of_neg_poisson_binom(n, (double*)p,
+            num_heads, approx_one);
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
+
+int as_npb_expectations(const double *p, int n,
+        const as_npb_query *queries, int num_queries, double approx_one,
+        double *expectations)
+{
+  int i;
+  if (n < 0 || (n > 0 && p == NULL) || num_queries < 0 ||
+          (num_queries > 0 && (queries == NULL || expectations == NULL)))
+    return AS_ERROR_ARGUMENT;
+  for (i = 0; i < num_queries; i++){
+    if (queries[i].num_excluded < 0 || queries[i].num_q < 0 ||
+            !valid_indices(queries[i].excluded, queries[i].num_excluded, n) ||
+            (queries[i].num_q > 0 && queries[i].q == NULL))
+      return AS_ERROR_ARGUMENT;
+  }
+
+  try {
+    std::vector<Npb_query> batch(num_queries);
+    for (i = 0; i < num_queries; i++){
+      batch[i].excluded = queries[i].excluded;
+      batch[i].num_excluded = queries[i].num_excluded;
+      batch[i].q = queries[i].q;
+      batch[i].num_q = queries[i].num_q;
+      batch[i].num_heads = queries[i].num_heads;
+    }
+    npb_expectations_batch(p, n, batch.data(), num_queries, approx_one,
+            expectations);
+    return AS_OK;
+  }
+  catch (...) {
+    return exception_status();
+  }
+}
@@ -0,0 +1,162 @@
+#ifndef ACTIVE_SEARCH_H
+#define ACTIVE_SEARCH_H
+
+/*
+ * C API of the native active search code, for running ENS, batch-ENS and
+ * cost effective ENS without Matlab.
+ *
+ * The library is active_search.cpp compiled on its own, e.g.
+ *
+ *   g++ -O2 -pthread -fPIC -shared -o libactive_search.so \
+ *       native/active_search.cpp
+ *
+ * and calls the same header-only code as the mex files (models/,
+ * score_functions/, query_strategies/ and min_cost/), so both give the
+ * same results.
+ *
+ * Conventions:
+ *   - all indices are 0-based;
+ *   - every function that can fail returns an AS_* status code, and
+ *     results are written through output pointers;
+ *   - objects are opaque and created/freed by the library; a graph must
+ *     outlive every model built on it, and a model may be read from
+ *     several threads as long as nobody updates it at the same time.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever a signature below changes */
+#define AS_API_VERSION 1
+
+enum{
+  AS_OK = 0,
+  AS_ERROR_ARGUMENT = 1,  /* bad pointer, size or index */
+  AS_ERROR_MEMORY = 2,    /* allocation failed */
+  AS_ERROR_INTERNAL = 3,  /* any other exception */
+  AS_ERROR_IO = 4         /* file missing or not in the expected format */
+};
+
+typedef struct as_graph as_graph;  /* k-NN weights */
+typedef struct as_model as_model;  /* k-NN posterior given observations */
+
+/* one query of as_npb_expectations (see min_cost/npb_batch.h) */
+typedef struct as_npb_query{
+  const int *excluded;  /* positions in p to remove, ascending */
+  int num_excluded;
+  const double *q;      /* probabilities to merge in, descending */
+  int num_q;
+  int num_heads;        /* remaining goal */
+} as_npb_query;
+
+int as_api_version(void);
+const char* as_status_string(int status);
+
+/*
+ * Graph of n points in compressed sparse layout, one list per point j
+ * with the points whose posterior changes when j is labeled, i.e. the
+ * columns of the weights matrix of load_data.m (or the rows of its
+ * transpose): the list of j is row_ind[ptr[j]] .. row_ind[ptr[j+1]-1]
+ * with weights vals[...]. The arrays are copied.
+ */
+int as_graph_create(int n, const size_t *ptr, const size_t *row_ind,
+        const double *vals, as_graph **graph);
+/*
+ * graph memory mapped from a k-NN graph file (native/knn_graph_file.h),
+ * used without copying
+ */
+int as_graph_open(const char *path, as_graph **graph);
+void as_graph_free(as_graph *graph);
+int as_graph_num_points(const as_graph *graph);
+
+/* model with prior pseudo counts alpha_success and alpha_failure */
+int as_model_create(const as_graph *graph, double alpha_success,
+        double alpha_failure, as_model **model);
+void as_model_free(as_model *model);
+/* forget all observations */
+int as_model_reset(as_model *model);
+/* observe point index with label positive (1) or negative (0) */
+int as_model_observe(as_model *model, int index, int positive);
+int as_model_num_observed(const as_model *model);
+
+/*
+ * fictional observations on top of the real ones: push costs
+ * O(k log n) for k neighbors of index and pop restores the model
+ * exactly; observe and the scoring functions need an empty push stack
+ */
+int as_model_push(as_model *model, int index, int positive);
+int as_model_pop(as_model *model);
+int as_model_num_pushed(const as_model *model);
+
+/* probabilities of test_ind being targets, as knn_model in Matlab */
+int as_model_probabilities(const as_model *model, const int *test_ind,
+        int num_test, double *probs);
+
+/*
+ * the model keeps its unlabeled (neither observed nor pushed) points in
+ * descending order of probability, ties to the smaller index, moving
+ * only the neighbors of the point on every observe, push and pop (see
+ * models/knn_order.h), so these cost O(log n) instead of a sort:
+ * top_ind gets the first num <= as_model_num_unlabeled points, rank the
+ * position of index (-1 if it is labeled) and sum the sum of the top
+ * count probabilities (all of them if fewer)
+ */
+int as_model_num_unlabeled(const as_model *model);
+int as_model_top(const as_model *model, int num, int *top_ind);
+int as_model_rank(const as_model *model, int index, int *rank);
+int as_model_top_sum(const as_model *model, int count, double *sum);
+
+/*
+ * ENS scores of the candidates with the given remaining budget, see
+ * score_functions/ens_scores.cpp; upper_bound and pruned may be NULL,
+ * best gets the position of the chosen candidate (-1 if none)
+ */
+int as_ens_scores(const as_model *model, const int *candidates,
+        int num_candidates, int budget, const double *upper_bound,
+        double *scores, char *pruned, int *best);
+
+/*
+ * batch-ENS scores, see query_strategies/batch_ens_scores.cpp: samples is
+ * (num_selected x num_samples) column-major with fictional labels (1 for
+ * positive) of the points already in the batch, probs the current
+ * probabilities of the candidates, and num_threads <= 0 uses all cores.
+ * The samples only keep the counts the batch changes and their top
+ * budget + k points (see query_strategies/batch_ens_score.h), so with a
+ * graph from as_graph_open the memory is O(n) for the model plus
+ * O(num_samples (k num_selected + budget))
+ */
+int as_batch_ens_scores(const as_model *model, const int *selected,
+        int num_selected, const double *samples,
+        const double *sample_weights, int num_samples,
+        const int *candidates, const double *probs, int num_candidates,
+        int budget, const double *upper_bound, int num_threads,
+        double *scores, char *pruned, int *best);
+
+/*
+ * batch of the greedy and uncertainty baselines, see
+ * query_strategies/top_k_select.h: greedy gets the positions of the
+ * min(num_greedy, n) largest probs in descending order, uncertain those
+ * of the min(num_uncertain, n) closest to 0.5, ties to the smaller
+ * position; one pass, no sort
+ */
+int as_top_k_select(const double *probs, int n, int num_greedy,
+        int num_uncertain, int *greedy, int *uncertain);
+
+/*
+ * expected number of coins (probabilities p in descending order) to
+ * toss for num_heads heads, the cost estimate of ens_min_cost.m
+ */
+int as_npb_expectation(const double *p, int n, int num_heads,
+        double approx_one, double *expectation);
+int as_npb_expectations(const double *p, int n,
+        const as_npb_query *queries, int num_queries, double approx_one,
+        double *expectations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
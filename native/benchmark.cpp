@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "../min_cost/negative_binomial_distribution.h"
+#include "../min_cost/npb_monte_carlo.h"
+#include "../score_functions/merge_sort.h"
+#include "../query_strategies/merge_sum.h"
+
+/*
+ * benchmark [-r repeats] [-w warmup] [-k kernel] [-t threads] [-q]
+ *     [-l label] [-o file]
+ *
+ * Times the cost and merge kernels on a sweep of problems and writes the
+ * results as JSON, so runs of different releases can be compared.
+ *
+ * Kernels:
+ *   dp_exact      expectation_of_neg_poisson_binom, exact DP (all coins)
+ *   dp_truncated  approx_exp_of_neg_poisson_binom, approx_one = 1 - 1e-9,
+ *                 with a workspace kept across repeats as ens_min_cost
+ *                 keeps it
+ *   monte_carlo   npb_monte_carlo, a fixed number of samples
+ *   merge_sort    merge_sort_sum (score_functions/merge_sort.h)
+ *   merge_sum     merge_sum_cost (query_strategies/merge_sum.h)
+ *
+ * Problems sweep the number of points n, the goal (num_heads or budget)
+ * and the skew s of the probabilities: u^s for uniform u, sorted in
+ * descending order as the callers pass them (s > 1: mostly small).
+ *
+ * Each problem runs "warmup" untimed and "repeats" timed repetitions;
+ * every result lists the minimum, median and mean of the wall and CPU
+ * (process) time of one repetition, the heap allocations and bytes per
+ * repetition (counted by the replacements of every operator new and
+ * delete below, which all go through malloc), the throughput of the
+ * median in calls and points per second, and a checksum of the outputs.
+ *
+ *   -k  only kernels whose name contains this string
+ *   -t  threads of monte_carlo (default all cores)
+ *   -q  small sweep, for a quick check
+ *   -l  label stored with the results (e.g. the release)
+ *   -o  output file (default standard output)
+ *
+ * Build with
+ *
+ *   g++ -O3 -march=native -pthread -o benchmark native/benchmark.cpp
+ *
+ * or with the CMakeLists.txt at the top of the tree, whose targets
+ * benchmark_<kernel> (e.g. make benchmark_dp_exact) run one kernel each
+ * and write benchmark_<kernel>.json in the build directory.
+ */
+
+static std::atomic<size_t> num_allocations(0), allocated_bytes(0);
+
+static void* counted_malloc(size_t size)
+{
+  num_allocations++;
+  allocated_bytes += size;
+  if (void *ptr = malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size)
+{
+  return counted_malloc(size);
+}
+
+void* operator new[](size_t size)
+{
+  return counted_malloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  try {
+    return counted_malloc(size);
+  }
+  catch (...) {
+    return NULL;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  try {
+    return counted_malloc(size);
+  }
+  catch (...) {
+    return NULL;
+  }
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+  free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+static void* counted_aligned_alloc(size_t size, std::align_val_t align)
+{
+  size_t a = std::max((size_t)align, sizeof(void*));
+  void *ptr = NULL;
+  num_allocations++;
+  allocated_bytes += size;
+  if (posix_memalign(&ptr, a, size ? size : 1) == 0)
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+  return counted_aligned_alloc(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+  return counted_aligned_alloc(size, align);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+  free(ptr);
+}
+#endif
+
+const int MERGE_CALLS = 1000;     /* merge calls per repetition */
+const int MERGE_NUM_Q = 64;       /* different q per problem */
+const int MERGE_Q_SIZE = 10;      /* points one candidate influences */
+const int MC_SAMPLES = 1 << 14;
+
+struct Benchmark_problem{
+  int n, goal;
+  double skew;
+  std::vector<double> probs;      /* descending */
+  /* merge kernels: p in point order with a few zeros, its order, q's */
+  std::vector<double> p, top_ind, q;
+};
+
+struct Benchmark_stats{
+  double min = 0, median = 0, mean = 0;
+};
+
+static void usage()
+{
+  fprintf(stderr, "usage: benchmark [-r repeats] [-w warmup] [-k kernel] "
+          "[-t threads] [-q]\n"
+          "         [-l label] [-o file]\n");
+  exit(2);
+}
+
+static void problem_init(Benchmark_problem &prob, int n, int goal,
+        double skew)
+{
+  std::mt19937_64 gen(((uint64_t)n << 20) ^ ((uint64_t)goal << 4) ^
+          (uint64_t)(skew * 4));
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<int> order(n);
+  int i, j;
+
+  prob.n = n;
+  prob.goal = goal;
+  prob.skew = skew;
+  prob.probs.resize(n);
+  for (i = 0; i < n; i++)
+    prob.probs[i] = pow(uniform(gen), skew);
+
+  /* p(n) is a nonzero sentinel ending the walks over top_ind */
+  prob.p.assign(prob.probs.begin(), prob.probs.end());
+  prob.p.push_back(1);
+  for (i = 0; i < n; i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&prob](int a, int b){
+    return prob.p[a] > prob.p[b];
+  });
+  prob.top_ind.resize(n + 1);
+  for (i = 0; i < n; i++)
+    prob.top_ind[i] = order[i] + 1;
+  prob.top_ind[n] = n + 1;
+  /* the candidate and its neighbors are zeroed, as the callers do */
+  for (i = 0; i <= MERGE_Q_SIZE && i < n - goal; i++)
+    prob.p[gen() % n] = 0;
+  prob.q.resize(MERGE_NUM_Q * MERGE_Q_SIZE);
+  for (j = 0; j < MERGE_NUM_Q; j++){
+    double *q = &prob.q[j * MERGE_Q_SIZE];
+    for (i = 0; i < MERGE_Q_SIZE; i++)
+      q[i] = pow(uniform(gen), skew);
+    std::sort(q, q + MERGE_Q_SIZE, std::greater<double>());
+  }
+  std::sort(prob.probs.begin(), prob.probs.end(), std::greater<double>());
+}
+
+static Benchmark_stats stats_of(std::vector<double> times)
+{
+  Benchmark_stats s;
+  size_t m = times.size();
+  std::sort(times.begin(), times.end());
+  s.min = times[0];
+  s.median = m % 2 ? times[m / 2] : (times[m / 2 - 1] + times[m / 2]) / 2;
+  for (double t : times)
+    s.mean += t;
+  s.mean /= m;
+  return s;
+}
+
+static void print_stats(FILE *out, const char *name,
+        const Benchmark_stats &s)
+{
+  fprintf(out, "\"%s\": {\"min\": %.9g, \"median\": %.9g, \"mean\": %.9g}",
+          name, s.min, s.median, s.mean);
+}
+
+int main(int argc, char **argv)
+{
+  const char *filter = "", *label = "", *output = NULL;
+  int repeats = 5, warmup = 1, num_threads = default_num_threads(), a;
+  bool quick = false, first = true;
+
+  for (a = 1; a < argc; a++){
+    if (strcmp(argv[a], "-r") == 0 && a + 1 < argc)
+      repeats = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-w") == 0 && a + 1 < argc)
+      warmup = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-k") == 0 && a + 1 < argc)
+      filter = argv[++a];
+    else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+      num_threads = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-q") == 0)
+      quick = true;
+    else if (strcmp(argv[a], "-l") == 0 && a + 1 < argc)
+      label = argv[++a];
+    else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc)
+      output = argv[++a];
+    else
+      usage();
+  }
+  if (repeats <= 0 || warmup < 0 || num_threads <= 0)
+    usage();
+  FILE *out = output ? fopen(output, "w") : stdout;
+  if (out == NULL){
+    fprintf(stderr, "cannot open %s\n", output);
+    return 1;
+  }
+
+  std::vector<int> sizes = quick ? std::vector<int>{1000, 10000} :
+          std::vector<int>{1000, 10000, 100000};
+  std::vector<int> goals = quick ? std::vector<int>{10, 100} :
+          std::vector<int>{1, 10, 100, 1000};
+  std::vector<double> skews = {0.25, 1, 4};
+
+  Npb_workspace ws;
+  Benchmark_problem prob;
+  /* name, calls per repetition, one call (returns a value to check) */
+  struct Kernel{
+    const char *name;
+    int calls;
+    std::function<double(int)> run;
+  };
+  std::vector<Kernel> kernels = {
+    {"dp_exact", 1, [&prob](int){
+      return expectation_of_neg_poisson_binom(prob.n, prob.probs.data(),
+              prob.goal, 1, 0, 0);
+    }},
+    {"dp_truncated", 1, [&prob, &ws](int){
+      return approx_exp_of_neg_poisson_binom(ws, prob.n, prob.probs.data(),
+              prob.goal, 1 - 1e-9);
+    }},
+    {"monte_carlo", 1, [&prob, num_threads](int){
+      return npb_monte_carlo(prob.n, prob.probs.data(), prob.goal,
+              MC_SAMPLES, 1, 0, num_threads).expectation;
+    }},
+    {"merge_sort", MERGE_CALLS, [&prob](int call){
+      return merge_sort_sum(prob.p.data(),
+              &prob.q[(call % MERGE_NUM_Q) * MERGE_Q_SIZE], MERGE_Q_SIZE,
+              prob.top_ind.data(), prob.goal);
+    }},
+    {"merge_sum", MERGE_CALLS, [&prob](int call){
+      return merge_sum_cost(prob.p.data(), prob.n,
+              &prob.q[(call % MERGE_NUM_Q) * MERGE_Q_SIZE], MERGE_Q_SIZE,
+              prob.top_ind.data(), prob.goal);
+    }},
+  };
+
+  fprintf(out, "{\"label\": \"%s\", \"timestamp\": %ld, "
+          "\"compiler\": \"%s\", \"threads\": %d, \"repeats\": %d, "
+          "\"warmup\": %d,\n \"results\": [", label, (long)time(NULL),
+          __VERSION__, num_threads, repeats, warmup);
+
+  for (const Kernel &kernel : kernels){
+    if (strstr(kernel.name, filter) == NULL) continue;
+    for (int n : sizes){
+      for (int goal : goals){
+        if (goal >= n - MERGE_Q_SIZE) continue;
+        for (double skew : skews){
+          problem_init(prob, n, goal, skew);
+          std::vector<double> wall(repeats), cpu(repeats);
+          size_t allocations = 0, bytes = 0;
+          double checksum = 0;
+          int r, c;
+
+          for (r = -warmup; r < repeats; r++){
+            size_t allocations0 = num_allocations, bytes0 = allocated_bytes;
+            clock_t cpu0 = clock();
+            auto wall0 = std::chrono::steady_clock::now();
+            double sum = 0;
+            for (c = 0; c < kernel.calls; c++)
+              sum += kernel.run(c);
+            double elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - wall0).count();
+            if (r < 0) continue;
+            wall[r] = elapsed;
+            cpu[r] = (double)(clock() - cpu0) / CLOCKS_PER_SEC;
+            allocations += num_allocations - allocations0;
+            bytes += allocated_bytes - bytes0;
+            checksum = sum;
+          }
+
+          Benchmark_stats wall_stats = stats_of(wall);
+          double rate = wall_stats.median > 0 ?
+                  kernel.calls / wall_stats.median : 0;
+          fprintf(out, "%s\n  {\"kernel\": \"%s\", \"n\": %d, \"goal\": %d, "
+                  "\"skew\": %g, \"calls\": %d,\n   ", first ? "" : ",",
+                  kernel.name, n, goal, skew, kernel.calls);
+          print_stats(out, "wall_seconds", wall_stats);
+          fprintf(out, ",\n   ");
+          print_stats(out, "cpu_seconds", stats_of(cpu));
+          fprintf(out, ",\n   \"allocations\": %.9g, "
+                  "\"allocated_bytes\": %.9g,\n   "
+                  "\"calls_per_second\": %.9g, \"points_per_second\": %.9g, "
+                  "\"checksum\": %.17g}",
+                  (double)allocations / repeats, (double)bytes / repeats,
+                  rate, rate * n, checksum);
+          fflush(out);
+          first = false;
+        }
+      }
+    }
+  }
+  fprintf(out, "\n]}\n");
+  if (output)
+    fclose(out);
+  return 0;
+}
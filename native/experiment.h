@@ -0,0 +1,381 @@
+#ifndef EXPERIMENT_H
+#define EXPERIMENT_H
+
+/*
+ * Native version of the experiment loop of demo.m and
+ * active_learning_dynamic_stopping.m, for running many independent
+ * experiments (datasets x policies x seeds) at once.
+ *
+ * An experiment starts from num_initial targets drawn with its seed and
+ * then repeatedly lets its policy choose one unlabeled point, asks the
+ * label oracle of the dataset (label_oracle.h: the known labels, or a
+ * replayed stream of recorded ones) and adds the label to the k-NN
+ * posterior, until num_queries points are chosen or, with a goal, until
+ * goal targets are found (as active_learning_dynamic_stopping.m;
+ * initial points do not count). A run ends early if the oracle has no
+ * label for the chosen point.
+ *
+ * Policies:
+ *   greedy    the most probable point (one-step, GREEDY in policy_codes.m)
+ *   random    a uniformly random unlabeled point
+ *   ens       ENS with the remaining budget (ens_with_pruning.m); only
+ *             with num_queries, since with a goal the budget would be
+ *             every point left (cost effective ENS, ens_min_cost.m, is
+ *             not here)
+ *   ens:L     ENS with a lookahead of L steps (ENS10, ENS20, ...)
+ *
+ * ENS prunes as ens_with_pruning.m does, with the probability bound of
+ * tight_level 2 (each point's largest weight as the success one more
+ * positive can add, knn_probability_bound_improved.m), so it chooses
+ * the same points as scoring every candidate.
+ *
+ * Ties are broken by the smallest index, as sort(..., 'descend') in the
+ * Matlab code. The unlabeled points stay sorted by probability across
+ * steps (models/knn_order.h), so greedy reads its point off the order
+ * and ENS skips the sort. The random draws come from std::mt19937_64
+ * and so differ from Matlab's rng(seed).
+ *
+ * The datasets are shared read-only by all threads (graphs memory mapped
+ * by knn_graph_file.h); each thread keeps one Experiment_workspace with
+ * the posterior, the ENS context and the buffers of its current
+ * experiment, so after the first experiment of a thread nothing is
+ * allocated that is not already there.
+ *
+ * Results go to a columnar log, one array per field:
+ *
+ *   char[8]   "ASRUNLOG"
+ *   uint32    version, number of datasets, number of policies
+ *   uint32    number of runs
+ *   uint64    number of rows (chosen points, initial ones included)
+ *   names     datasets then policies, each uint32 length + characters
+ *   uint32    dataset of each run
+ *   uint32    policy of each run
+ *   uint64    seed of each run
+ *   uint32    initial points of each run (its first rows)
+ *   uint64    first row of each run, plus the number of rows
+ *   uint32    point of each row (0-based)
+ *   uint8     label of each row (1 for targets)
+ *
+ * util/read_experiment_log.m reads it back into Matlab.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "../models/knn_model.h"
+#include "../score_functions/ens_score.h"
+#include "label_oracle.h"
+#include "parallel_for.h"
+
+const char EXPERIMENT_LOG_MAGIC[8] = {'A', 'S', 'R', 'U', 'N', 'L', 'O', 'G'};
+const uint32_t EXPERIMENT_LOG_VERSION = 1;
+
+enum{
+  EXPERIMENT_GREEDY = 0,
+  EXPERIMENT_RANDOM = 1,
+  EXPERIMENT_ENS = 2
+};
+
+struct Experiment_policy{
+  std::string name;
+  int type = EXPERIMENT_GREEDY;
+  int lookahead = 0;              /* ENS steps, 0: remaining budget */
+};
+
+struct Experiment_dataset{
+  std::string name;
+  const Knn_weights *weights = NULL;
+  Label_oracle oracle;            /* lookup or replay */
+  std::vector<int> targets;       /* points the oracle labels 1 */
+};
+
+struct Experiment_setup{
+  double alpha[2] = {0.1, 0.9};
+  int num_initial = 1;
+  int num_queries = 0;            /* with a goal: all points */
+  int goal = 0;                   /* 0: run the whole budget */
+};
+
+struct Experiment_run{
+  int dataset = 0;
+  int policy = 0;
+  uint64_t seed = 0;
+  int num_initial = 0;
+  std::vector<uint32_t> points;   /* initial points first */
+  std::vector<uint8_t> labels;
+};
+
+struct Experiment_workspace{
+  Knn_posterior posterior;
+  Knn_order order;                /* unlabeled points by probability */
+  Ens_context context;
+  std::vector<double> max_weight; /* largest weight of each row */
+  int max_influence = 0;          /* longest column of the weights */
+  std::vector<double> bounds;     /* of the scores, as top_ind */
+  std::vector<double> scores;
+  std::vector<int> unlabeled;
+  std::vector<int> initial;
+  std::vector<double> initial_labels;
+};
+
+inline bool experiment_parse_policy(const std::string &name,
+        Experiment_policy &policy)
+{
+  policy.name = name;
+  policy.lookahead = 0;
+  if (name == "greedy")
+    policy.type = EXPERIMENT_GREEDY;
+  else if (name == "random")
+    policy.type = EXPERIMENT_RANDOM;
+  else if (name == "ens")
+    policy.type = EXPERIMENT_ENS;
+  else if (name.compare(0, 4, "ens:") == 0 && name.size() > 4){
+    policy.type = EXPERIMENT_ENS;
+    policy.lookahead = atoi(name.c_str() + 4);
+    return policy.lookahead > 0;
+  }
+  else
+    return false;
+  return true;
+}
+
+inline bool experiment_policy_valid(const Experiment_policy &policy,
+        const Experiment_setup &setup)
+{
+  /* ENS needs a budget, its own lookahead or num_queries */
+  return !(policy.type == EXPERIMENT_ENS && policy.lookahead == 0 &&
+          setup.goal > 0);
+}
+
+inline void experiment_ens_bounds(Experiment_workspace &ws, int budget)
+{
+  /*
+   * upper bounds of the ENS scores of ws.context.top_ind, as in
+   * ens_with_pruning.m: a negative label lowers every probability, so
+   * the top budget ones bound the future utility; a positive one raises
+   * each by at most its largest weight in the successes, and changes at
+   * most max_influence of them
+   */
+  const Ens_context &ctx = ws.context;
+  const Knn_posterior &post = *ctx.posterior;
+  int num = (int)ctx.top_ind.size(), i, m;
+  double if_neg = 0, if_pos = 0;
+
+  m = std::min(ws.max_influence, budget);
+  ws.bounds.resize(num);
+  for (i = 0; i < num; i++){
+    int x = ctx.top_ind[i];
+    double a = post.alpha_success + post.successes[x] + ws.max_weight[x];
+    ws.bounds[i] = a / (a + post.alpha_failure + post.failures[x]);
+  }
+  if (m > 0)
+    std::nth_element(ws.bounds.begin(), ws.bounds.begin() + (m - 1),
+            ws.bounds.end(), std::greater<double>());
+  for (i = 0; i < m; i++)
+    if_pos += ws.bounds[i];
+  for (i = 0; i < budget; i++){
+    if_neg += ctx.sorted[i];
+    if (i < budget - m)
+      if_pos += ctx.sorted[i];
+  }
+  for (i = 0; i < num; i++){
+    double p = ctx.sorted[i];
+    ws.bounds[i] = p + p * if_pos + (1 - p) * if_neg;
+  }
+}
+
+inline int experiment_choose(const Experiment_dataset &data,
+        const Experiment_policy &policy, Experiment_workspace &ws,
+        std::mt19937_64 &gen, int remaining_budget)
+{
+  /* next point of the policy, -1 if every point is labeled */
+  const Knn_weights &w = *data.weights;
+  const Knn_posterior &post = ws.posterior;
+  int i, best = -1;
+
+  if (policy.type == EXPERIMENT_RANDOM){
+    ws.unlabeled.clear();
+    for (i = 0; i < w.n; i++){
+      if (!post.observed[i])
+        ws.unlabeled.push_back(i);
+    }
+    if (ws.unlabeled.empty())
+      return -1;
+    return ws.unlabeled[gen() % ws.unlabeled.size()];
+  }
+  if (policy.type == EXPERIMENT_ENS){
+    if (policy.lookahead > 0)
+      remaining_budget = policy.lookahead - 1;
+    if (remaining_budget > 0){
+      ens_context_init_ordered(ws.context, w, post, ws.order);
+      int num = (int)ws.context.top_ind.size();
+      if (num == 0)
+        return -1;
+      remaining_budget = std::min(remaining_budget, num);
+      experiment_ens_bounds(ws, remaining_budget);
+      ws.scores.resize(num);
+      best = ens_scores(ws.context, ws.context.top_ind.data(), num,
+              remaining_budget, ws.bounds.data(), ws.scores.data(), NULL);
+      return ws.context.top_ind[best];
+    }
+  }
+  /* greedy, and ENS without budget left */
+  return knn_order_at(ws.order, 0);
+}
+
+inline void experiment_run(const Experiment_dataset &data,
+        const Experiment_policy &policy, const Experiment_setup &setup,
+        Experiment_workspace &ws, Experiment_run &run)
+{
+  /* run.dataset, run.policy and run.seed are set by the caller */
+  const Knn_weights &w = *data.weights;
+  std::mt19937_64 gen(run.seed);
+  int i, step, found = 0, num_queries = setup.num_queries;
+
+  /* num_initial distinct targets */
+  ws.initial.assign(data.targets.begin(), data.targets.end());
+  run.num_initial = std::min(setup.num_initial, (int)ws.initial.size());
+  for (i = 0; i < run.num_initial; i++)
+    std::swap(ws.initial[i], ws.initial[i + gen() % (ws.initial.size() -
+            i)]);
+  ws.initial.resize(run.num_initial);
+  ws.initial_labels.assign(run.num_initial, 1);
+  knn_posterior_init(ws.posterior, w, setup.alpha, ws.initial.data(),
+          ws.initial_labels.data(), run.num_initial);
+  knn_order_init(ws.order, ws.posterior, w.n);
+  if (policy.type == EXPERIMENT_ENS){
+    /* for the score bounds; they do not depend on the labels */
+    ws.max_weight.assign(w.n, 0);
+    ws.max_influence = 0;
+    for (i = 0; i < w.n; i++){
+      ws.max_influence = std::max(ws.max_influence,
+              (int)(w.col_ptr[i+1] - w.col_ptr[i]));
+      for (size_t e = w.col_ptr[i]; e < w.col_ptr[i+1]; e++)
+        ws.max_weight[w.row_ind[e]] = std::max(ws.max_weight[w.row_ind[e]],
+                w.vals[e]);
+    }
+  }
+  run.points.assign(ws.initial.begin(), ws.initial.end());
+  run.labels.assign(run.num_initial, 1);
+
+  if (setup.goal > 0)
+    num_queries = w.n - run.num_initial;
+  for (step = 0; step < num_queries; step++){
+    int x = experiment_choose(data, policy, ws, gen,
+            num_queries - step - 1);
+    if (x < 0)
+      break;
+    double label;
+    if (!label_oracle_labels(data.oracle, &x, 1, NULL, &label))
+      break;
+    bool positive = label == 1;
+    knn_posterior_add(ws.posterior, w, x, positive);
+    knn_order_refresh(ws.order, ws.posterior, w, x);
+    run.points.push_back((uint32_t)x);
+    run.labels.push_back(positive);
+    found += positive;
+    if (setup.goal > 0 && found == setup.goal)
+      break;
+  }
+}
+
+inline void experiment_run_all(const std::vector<Experiment_dataset> &data,
+        const std::vector<Experiment_policy> &policies,
+        const Experiment_setup &setup, std::vector<Experiment_run> &runs,
+        int num_threads)
+{
+  /*
+   * runs lists the experiments (dataset, policy, seed); they are
+   * started longest first, by dataset size and policy cost, so that
+   * the last ones to finish are short
+   */
+  std::vector<int> order(runs.size());
+  std::vector<Experiment_workspace> ws(std::max(num_threads, 1));
+  auto cost = [&](int r){
+    double n = data[runs[r].dataset].weights->n;
+    return policies[runs[r].policy].type == EXPERIMENT_ENS ? n * n : n;
+  };
+  for (size_t r = 0; r < runs.size(); r++)
+    order[r] = (int)r;
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+    return cost(a) > cost(b);
+  });
+  parallel_for((int)runs.size(), num_threads, [&](int t, int thread){
+    Experiment_run &run = runs[order[t]];
+    experiment_run(data[run.dataset], policies[run.policy], setup,
+            ws[thread], run);
+  });
+}
+
+template <typename T, typename Field>
+bool experiment_log_column(FILE *f, const std::vector<Experiment_run> &runs,
+        Field field)
+{
+  /* one field of every run */
+  std::vector<T> values;
+  for (const Experiment_run &run : runs)
+    values.push_back((T)field(run));
+  return fwrite(values.data(), sizeof(T), values.size(), f) ==
+          values.size();
+}
+
+inline bool experiment_log_write(const char *path,
+        const std::vector<Experiment_dataset> &data,
+        const std::vector<Experiment_policy> &policies,
+        const std::vector<Experiment_run> &runs)
+{
+  FILE *f = fopen(path, "wb");
+  uint32_t header[4] = {EXPERIMENT_LOG_VERSION, (uint32_t)data.size(),
+          (uint32_t)policies.size(), (uint32_t)runs.size()};
+  uint64_t num_rows = 0;
+  std::vector<std::string> names;
+  bool ok;
+
+  if (f == NULL)
+    return false;
+  for (const Experiment_run &run : runs)
+    num_rows += run.points.size();
+  ok = fwrite(EXPERIMENT_LOG_MAGIC, 1, 8, f) == 8 &&
+          fwrite(header, sizeof(header), 1, f) == 1 &&
+          fwrite(&num_rows, sizeof(num_rows), 1, f) == 1;
+  for (const Experiment_dataset &d : data)
+    names.push_back(d.name);
+  for (const Experiment_policy &p : policies)
+    names.push_back(p.name);
+  for (const std::string &name : names){
+    uint32_t length = (uint32_t)name.size();
+    ok = ok && fwrite(&length, sizeof(length), 1, f) == 1 &&
+            fwrite(name.data(), 1, length, f) == length;
+  }
+
+  if (!runs.empty()){
+    ok = ok && experiment_log_column<uint32_t>(f, runs,
+            [](const Experiment_run &r){ return r.dataset; });
+    ok = ok && experiment_log_column<uint32_t>(f, runs,
+            [](const Experiment_run &r){ return r.policy; });
+    ok = ok && experiment_log_column<uint64_t>(f, runs,
+            [](const Experiment_run &r){ return r.seed; });
+    ok = ok && experiment_log_column<uint32_t>(f, runs,
+            [](const Experiment_run &r){ return r.num_initial; });
+  }
+  uint64_t offset = 0;
+  for (const Experiment_run &run : runs){
+    ok = ok && fwrite(&offset, sizeof(offset), 1, f) == 1;
+    offset += run.points.size();
+  }
+  ok = ok && fwrite(&offset, sizeof(offset), 1, f) == 1;
+  for (const Experiment_run &run : runs)
+    ok = ok && fwrite(run.points.data(), sizeof(uint32_t),
+            run.points.size(), f) == run.points.size();
+  for (const Experiment_run &run : runs)
+    ok = ok && fwrite(run.labels.data(), 1, run.labels.size(), f) ==
+            run.labels.size();
+  return fclose(f) == 0 && ok;
+}
+
+#endif
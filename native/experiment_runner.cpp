@@ -0,0 +1,229 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "experiment.h"
+#include "knn_graph_file.h"
+
+/*
+ * experiment_runner [-p policies] [-s num_seeds] [-S first_seed]
+ *     [-i num_initial] (-n num_queries | -g goal) [-a alpha_s,alpha_f]
+ *     [-t threads] [-r] -o log graph_file:label_file ...
+ *
+ * Runs every policy on every dataset with seeds first_seed ..
+ * first_seed + num_seeds - 1 (see experiment.h), all experiments in
+ * parallel, writes the columnar log and prints the mean number of
+ * targets found (-n) or the mean number of queries (-g) per dataset and
+ * policy, as demo.m does.
+ *
+ *   -p  comma separated, from greedy, random, ens and ens:L (default
+ *       greedy,ens; greedy with -g, where ens needs a lookahead)
+ *   -s  experiments per dataset and policy (default 10)
+ *   -i  initial targets (default 1)
+ *   -n  budgeted setting: number of queries
+ *   -g  cost effective setting: stop when goal targets are found
+ *   -a  prior pseudo counts (default 0.1,0.9)
+ *   -t  threads (default all cores)
+ *   -r  the label files are replay streams of recorded observations
+ *       (see label_oracle.h); unrecorded points count as non-targets
+ *
+ * A dataset is a k-NN graph file (knn_graph_file.h) and a text file with
+ * the label of each point on its own line (1 for targets), as the labels
+ * of load_data.m.
+ *
+ * Build with
+ *
+ *   g++ -O3 -march=native -pthread -o experiment_runner \
+ *       native/experiment_runner.cpp
+ */
+
+static void usage()
+{
+  fprintf(stderr, "usage: experiment_runner [-p policies] [-s num_seeds] "
+          "[-S first_seed]\n"
+          "         [-i num_initial] (-n num_queries | -g goal) "
+          "[-a alpha_s,alpha_f]\n"
+          "         [-t threads] [-r] -o log graph_file:label_file ...\n");
+  exit(2);
+}
+
+static bool read_labels(const char *path, std::vector<double> &labels)
+{
+  FILE *f = fopen(path, "r");
+  double label;
+  if (f == NULL)
+    return false;
+  labels.clear();
+  while (fscanf(f, "%lf", &label) == 1)
+    labels.push_back(label == 1 ? 1 : 2);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *output = NULL;
+  std::string policy_list;
+  std::vector<std::string> inputs;
+  Experiment_setup setup;
+  int num_seeds = 10, num_threads = default_num_threads(), a;
+  bool replay = false;
+  long first_seed = 1;
+  size_t d, p;
+
+  for (a = 1; a < argc; a++){
+    if (strcmp(argv[a], "-p") == 0 && a + 1 < argc)
+      policy_list = argv[++a];
+    else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+      num_seeds = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-S") == 0 && a + 1 < argc)
+      first_seed = atol(argv[++a]);
+    else if (strcmp(argv[a], "-i") == 0 && a + 1 < argc)
+      setup.num_initial = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+      setup.num_queries = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-g") == 0 && a + 1 < argc)
+      setup.goal = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-a") == 0 && a + 1 < argc){
+      if (sscanf(argv[++a], "%lf,%lf", &setup.alpha[0],
+              &setup.alpha[1]) != 2)
+        usage();
+    }
+    else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+      num_threads = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-r") == 0)
+      replay = true;
+    else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc)
+      output = argv[++a];
+    else if (argv[a][0] != '-')
+      inputs.push_back(argv[a]);
+    else
+      usage();
+  }
+  if (output == NULL || inputs.empty() || num_seeds <= 0 ||
+          num_threads <= 0 || setup.num_initial < 0 ||
+          (setup.num_queries > 0) == (setup.goal > 0))
+    usage();
+
+  std::vector<Experiment_policy> policies;
+  size_t start = 0;
+  if (policy_list.empty())
+    policy_list = setup.goal > 0 ? "greedy" : "greedy,ens";
+  while (start <= policy_list.size()){
+    size_t end = policy_list.find(',', start);
+    if (end == std::string::npos)
+      end = policy_list.size();
+    Experiment_policy policy;
+    if (!experiment_parse_policy(policy_list.substr(start, end - start),
+            policy)){
+      fprintf(stderr, "unknown policy %s\n",
+              policy_list.substr(start, end - start).c_str());
+      return 1;
+    }
+    if (!experiment_policy_valid(policy, setup)){
+      fprintf(stderr, "%s needs a budget: use ens:L with -g\n",
+              policy.name.c_str());
+      return 1;
+    }
+    policies.push_back(policy);
+    start = end + 1;
+  }
+
+  /* graphs are mapped once and shared by all experiments */
+  std::vector<std::unique_ptr<Knn_graph_map> > maps;
+  std::vector<Experiment_dataset> data(inputs.size());
+  for (d = 0; d < inputs.size(); d++){
+    size_t colon = inputs[d].rfind(':');
+    std::string error;
+    if (colon == std::string::npos)
+      usage();
+    std::string graph = inputs[d].substr(0, colon);
+    std::string labels = inputs[d].substr(colon + 1);
+    maps.push_back(std::unique_ptr<Knn_graph_map>(new Knn_graph_map));
+    if (!knn_graph_map_open(*maps.back(), graph.c_str(), &error)){
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    data[d].name = inputs[d];
+    data[d].weights = &maps.back()->weights;
+    Label_oracle &oracle = data[d].oracle;
+    int n = data[d].weights->n;
+    if (replay){
+      if (!label_oracle_read_replay(oracle, labels.c_str(), &error)){
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+      }
+      oracle.missing_label = 2;
+      if ((int)oracle.labels.size() > n){
+        fprintf(stderr, "%s: point %d of %d\n", labels.c_str(),
+                (int)oracle.labels.size(), n);
+        return 1;
+      }
+      oracle.labels.resize(n, 0);
+    }
+    else {
+      if (!read_labels(labels.c_str(), oracle.labels)){
+        fprintf(stderr, "cannot open %s\n", labels.c_str());
+        return 1;
+      }
+      if ((int)oracle.labels.size() != n){
+        fprintf(stderr, "%s: %d labels for %d points\n", labels.c_str(),
+                (int)oracle.labels.size(), n);
+        return 1;
+      }
+    }
+    for (int i = 0; i < n; i++){
+      if (oracle.labels[i] == 1)
+        data[d].targets.push_back(i);
+    }
+  }
+
+  std::vector<Experiment_run> runs;
+  for (d = 0; d < data.size(); d++){
+    for (p = 0; p < policies.size(); p++){
+      for (a = 0; a < num_seeds; a++){
+        Experiment_run run;
+        run.dataset = (int)d;
+        run.policy = (int)p;
+        run.seed = (uint64_t)(first_seed + a);
+        runs.push_back(run);
+      }
+    }
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  experiment_run_all(data, policies, setup, runs, num_threads);
+  double elapsed = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start_time).count();
+  if (!experiment_log_write(output, data, policies, runs)){
+    fprintf(stderr, "cannot write %s\n", output);
+    return 1;
+  }
+
+  /* runs are grouped by dataset, then policy */
+  printf("%d experiments in %.2fs (%d threads)\n", (int)runs.size(),
+          elapsed, num_threads);
+  for (d = 0; d < data.size(); d++){
+    for (p = 0; p < policies.size(); p++){
+      double total = 0;
+      for (a = 0; a < num_seeds; a++){
+        const Experiment_run &run = runs[(d * policies.size() + p) *
+                num_seeds + a];
+        size_t r, chosen = run.points.size() - run.num_initial;
+        if (setup.goal > 0)
+          total += chosen;
+        else {
+          for (r = run.num_initial; r < run.points.size(); r++)
+            total += run.labels[r];
+        }
+      }
+      printf("%s %s: mean %s %.2f\n", data[d].name.c_str(),
+              policies[p].name.c_str(), setup.goal > 0 ? "cost" : "targets",
+              total / num_seeds);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+#ifndef KNN_GRAPH_BUILD_H
+#define KNN_GRAPH_BUILD_H
+
+/*
+ * Exact k-nearest-neighbor search of every point among all others, the
+ * job of knnsearch(x, x, 'k', k + 1) in load_data.m, for
+ *
+ *   - dense points under Euclidean distance, and
+ *   - binary fingerprints (e.g. ECFP4) under Tanimoto similarity,
+ *     |a & b| / |a | b|, computed with popcounts.
+ *
+ * Queries are split into blocks that threads claim dynamically (see
+ * parallel_for.h). Each block goes through the points one tile at a
+ * time, so the tile stays in cache while every query of the block is
+ * compared with it; for dense points a tile is a small matrix product
+ * (|x|^2 + |y|^2 - 2 x'y), and each query keeps its k best candidates
+ * in a heap. The product form cancels badly when the distances are
+ * small next to the norms, so it only screens candidates: the points
+ * are centered first (a copy, n d more doubles), and every candidate
+ * whose screened distance is within the rounding bound
+ * KNN_SCREEN_SLACK (|x|^2 + |y|^2) of the current k-th best gets its
+ * distance computed directly, which is what the heap holds. Neighbors,
+ * distances and their order are therefore those of a brute force search
+ * with knn_squared_distance.
+ *
+ * The point itself is never its own neighbor, and ties (e.g. duplicate
+ * points at distance 0) go to the smaller index. This is what the
+ * loops in load_data.m that fix the order of duplicates for citeseer and
+ * bmg do by hand.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "parallel_for.h"
+
+const int KNN_QUERY_BLOCK = 32;    /* queries per work item */
+const int KNN_POINT_TILE = 256;    /* points compared per pass */
+/* bound on the rounding of the product form relative to |x|^2 + |y|^2,
+   times the dimension */
+const double KNN_SCREEN_SLACK = 8 * DBL_EPSILON;
+
+/* (key, index) pairs; smaller keys and then smaller indices win */
+typedef std::pair<double, uint32_t> Knn_candidate;
+
+struct Knn_top{
+  int k = 0;
+  std::vector<Knn_candidate> heap;  /* max-heap of the k best so far */
+};
+
+inline void knn_top_init(Knn_top &top, int k)
+{
+  top.k = k;
+  top.heap.clear();
+  top.heap.reserve(k);
+}
+
+inline double knn_top_worst(const Knn_top &top)
+{
+  /* key a candidate must beat (or tie) to enter */
+  return (int)top.heap.size() < top.k ? INFINITY : top.heap.front().first;
+}
+
+inline void knn_top_push(Knn_top &top, double key, uint32_t index)
+{
+  Knn_candidate c(key, index);
+  if ((int)top.heap.size() < top.k){
+    top.heap.push_back(c);
+    std::push_heap(top.heap.begin(), top.heap.end());
+  }
+  else if (top.k > 0 && c < top.heap.front()){
+    std::pop_heap(top.heap.begin(), top.heap.end());
+    top.heap.back() = c;
+    std::push_heap(top.heap.begin(), top.heap.end());
+  }
+}
+
+inline double knn_squared_distance(const double *x, const double *y, int d)
+{
+  double sum = 0, diff;
+  int i;
+  for (i = 0; i < d; i++){
+    diff = x[i] - y[i];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+inline void knn_build_dense(const double *points, uint32_t n, int d, int k,
+        int num_threads, uint32_t *neighbors, double *distances)
+{
+  /*
+   * points is row-major (n x d); row i of neighbors (n x k) gets the k
+   * nearest other points of i in ascending order of distance, and
+   * distances their Euclidean distances (k < n)
+   */
+  std::vector<double> mean(d, 0), centered((size_t)n * d), norms(n);
+  double slack = KNN_SCREEN_SLACK * (d + 2);
+  uint32_t i;
+  int j, num_blocks = (int)((n + KNN_QUERY_BLOCK - 1) / KNN_QUERY_BLOCK);
+
+  for (i = 0; i < n; i++){
+    for (j = 0; j < d; j++)
+      mean[j] += points[(size_t)i * d + j];
+  }
+  for (j = 0; j < d; j++)
+    mean[j] /= n;
+  for (i = 0; i < n; i++){
+    double *x = centered.data() + (size_t)i * d;
+    norms[i] = 0;
+    for (j = 0; j < d; j++){
+      x[j] = points[(size_t)i * d + j] - mean[j];
+      norms[i] += x[j] * x[j];
+    }
+  }
+
+  parallel_for(num_blocks, num_threads, [&](int b, int){
+    uint32_t q0 = (uint32_t)b * KNN_QUERY_BLOCK;
+    uint32_t q1 = std::min(n, q0 + KNN_QUERY_BLOCK), q, c0, c1, c;
+    std::vector<Knn_top> tops(q1 - q0);
+    std::vector<double> tile((size_t)KNN_QUERY_BLOCK * KNN_POINT_TILE);
+    int j;
+
+    for (q = q0; q < q1; q++)
+      knn_top_init(tops[q - q0], k);
+    for (c0 = 0; c0 < n; c0 += KNN_POINT_TILE){
+      c1 = std::min(n, c0 + KNN_POINT_TILE);
+      /* dot products of the query block with the tile */
+      for (q = q0; q < q1; q++){
+        const double *x = centered.data() + (size_t)q * d;
+        double *row = tile.data() + (size_t)(q - q0) * KNN_POINT_TILE;
+        for (c = c0; c < c1; c++){
+          const double *y = centered.data() + (size_t)c * d;
+          double dot = 0;
+          for (j = 0; j < d; j++)
+            dot += x[j] * y[j];
+          row[c - c0] = dot;
+        }
+      }
+      for (q = q0; q < q1; q++){
+        Knn_top &top = tops[q - q0];
+        const double *row = tile.data() + (size_t)(q - q0) * KNN_POINT_TILE;
+        for (c = c0; c < c1; c++){
+          if (c == q) continue;
+          double sum = norms[q] + norms[c], worst = knn_top_worst(top);
+          if (sum - 2 * row[c - c0] - slack * sum > worst) continue;
+          /* close to the k-th best: decide on the direct distance */
+          double dist = knn_squared_distance(points + (size_t)q * d,
+                  points + (size_t)c * d, d);
+          if (dist <= worst)
+            knn_top_push(top, dist, c);
+        }
+      }
+    }
+
+    for (q = q0; q < q1; q++){
+      std::vector<Knn_candidate> &best = tops[q - q0].heap;
+      std::sort(best.begin(), best.end());
+      for (j = 0; j < k; j++){
+        neighbors[(size_t)q * k + j] = best[j].second;
+        distances[(size_t)q * k + j] = sqrt(best[j].first);
+      }
+    }
+  });
+}
+
+inline int knn_popcount(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  int count = 0;
+  for (; x; x &= x - 1)
+    count++;
+  return count;
+#endif
+}
+
+inline void knn_build_tanimoto(const uint64_t *fingerprints, uint32_t n,
+        int words, int k, int num_threads, uint32_t *neighbors,
+        double *similarities)
+{
+  /*
+   * fingerprints is row-major (n x words) bit vectors; row i of
+   * neighbors (n x k) gets the k other points most similar to i in
+   * descending order of Tanimoto similarity, and similarities the values
+   * (k < n; two empty fingerprints have similarity 0)
+   */
+  std::vector<int> counts(n);
+  uint32_t i;
+  int j, num_blocks = (int)((n + KNN_QUERY_BLOCK - 1) / KNN_QUERY_BLOCK);
+
+  for (i = 0; i < n; i++){
+    counts[i] = 0;
+    for (j = 0; j < words; j++)
+      counts[i] += knn_popcount(fingerprints[(size_t)i * words + j]);
+  }
+
+  parallel_for(num_blocks, num_threads, [&](int b, int){
+    uint32_t q0 = (uint32_t)b * KNN_QUERY_BLOCK;
+    uint32_t q1 = std::min(n, q0 + KNN_QUERY_BLOCK), q, c0, c1, c;
+    std::vector<Knn_top> tops(q1 - q0);
+    int w;
+
+    for (q = q0; q < q1; q++)
+      knn_top_init(tops[q - q0], k);
+    for (c0 = 0; c0 < n; c0 += KNN_POINT_TILE){
+      c1 = std::min(n, c0 + KNN_POINT_TILE);
+      for (q = q0; q < q1; q++){
+        Knn_top &top = tops[q - q0];
+        const uint64_t *x = fingerprints + (size_t)q * words;
+        for (c = c0; c < c1; c++){
+          if (c == q) continue;
+          int lo = std::min(counts[q], counts[c]);
+          int hi = std::max(counts[q], counts[c]);
+          /* the similarity is at most lo / hi */
+          if (hi > 0 && -(double)lo / hi > knn_top_worst(top))
+            continue;
+          const uint64_t *y = fingerprints + (size_t)c * words;
+          int common = 0;
+          for (w = 0; w < words; w++)
+            common += knn_popcount(x[w] & y[w]);
+          int total = counts[q] + counts[c] - common;
+          double sim = total > 0 ? (double)common / total : 0;
+          knn_top_push(top, -sim, c);
+        }
+      }
+    }
+
+    for (q = q0; q < q1; q++){
+      std::vector<Knn_candidate> &best = tops[q - q0].heap;
+      std::sort(best.begin(), best.end());
+      for (j = 0; j < k; j++){
+        neighbors[(size_t)q * k + j] = best[j].second;
+        similarities[(size_t)q * k + j] = -best[j].first;
+      }
+    }
+  });
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "knn_graph_build.h"
+#include "knn_graph_file.h"
+
+/*
+ * knn_graph_builder [-k K] [-t threads] [-w tanimoto|inverse|one]
+ *     (-f fingerprints [-b bits] | -x points) graph_file
+ *
+ * Builds the exact k-NN graph of a dataset (see knn_graph_build.h) and
+ * writes it in the format read by load_data.m (knn_graph_file.h).
+ *
+ *   -f  text file with one fingerprint per line, given as the indices
+ *       (0-based) of its on bits; Tanimoto similarity
+ *   -b  fingerprint length in bits; larger indices are folded onto it
+ *       (default: largest index + 1, i.e. no folding)
+ *   -x  text file with one point per line (numbers separated by white
+ *       space or commas); Euclidean distance
+ *   -k  number of neighbors (default 100)
+ *   -t  number of threads (default all cores)
+ *   -w  similarity stored in the graph: tanimoto (default for -f),
+ *       inverse distance (default for -x, as the toy problems) or one
+ *       (as citeseer and bmg); duplicate points are at distance 0 and
+ *       get the inverse of the smallest positive distance in the data
+ *
+ * Build with
+ *
+ *   g++ -O3 -march=native -pthread -o knn_graph_builder \
+ *       native/knn_graph_builder.cpp
+ */
+
+static void usage()
+{
+  fprintf(stderr, "usage: knn_graph_builder [-k K] [-t threads] "
+          "[-w tanimoto|inverse|one]\n"
+          "         (-f fingerprints [-b bits] | -x points) graph_file\n");
+  exit(2);
+}
+
+static bool read_rows(const char *path,
+        std::vector<std::vector<double> > &rows)
+{
+  /* numbers of each non-empty line */
+  FILE *f = fopen(path, "r");
+  std::string line;
+  int ch;
+  if (f == NULL)
+    return false;
+  do {
+    ch = fgetc(f);
+    if (ch != '\n' && ch != EOF){
+      line += (char)(ch == ',' ? ' ' : ch);
+      continue;
+    }
+    std::vector<double> row;
+    const char *s = line.c_str();
+    char *end;
+    for (;;){
+      double value = strtod(s, &end);
+      if (end == s) break;
+      row.push_back(value);
+      s = end;
+    }
+    if (!row.empty())
+      rows.push_back(row);
+    line.clear();
+  } while (ch != EOF);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *fingerprint_file = NULL, *point_file = NULL, *output = NULL;
+  const char *weighting = NULL;
+  int k = 100, num_threads = default_num_threads(), a;
+  size_t e;
+  long bits = 0;
+  uint32_t n, i;
+
+  for (a = 1; a < argc; a++){
+    if (strcmp(argv[a], "-k") == 0 && a + 1 < argc)
+      k = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+      num_threads = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-w") == 0 && a + 1 < argc)
+      weighting = argv[++a];
+    else if (strcmp(argv[a], "-f") == 0 && a + 1 < argc)
+      fingerprint_file = argv[++a];
+    else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc)
+      bits = atol(argv[++a]);
+    else if (strcmp(argv[a], "-x") == 0 && a + 1 < argc)
+      point_file = argv[++a];
+    else if (output == NULL && argv[a][0] != '-')
+      output = argv[a];
+    else
+      usage();
+  }
+  if (output == NULL || k <= 0 || (fingerprint_file == NULL) ==
+          (point_file == NULL))
+    usage();
+  if (weighting == NULL)
+    weighting = fingerprint_file ? "tanimoto" : "inverse";
+  if (strcmp(weighting, "tanimoto") != 0 &&
+          strcmp(weighting, "inverse") != 0 && strcmp(weighting, "one") != 0)
+    usage();
+
+  const char *input = fingerprint_file ? fingerprint_file : point_file;
+  std::vector<std::vector<double> > rows;
+  if (!read_rows(input, rows)){
+    fprintf(stderr, "cannot open %s\n", input);
+    return 1;
+  }
+  n = (uint32_t)rows.size();
+  if ((long)k >= (long)n){
+    fprintf(stderr, "need more than k = %d points, got %u\n", k, n);
+    return 1;
+  }
+
+  std::vector<uint32_t> neighbors((size_t)n * k);
+  std::vector<double> values((size_t)n * k);
+  if (fingerprint_file){
+    if (bits <= 0){
+      for (i = 0; i < n; i++){
+        for (e = 0; e < rows[i].size(); e++)
+          bits = std::max(bits, (long)rows[i][e] + 1);
+      }
+    }
+    int words = (int)((bits + 63) / 64);
+    std::vector<uint64_t> fingerprints((size_t)n * words, 0);
+    for (i = 0; i < n; i++){
+      uint64_t *fingerprint = fingerprints.data() + (size_t)i * words;
+      for (e = 0; e < rows[i].size(); e++){
+        if (rows[i][e] < 0){
+          fprintf(stderr, "%s: negative bit index\n", input);
+          return 1;
+        }
+        long bit = (long)rows[i][e] % bits;
+        fingerprint[bit / 64] |= (uint64_t)1 << (bit % 64);
+      }
+    }
+    knn_build_tanimoto(fingerprints.data(), n, words, k, num_threads,
+            neighbors.data(), values.data());
+    if (strcmp(weighting, "tanimoto") != 0){
+      /* turn similarities into distances for the other weightings */
+      for (e = 0; e < values.size(); e++)
+        values[e] = 1 - values[e];
+    }
+  }
+  else {
+    int d = (int)rows[0].size();
+    std::vector<double> points((size_t)n * d);
+    for (i = 0; i < n; i++){
+      if ((int)rows[i].size() != d){
+        fprintf(stderr, "%s: line %u has %d numbers, expected %d\n", input,
+                i + 1, (int)rows[i].size(), d);
+        return 1;
+      }
+      std::copy(rows[i].begin(), rows[i].end(),
+              points.begin() + (size_t)i * d);
+    }
+    knn_build_dense(points.data(), n, d, k, num_threads, neighbors.data(),
+            values.data());
+  }
+  std::vector<std::vector<double> >().swap(rows);
+
+  /* similarities from distances */
+  if (strcmp(weighting, "one") == 0){
+    std::fill(values.begin(), values.end(), 1.0);
+  }
+  else if (strcmp(weighting, "inverse") == 0){
+    double smallest = INFINITY;
+    for (e = 0; e < values.size(); e++){
+      if (values[e] > 0)
+        smallest = std::min(smallest, values[e]);
+    }
+    for (e = 0; e < values.size(); e++)
+      values[e] = 1 / (values[e] > 0 ? values[e] : smallest);
+  }
+
+  std::vector<uint64_t> ptr(n + 1);
+  for (i = 0; i <= n; i++)
+    ptr[i] = (uint64_t)i * k;
+  Knn_graph_view g;
+  g.num_points = n;
+  g.k = k;
+  g.neighbor_ptr = ptr.data();
+  g.neighbor_ind = neighbors.data();
+  g.neighbor_val = values.data();
+  knn_graph_hash_file(input, &g.dataset_hash);
+
+  std::string error;
+  if (!knn_graph_write(output, g, &error)){
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("%u points, %d neighbors each, written to %s\n", n, k, output);
+  return 0;
+}
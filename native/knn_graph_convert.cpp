@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "knn_graph_file.h"
+
+/*
+ * knn_graph_convert [-k K] [-s] [-z] edge_list graph_file
+ *
+ * Converts a text edge list (e.g. the citeseer citation graph) into the
+ * k-NN graph format of knn_graph_file.h. Each line is "i j [w]" (commas
+ * or white space; lines starting with % or # are skipped), meaning j is
+ * a neighbor of i with similarity w (default 1). Indices are 1-based as
+ * in Matlab unless -z is given.
+ *
+ *   -k K  keep the K most similar neighbors of each point (default all)
+ *   -s    the graph is undirected: also add i as a neighbor of j
+ *
+ * Self loops are dropped and repeated edges keep the largest similarity.
+ * The hash of edge_list is stored in the header. Build with
+ *
+ *   g++ -O2 -o knn_graph_convert native/knn_graph_convert.cpp
+ */
+
+struct Edge{
+  uint32_t from, to;
+  double weight;
+};
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: knn_graph_convert [-k K] [-s] [-z] edge_list graph_file\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t k = 0, n = 0, i, e;
+  bool symmetric = false, zero_based = false;
+  const char *input = NULL, *output = NULL;
+  int a;
+
+  for (a = 1; a < argc; a++){
+    if (strcmp(argv[a], "-k") == 0 && a + 1 < argc)
+      k = strtoull(argv[++a], NULL, 10);
+    else if (strcmp(argv[a], "-s") == 0)
+      symmetric = true;
+    else if (strcmp(argv[a], "-z") == 0)
+      zero_based = true;
+    else if (input == NULL)
+      input = argv[a];
+    else if (output == NULL)
+      output = argv[a];
+    else
+      usage();
+  }
+  if (input == NULL || output == NULL)
+    usage();
+
+  /* read the edges */
+  FILE *f = fopen(input, "r");
+  if (f == NULL){
+    fprintf(stderr, "cannot open %s\n", input);
+    return 1;
+  }
+  std::vector<Edge> edges;
+  char line[1024];
+  uint64_t line_number = 0;
+  while (fgets(line, sizeof(line), f)){
+    double from, to, weight = 1;
+    line_number++;
+    for (char *c = line; *c; c++){
+      if (*c == ',') *c = ' ';
+    }
+    if (line[0] == '%' || line[0] == '#')
+      continue;
+    int got = sscanf(line, "%lf %lf %lf", &from, &to, &weight);
+    if (got <= 0)
+      continue;  /* empty line */
+    if (!zero_based){
+      from--;
+      to--;
+    }
+    if (got < 2 || from < 0 || to < 0 || from >= 4294967295.0 ||
+            to >= 4294967295.0){
+      fprintf(stderr, "%s:%llu: bad edge\n", input,
+              (unsigned long long)line_number);
+      fclose(f);
+      return 1;
+    }
+    n = std::max(n, (uint64_t)std::max(from, to) + 1);
+    if (from == to)
+      continue;
+    Edge edge = {(uint32_t)from, (uint32_t)to, weight};
+    edges.push_back(edge);
+    if (symmetric){
+      std::swap(edge.from, edge.to);
+      edges.push_back(edge);
+    }
+  }
+  fclose(f);
+
+  /*
+   * neighbor lists in descending order of similarity (ties by index);
+   * after sorting by (from, to, -weight), the first copy of a repeated
+   * edge has the largest similarity
+   */
+  std::sort(edges.begin(), edges.end(), [](const Edge &x, const Edge &y){
+    if (x.from != y.from) return x.from < y.from;
+    if (x.to != y.to) return x.to < y.to;
+    return x.weight > y.weight;
+  });
+  edges.erase(std::unique(edges.begin(), edges.end(),
+          [](const Edge &x, const Edge &y){
+    return x.from == y.from && x.to == y.to;
+  }), edges.end());
+  std::stable_sort(edges.begin(), edges.end(),
+          [](const Edge &x, const Edge &y){
+    if (x.from != y.from) return x.from < y.from;
+    return x.weight > y.weight;
+  });
+
+  std::vector<uint64_t> ptr(n + 1, 0);
+  std::vector<uint32_t> ind;
+  std::vector<double> val;
+  for (e = 0; e < edges.size(); e++){
+    i = edges[e].from;
+    if (k > 0 && ptr[i+1] >= k)
+      continue;
+    ptr[i+1]++;
+    ind.push_back(edges[e].to);
+    val.push_back(edges[e].weight);
+  }
+  for (i = 0; i < n; i++)
+    ptr[i+1] += ptr[i];
+
+  Knn_graph_view g;
+  g.num_points = n;
+  g.k = 0;  /* largest list */
+  g.neighbor_ptr = ptr.data();
+  g.neighbor_ind = ind.data();
+  g.neighbor_val = val.data();
+  knn_graph_hash_file(input, &g.dataset_hash);
+
+  std::string error;
+  if (!knn_graph_write(output, g, &error)){
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("%llu points, %llu edges written to %s\n", (unsigned long long)n,
+          (unsigned long long)ind.size(), output);
+  return 0;
+}
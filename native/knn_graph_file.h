@@ -0,0 +1,413 @@
+#ifndef KNN_GRAPH_FILE_H
+#define KNN_GRAPH_FILE_H
+
+/*
+ * Binary file format for k-NN graphs, replacing the per-dataset
+ * nearest_neighbors .mat caches and the sparse() call of load_data.m.
+ *
+ * A file holds the same graph twice, each part in compressed sparse
+ * layout and 64-byte aligned, so both can be used straight from a
+ * memory map:
+ *
+ *   - the neighbor lists: row i lists the nearest neighbors of point i
+ *     in order with their similarities (the columns of
+ *     nearest_neighbors and similarities in load_data.m), with 32-bit
+ *     indices;
+ *   - the influence lists: list j holds the points whose posterior
+ *     changes when j is labeled, i.e. the columns of the weights matrix
+ *     (duplicates summed, rows ascending), stored exactly as
+ *     Knn_weights expects them (models/knn_model.h).
+ *
+ * All indices are 0-based and all numbers little-endian. The header
+ * records the largest number of neighbors k and a hash of the file the
+ * graph was built from (0 if unknown), to tell which data it belongs to.
+ * Readers reject files of another version, and files whose arrays are
+ * misaligned, do not fit in the file or do not form valid lists (offsets
+ * from 0 to the number of entries, never decreasing, at most k neighbors
+ * per point and indices below the number of points), so a corrupt file
+ * never leads to reads or writes out of bounds.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../models/knn_model.h"
+
+#if defined(_WIN32)
+#define KNN_GRAPH_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char KNN_GRAPH_MAGIC[8] = {'K', 'N', 'N', 'G', 'R', 'A', 'P', 'H'};
+const uint32_t KNN_GRAPH_VERSION = 1;
+const uint64_t KNN_GRAPH_ALIGNMENT = 64;
+
+struct Knn_graph_header{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t num_points;
+  uint64_t k;                     /* largest number of neighbors */
+  uint64_t num_neighbors;         /* entries of the neighbor lists */
+  uint64_t num_influence;         /* entries of the influence lists */
+  uint64_t dataset_hash;
+  /* byte offsets of the arrays from the start of the file */
+  uint64_t neighbor_ptr_offset;   /* uint64 [num_points+1] */
+  uint64_t neighbor_ind_offset;   /* uint32 [num_neighbors] */
+  uint64_t neighbor_val_offset;   /* double [num_neighbors] */
+  uint64_t influence_ptr_offset;  /* uint64 [num_points+1] */
+  uint64_t influence_ind_offset;  /* uint64 [num_influence] */
+  uint64_t influence_val_offset;  /* double [num_influence] */
+  uint64_t file_size;
+  uint64_t reserved[2];
+};
+
+/* view of a graph in memory, or of a mapped file */
+struct Knn_graph_view{
+  uint64_t num_points = 0;
+  uint64_t k = 0;
+  uint64_t dataset_hash = 0;
+  const uint64_t *neighbor_ptr = NULL;
+  const uint32_t *neighbor_ind = NULL;
+  const double *neighbor_val = NULL;
+  const uint64_t *influence_ptr = NULL;
+  const uint64_t *influence_ind = NULL;
+  const double *influence_val = NULL;
+};
+
+const uint64_t KNN_GRAPH_HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t knn_graph_hash(const void *data, size_t size, uint64_t hash)
+{
+  /* 64-bit FNV-1a, start with hash = KNN_GRAPH_HASH_SEED */
+  const unsigned char *bytes = (const unsigned char*)data;
+  size_t i;
+  for (i = 0; i < size; i++){
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline bool knn_graph_hash_file(const char *path, uint64_t *hash)
+{
+  std::vector<char> buf(1 << 20);
+  size_t got;
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  *hash = KNN_GRAPH_HASH_SEED;
+  while ((got = fread(buf.data(), 1, buf.size(), f)) > 0)
+    *hash = knn_graph_hash(buf.data(), got, *hash);
+  fclose(f);
+  return true;
+}
+
+inline void knn_graph_influence_lists(uint64_t n, const uint64_t *ptr,
+        const uint32_t *ind, const double *val,
+        std::vector<uint64_t> &out_ptr, std::vector<uint64_t> &out_ind,
+        std::vector<double> &out_val)
+{
+  /*
+   * transpose the neighbor lists into the influence lists, summing
+   * repeated neighbors as sparse() does
+   */
+  std::vector<uint64_t> next;
+  std::vector<int64_t> last(n, -1);  /* last row seen in each list */
+  uint64_t i, e, j, pos;
+
+  out_ptr.assign(n + 1, 0);
+  for (i = 0; i < n; i++){
+    for (e = ptr[i]; e < ptr[i+1]; e++){
+      j = ind[e];
+      if (last[j] != (int64_t)i){
+        last[j] = (int64_t)i;
+        out_ptr[j+1]++;
+      }
+    }
+  }
+  for (j = 0; j < n; j++)
+    out_ptr[j+1] += out_ptr[j];
+  out_ind.resize(out_ptr[n]);
+  out_val.resize(out_ptr[n]);
+  next.assign(out_ptr.begin(), out_ptr.end() - 1);
+  last.assign(n, -1);
+  /* rows are visited in ascending order, so each list is sorted */
+  for (i = 0; i < n; i++){
+    for (e = ptr[i]; e < ptr[i+1]; e++){
+      j = ind[e];
+      if (last[j] == (int64_t)i){
+        out_val[next[j]-1] += val[e];
+        continue;
+      }
+      last[j] = (int64_t)i;
+      pos = next[j]++;
+      out_ind[pos] = i;
+      out_val[pos] = val[e];
+    }
+  }
+}
+
+inline bool knn_graph_write(const char *path, const Knn_graph_view &g,
+        std::string *error)
+{
+  /*
+   * write g to path; influence lists may be NULL, then they are computed
+   * from the neighbor lists
+   */
+  std::vector<uint64_t> ptr_t, ind_t;
+  std::vector<double> val_t;
+  Knn_graph_header h;
+  uint64_t n = g.num_points, i, offset, num_influence;
+  const uint64_t *influence_ptr = g.influence_ptr;
+  const uint64_t *influence_ind = g.influence_ind;
+  const double *influence_val = g.influence_val;
+  static const char zeros[KNN_GRAPH_ALIGNMENT] = {0};
+
+  if (influence_ptr == NULL){
+    knn_graph_influence_lists(n, g.neighbor_ptr, g.neighbor_ind,
+            g.neighbor_val, ptr_t, ind_t, val_t);
+    influence_ptr = ptr_t.data();
+    influence_ind = ind_t.data();
+    influence_val = val_t.data();
+  }
+  num_influence = influence_ptr[n];
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, KNN_GRAPH_MAGIC, sizeof(h.magic));
+  h.version = KNN_GRAPH_VERSION;
+  h.header_size = sizeof(h);
+  h.num_points = n;
+  h.num_neighbors = g.neighbor_ptr[n];
+  h.num_influence = num_influence;
+  h.dataset_hash = g.dataset_hash;
+  h.k = g.k;
+  if (h.k == 0){
+    for (i = 0; i < n; i++)
+      h.k = std::max(h.k, g.neighbor_ptr[i+1] - g.neighbor_ptr[i]);
+  }
+
+  /* lay out the arrays, each aligned */
+  const void *arrays[6] = {g.neighbor_ptr, g.neighbor_ind, g.neighbor_val,
+          influence_ptr, influence_ind, influence_val};
+  uint64_t sizes[6] = {(n+1) * 8, h.num_neighbors * 4, h.num_neighbors * 8,
+          (n+1) * 8, num_influence * 8, num_influence * 8};
+  uint64_t *offsets[6] = {&h.neighbor_ptr_offset, &h.neighbor_ind_offset,
+          &h.neighbor_val_offset, &h.influence_ptr_offset,
+          &h.influence_ind_offset, &h.influence_val_offset};
+  offset = sizeof(h);
+  for (i = 0; i < 6; i++){
+    offset = (offset + KNN_GRAPH_ALIGNMENT - 1) / KNN_GRAPH_ALIGNMENT *
+            KNN_GRAPH_ALIGNMENT;
+    *offsets[i] = offset;
+    offset += sizes[i];
+  }
+  h.file_size = offset;
+
+  /* write to a temporary file and rename, so readers never see half */
+  std::string tmp = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == NULL){
+    if (error) *error = "cannot open " + tmp + " for writing";
+    return false;
+  }
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  offset = sizeof(h);
+  for (i = 0; ok && i < 6; i++){
+    ok = fwrite(zeros, 1, *offsets[i] - offset, f) == *offsets[i] - offset;
+    if (ok && sizes[i] > 0)
+      ok = fwrite(arrays[i], 1, sizes[i], f) == sizes[i];
+    offset = *offsets[i] + sizes[i];
+  }
+  ok = (fclose(f) == 0) && ok;
+  if (ok)
+    ok = rename(tmp.c_str(), path) == 0;
+  if (!ok){
+    remove(tmp.c_str());
+    if (error) *error = std::string("cannot write ") + path;
+  }
+  return ok;
+}
+
+/* a graph file mapped into memory (or read, where mmap is missing) */
+struct Knn_graph_map{
+  Knn_graph_view view;
+  Knn_weights weights;  /* influence lists, zero-copy */
+  void *data = NULL;
+  size_t size = 0;
+#ifdef KNN_GRAPH_NO_MMAP
+  std::vector<uint64_t> buffer;
+#endif
+
+  Knn_graph_map() {}
+  Knn_graph_map(const Knn_graph_map&) = delete;
+  Knn_graph_map& operator=(const Knn_graph_map&) = delete;
+  ~Knn_graph_map();
+};
+
+inline void knn_graph_unmap(Knn_graph_map &map)
+{
+#ifndef KNN_GRAPH_NO_MMAP
+  if (map.data)
+    munmap(map.data, map.size);
+#else
+  std::vector<uint64_t>().swap(map.buffer);
+#endif
+  map.data = NULL;
+  map.size = 0;
+  map.view = Knn_graph_view();
+  map.weights = Knn_weights();
+}
+
+inline Knn_graph_map::~Knn_graph_map()
+{
+  knn_graph_unmap(*this);
+}
+
+inline bool knn_graph_check_lists(const char *base, uint64_t ptr_offset,
+        uint64_t ind_offset, int ind_bytes, uint64_t num, uint64_t n,
+        uint64_t max_length)
+{
+  /*
+   * offsets 0 .. num, nondecreasing, lists of at most max_length entries
+   * and every index below n
+   */
+  const uint64_t *ptr = (const uint64_t*)(base + ptr_offset);
+  uint64_t i, e;
+  if (ptr[0] != 0 || ptr[n] != num)
+    return false;
+  for (i = 0; i < n; i++){
+    if (ptr[i+1] < ptr[i] || ptr[i+1] - ptr[i] > max_length)
+      return false;
+  }
+  if (ind_bytes == 4){
+    const uint32_t *ind = (const uint32_t*)(base + ind_offset);
+    for (e = 0; e < num; e++){
+      if (ind[e] >= n)
+        return false;
+    }
+  }
+  else {
+    const uint64_t *ind = (const uint64_t*)(base + ind_offset);
+    for (e = 0; e < num; e++){
+      if (ind[e] >= n)
+        return false;
+    }
+  }
+  return true;
+}
+
+inline bool knn_graph_map_open(Knn_graph_map &map, const char *path,
+        std::string *error)
+{
+  Knn_graph_header h;
+  const char *base;
+  uint64_t n;
+
+  knn_graph_unmap(map);
+#ifndef KNN_GRAPH_NO_MMAP
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0){
+    if (error) *error = std::string("cannot open ") + path;
+    return false;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(h)){
+    close(fd);
+    if (error) *error = std::string(path) + " is not a k-NN graph file";
+    return false;
+  }
+  map.size = (size_t)st.st_size;
+  map.data = mmap(NULL, map.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map.data == MAP_FAILED){
+    map.data = NULL;
+    map.size = 0;
+    if (error) *error = std::string("cannot map ") + path;
+    return false;
+  }
+#else
+  FILE *f = fopen(path, "rb");
+  if (f == NULL){
+    if (error) *error = std::string("cannot open ") + path;
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  map.size = (size_t)ftell(f);
+  fseek(f, 0, SEEK_SET);
+  map.buffer.resize(map.size / 8 + 1);
+  map.data = map.buffer.data();
+  if (fread(map.data, 1, map.size, f) != map.size)
+    map.size = 0;
+  fclose(f);
+#endif
+
+  base = (const char*)map.data;
+  if (map.size >= sizeof(h))
+    memcpy(&h, base, sizeof(h));
+  if (map.size < sizeof(h) || memcmp(h.magic, KNN_GRAPH_MAGIC, 8) != 0 ||
+          h.version != KNN_GRAPH_VERSION || h.file_size > map.size ||
+          h.num_points > INT32_MAX){
+    knn_graph_unmap(map);
+    if (error) *error = std::string(path) + " is not a k-NN graph file " +
+            "of version " + std::to_string(KNN_GRAPH_VERSION);
+    return false;
+  }
+
+  /*
+   * every array must be aligned and lie inside the file (sizes compared
+   * by division, so that huge counts cannot overflow), and the lists
+   * must be valid
+   */
+  n = h.num_points;
+  const uint64_t offsets[6] = {h.neighbor_ptr_offset, h.neighbor_ind_offset,
+          h.neighbor_val_offset, h.influence_ptr_offset,
+          h.influence_ind_offset, h.influence_val_offset};
+  const uint64_t counts[6] = {n + 1, h.num_neighbors, h.num_neighbors,
+          n + 1, h.num_influence, h.num_influence};
+  const uint64_t widths[6] = {8, 4, 8, 8, 8, 8};
+  for (int i = 0; i < 6; i++){
+    if (offsets[i] % KNN_GRAPH_ALIGNMENT != 0 ||
+            offsets[i] > h.file_size ||
+            counts[i] > (h.file_size - offsets[i]) / widths[i]){
+      knn_graph_unmap(map);
+      if (error) *error = std::string(path) + " is truncated or corrupt";
+      return false;
+    }
+  }
+  if (!knn_graph_check_lists(base, h.neighbor_ptr_offset,
+          h.neighbor_ind_offset, 4, h.num_neighbors, n, h.k) ||
+          !knn_graph_check_lists(base, h.influence_ptr_offset,
+          h.influence_ind_offset, 8, h.num_influence, n, n)){
+    knn_graph_unmap(map);
+    if (error) *error = std::string(path) + " has invalid neighbor lists";
+    return false;
+  }
+
+  map.view.num_points = n;
+  map.view.k = h.k;
+  map.view.dataset_hash = h.dataset_hash;
+  map.view.neighbor_ptr = (const uint64_t*)(base + h.neighbor_ptr_offset);
+  map.view.neighbor_ind = (const uint32_t*)(base + h.neighbor_ind_offset);
+  map.view.neighbor_val = (const double*)(base + h.neighbor_val_offset);
+  map.view.influence_ptr = (const uint64_t*)(base + h.influence_ptr_offset);
+  map.view.influence_ind = (const uint64_t*)(base + h.influence_ind_offset);
+  map.view.influence_val = (const double*)(base + h.influence_val_offset);
+
+  static_assert(sizeof(size_t) == sizeof(uint64_t),
+          "the influence lists are used as size_t arrays");
+  map.weights.n = (int)n;
+  map.weights.col_ptr = (const size_t*)map.view.influence_ptr;
+  map.weights.row_ind = (const size_t*)map.view.influence_ind;
+  map.weights.vals = map.view.influence_val;
+  return true;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef LABEL_ORACLE_H
+#define LABEL_ORACLE_H
+
+/*
+ * Native label oracles, answering a whole batch of queries per call.
+ *
+ * Labels follow the Matlab code: 1 for targets and 2 otherwise (soft
+ * labels are the probability of a target). The kinds are
+ *
+ *   LABEL_ORACLE_LOOKUP   the known label of each point (lookup_oracle)
+ *   LABEL_ORACLE_REPLAY   the label recorded for each point in a stream
+ *                         read from disk, e.g. screening results
+ *   LABEL_ORACLE_FIXED    always the same label (fixed_oracle.m)
+ *   LABEL_ORACLE_ARGMAX   the more likely label (argmax_prob_oracle.m;
+ *                         ties go to the target, as max does)
+ *   LABEL_ORACLE_SOFT     the probability itself (soft_prob_oracle.m)
+ *   LABEL_ORACLE_SAMPLE   a target with its probability
+ *                         (probabilistic_oracle)
+ *
+ * The last three need the probabilities of the queried points. Every
+ * oracle is deterministic: a sampled label is drawn from a hash of the
+ * seed and the point, so it does not depend on the batch it is asked in
+ * or on the order of the queries.
+ *
+ * A replay stream is a text file with one observation per line,
+ * "point label" (1-based point as in Matlab, label 1 for targets;
+ * commas or white space, lines starting with % or # skipped). A point
+ * recorded twice keeps its last label; points never recorded get
+ * missing_label, or make label_oracle_labels fail if it is 0.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum{
+  LABEL_ORACLE_LOOKUP = 0,
+  LABEL_ORACLE_REPLAY = 1,
+  LABEL_ORACLE_FIXED = 2,
+  LABEL_ORACLE_ARGMAX = 3,
+  LABEL_ORACLE_SOFT = 4,
+  LABEL_ORACLE_SAMPLE = 5
+};
+
+struct Label_oracle{
+  int kind = LABEL_ORACLE_LOOKUP;
+  std::vector<double> labels;   /* lookup and replay: label of each point */
+  double fixed_label = 1;
+  double missing_label = 0;     /* replay: label of unrecorded points */
+  uint64_t seed = 0;            /* sample */
+  size_t num_recorded = 0;      /* replay: observations in the stream */
+};
+
+inline bool label_oracle_read_replay(Label_oracle &oracle, const char *path,
+        std::string *error)
+{
+  /* replay stream of a library of any size; labels grow as needed */
+  FILE *f = fopen(path, "r");
+  char line[256];
+  long line_number = 0;
+
+  if (f == NULL){
+    if (error) *error = std::string("cannot open ") + path;
+    return false;
+  }
+  oracle.kind = LABEL_ORACLE_REPLAY;
+  oracle.labels.clear();
+  oracle.num_recorded = 0;
+  while (fgets(line, sizeof(line), f)){
+    double point, label;
+    char *s;
+    line_number++;
+    for (s = line; *s; s++){
+      if (*s == ',') *s = ' ';
+    }
+    for (s = line; *s == ' ' || *s == '\t'; s++)
+      ;
+    if (*s == '%' || *s == '#' || *s == '\n' || *s == '\r' || *s == 0)
+      continue;
+    if (sscanf(s, "%lf %lf", &point, &label) != 2 || point < 1 ||
+            point != floor(point)){
+      fclose(f);
+      if (error) *error = std::string(path) + ":" +
+              std::to_string(line_number) + ": expected \"point label\"";
+      return false;
+    }
+    if ((size_t)point > oracle.labels.size())
+      oracle.labels.resize((size_t)point, 0);
+    oracle.labels[(size_t)point - 1] = label == 1 ? 1 : 2;
+    oracle.num_recorded++;
+  }
+  fclose(f);
+  return true;
+}
+
+inline double label_oracle_uniform(uint64_t seed, uint64_t point)
+{
+  /* uniform in [0, 1) from (seed, point), splitmix64 */
+  uint64_t x = seed * 0x9E3779B97F4A7C15ULL + point + 1;
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline bool label_oracle_labels(const Label_oracle &oracle,
+        const int *query_ind, int num_queries, const double *probs,
+        double *labels)
+{
+  /*
+   * labels of query_ind (0-based); probs are their probabilities of
+   * being targets (only read by argmax, soft and sample). Returns false
+   * for a point without a label (lookup or replay), leaving the labels
+   * of that point and of the later ones unset.
+   */
+  int i;
+  for (i = 0; i < num_queries; i++){
+    int x = query_ind[i];
+    switch (oracle.kind){
+    case LABEL_ORACLE_LOOKUP:
+    case LABEL_ORACLE_REPLAY:
+      if (x < 0 || (size_t)x >= oracle.labels.size() ||
+              oracle.labels[x] == 0){
+        if (oracle.kind == LABEL_ORACLE_LOOKUP || oracle.missing_label == 0)
+          return false;
+        labels[i] = oracle.missing_label;
+      }
+      else
+        labels[i] = oracle.labels[x];
+      break;
+    case LABEL_ORACLE_FIXED:
+      labels[i] = oracle.fixed_label;
+      break;
+    case LABEL_ORACLE_ARGMAX:
+      labels[i] = probs[i] >= 1 - probs[i] ? 1 : 2;
+      break;
+    case LABEL_ORACLE_SOFT:
+      labels[i] = probs[i];
+      break;
+    case LABEL_ORACLE_SAMPLE:
+      labels[i] = label_oracle_uniform(oracle.seed, (uint64_t)x) < probs[i] ?
+              1 : 2;
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
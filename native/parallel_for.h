@@ -0,0 +1,42 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+/*
+ * Minimal thread helpers shared by the native code: work items are
+ * claimed dynamically from an atomic counter, so uneven items balance
+ * out without a scheduler.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+template <typename Function>
+void parallel_for(int num, int num_threads, Function f)
+{
+  /* call f(i, thread) for i = 0..num-1, claiming i dynamically */
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+  int t;
+  auto worker = [&](int thread){
+    int i;
+    while ((i = next++) < num)
+      f(i, thread);
+  };
+  if (num_threads <= 1){
+    worker(0);
+    return;
+  }
+  for (t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(worker, t));
+  for (t = 0; t < num_threads; t++)
+    threads[t].join();
+}
+
+inline int default_num_threads()
+{
+  int n = (int)std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+#endif
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "spectral_embedding.h"
+
+/*
+ * spectral_embedding [-d dims] [-z] [-t threads] [-m basis_size]
+ *     [-i max_restarts] [-e tolerance] [-l labels [-c class]]
+ *     edge_list point_file
+ *
+ * Native version of data/citeseer/prepare_venue_subgraph.m (see
+ * spectral_embedding.h) for citation and interaction graphs of any size:
+ * reads the edge list twice, once for the connected components and once
+ * for the adjacency of the largest one, and writes point_file with one
+ * line per point of that component (in order of index) holding its
+ * coordinates, the eigenvectors divided by their eigenvalues (x = u / s
+ * in the script). That is the input of knn_graph_builder -x.
+ *
+ * point_file.nodes gets the index in edge_list of each line (as
+ * find(to_keep)), and with -l, point_file.labels its label in the format
+ * of experiment_runner: 1 if the node has the given class, else 0.
+ *
+ *   -d  dimensions (default 20, as num_principal_components)
+ *   -z  indices in edge_list and labels are 0-based (default 1-based)
+ *   -t  threads (default all cores)
+ *   -m  Lanczos basis size (default max(4 dims, dims + 60)); larger
+ *       bases need fewer restarts and (dims + m + 1) n doubles
+ *   -i  maximum restarts (default 10000)
+ *   -e  residual tolerance relative to 2 max degree (default 1e-10)
+ *   -l  text file with "node class" per line, as data/citeseer/labels
+ *   -c  target class (default 3, as load_data.m for citeseer)
+ *
+ * Each line of edge_list is "i j" (commas or white space, more columns
+ * ignored, lines starting with % or # skipped); the graph is undirected,
+ * self loops do not change the Laplacian and repeated edges count once.
+ * For citeseer, from data/citeseer:
+ *
+ *   spectral_embedding -l labels edge_list citeseer.txt
+ *   knn_graph_builder -k 50 -w one -x citeseer.txt citeseer_k50.knng
+ *   experiment_runner -n 100 -o runs.bin \
+ *       citeseer_k50.knng:citeseer.txt.labels
+ *
+ * Build with
+ *
+ *   g++ -O3 -march=native -pthread -o spectral_embedding \
+ *       native/spectral_embedding.cpp
+ */
+
+static void usage()
+{
+  fprintf(stderr, "usage: spectral_embedding [-d dims] [-z] [-t threads] "
+          "[-m basis_size]\n"
+          "         [-i max_restarts] [-e tolerance] [-l labels [-c class]]\n"
+          "         edge_list point_file\n");
+  exit(2);
+}
+
+static bool read_targets(const char *path, bool zero_based,
+        double target_class, std::vector<char> &target)
+{
+  /* target[i] = 1 for the nodes of the class, as connected_labels == 3 */
+  FILE *f = fopen(path, "r");
+  char line[1024];
+  if (f == NULL){
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f)){
+    double node, label;
+    for (char *c = line; *c; c++){
+      if (*c == ',') *c = ' ';
+    }
+    if (sscanf(line, "%lf %lf", &node, &label) != 2)
+      continue;  /* empty line or comment */
+    if (!zero_based)
+      node--;
+    if (node >= 0 && node < (double)target.size())
+      target[(size_t)node] = label == target_class;
+  }
+  fclose(f);
+  return true;
+}
+
+static bool read_edges(const char *path, bool zero_based,
+        Spectral_components *components, std::vector<uint32_t> *degree,
+        const std::vector<uint32_t> *map, Spectral_graph *graph)
+{
+  /*
+   * one pass over the edge list: components joins i and j and degree
+   * counts the edge at both ends (if given); graph gets the edge at both
+   * ends if map (the position of each point in graph, or -1) keeps them,
+   * graph->ptr[i+1] being the next free slot of row i
+   */
+  FILE *f = fopen(path, "r");
+  char line[1024];
+  unsigned long long line_number = 0;
+  if (f == NULL){
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f)){
+    double from, to;
+    char *c;
+    line_number++;
+    for (c = line; *c; c++){
+      if (*c == ',') *c = ' ';
+    }
+    for (c = line; *c == ' ' || *c == '\t'; c++)
+      ;
+    if (*c == '%' || *c == '#')
+      continue;
+    int got = sscanf(c, "%lf %lf", &from, &to);
+    if (got <= 0)
+      continue;  /* empty line */
+    if (!zero_based){
+      from--;
+      to--;
+    }
+    if (got < 2 || from < 0 || to < 0 || from >= 4294967295.0 ||
+            to >= 4294967295.0 || from != floor(from) || to != floor(to)){
+      fprintf(stderr, "%s:%llu: expected two indices\n", path, line_number);
+      fclose(f);
+      return false;
+    }
+    uint32_t i = (uint32_t)from, j = (uint32_t)to;
+    if (components){
+      spectral_components_grow(*components, std::max(i, j) + 1);
+      spectral_union(*components, i, j);
+    }
+    if (i == j)
+      continue;
+    if (degree){
+      if (std::max(i, j) >= degree->size())
+        degree->resize(std::max(i, j) + 1, 0);
+      (*degree)[i]++;
+      (*degree)[j]++;
+    }
+    if (graph && (*map)[i] != (uint32_t)-1){
+      uint32_t a = (*map)[i], b = (*map)[j];
+      graph->ind[graph->ptr[a+1]++] = b;
+      graph->ind[graph->ptr[b+1]++] = a;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *input = NULL, *output = NULL, *label_file = NULL;
+  Spectral_options options;
+  double target_class = 3;
+  bool zero_based = false;
+  int a, j;
+  uint32_t i;
+
+  options.num_threads = default_num_threads();
+  for (a = 1; a < argc; a++){
+    if (strcmp(argv[a], "-d") == 0 && a + 1 < argc)
+      options.num = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-z") == 0)
+      zero_based = true;
+    else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+      options.num_threads = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-m") == 0 && a + 1 < argc)
+      options.basis_size = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-i") == 0 && a + 1 < argc)
+      options.max_restarts = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-e") == 0 && a + 1 < argc)
+      options.tolerance = atof(argv[++a]);
+    else if (strcmp(argv[a], "-l") == 0 && a + 1 < argc)
+      label_file = argv[++a];
+    else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc)
+      target_class = atof(argv[++a]);
+    else if (argv[a][0] == '-')
+      usage();
+    else if (input == NULL)
+      input = argv[a];
+    else if (output == NULL)
+      output = argv[a];
+    else
+      usage();
+  }
+  if (input == NULL || output == NULL || options.num <= 0 ||
+          options.num_threads <= 0 || options.max_restarts < 0 ||
+          !(options.tolerance > 0))
+    usage();
+
+  /* first pass: components and degrees (repeated edges included) */
+  Spectral_components components;
+  std::vector<uint32_t> degree;
+  uint32_t num_components;
+  if (!read_edges(input, zero_based, &components, &degree, NULL, NULL))
+    return 1;
+  uint32_t num_nodes = (uint32_t)components.parent.size();
+  uint32_t largest = spectral_largest(components, &num_components);
+  degree.resize(num_nodes, 0);
+
+  std::vector<uint32_t> map(num_nodes, (uint32_t)-1), nodes;
+  Spectral_graph graph;
+  for (i = 0; i < num_nodes; i++){
+    if (spectral_find(components, i) == largest){
+      map[i] = (uint32_t)nodes.size();
+      nodes.push_back(i);
+    }
+  }
+  graph.n = (uint32_t)nodes.size();
+  graph.ptr.assign(graph.n + 1, 0);
+  for (i = 0; i < graph.n; i++)
+    graph.ptr[i+1] = graph.ptr[i] + degree[nodes[i]];
+  graph.ind.resize(graph.ptr[graph.n]);
+  std::vector<uint32_t>().swap(degree);
+
+  /*
+   * second pass: adjacency of the largest component; row i is filled
+   * through ptr[i+1], which starts at the beginning of the row and ends
+   * at its end
+   */
+  for (i = graph.n; i > 0; i--)
+    graph.ptr[i] = graph.ptr[i-1];
+  if (!read_edges(input, zero_based, NULL, NULL, &map, &graph))
+    return 1;
+  /* each neighbor once */
+  uint64_t kept = 0;
+  for (i = 0; i < graph.n; i++){
+    uint32_t *row = graph.ind.data() + graph.ptr[i];
+    uint32_t *end = graph.ind.data() + graph.ptr[i+1];
+    std::sort(row, end);
+    end = std::unique(row, end);
+    graph.ptr[i] = kept;
+    kept = std::copy(row, end, graph.ind.data() + kept) - graph.ind.data();
+  }
+  graph.ptr[graph.n] = kept;
+  graph.ind.resize(kept);
+  printf("%u nodes in %u components, the largest has %u nodes and "
+          "%llu edges\n", num_nodes, num_components, graph.n,
+          (unsigned long long)(kept / 2));
+
+  Spectral_result result;
+  spectral_smallest(graph, options, result);
+  int dims = (int)result.values.size();
+  printf("%d eigenvalues after %d restarts (residual %.3g%s):", dims,
+          result.restarts, result.residual,
+          result.converged ? "" : ", not converged");
+  for (j = 0; j < dims; j++)
+    printf(" %.6g", result.values[j]);
+  printf("\n");
+
+  /* x = u / s */
+  FILE *f = fopen(output, "w");
+  if (f == NULL){
+    fprintf(stderr, "cannot write %s\n", output);
+    return 1;
+  }
+  for (i = 0; i < graph.n; i++){
+    for (j = 0; j < dims; j++)
+      fprintf(f, j > 0 ? " %.10g" : "%.10g",
+              result.vectors[(size_t)j * graph.n + i] / result.values[j]);
+    fprintf(f, "\n");
+  }
+  bool ok = fclose(f) == 0;
+
+  std::string path = std::string(output) + ".nodes";
+  f = fopen(path.c_str(), "w");
+  if (f == NULL)
+    ok = false;
+  else {
+    for (i = 0; i < graph.n; i++)
+      fprintf(f, "%u\n", nodes[i] + (zero_based ? 0 : 1));
+    ok = fclose(f) == 0 && ok;
+  }
+
+  if (label_file){
+    std::vector<char> target(num_nodes, 0);
+    if (!read_targets(label_file, zero_based, target_class, target))
+      return 1;
+    path = std::string(output) + ".labels";
+    f = fopen(path.c_str(), "w");
+    if (f == NULL)
+      ok = false;
+    else {
+      for (i = 0; i < graph.n; i++)
+        fprintf(f, "%d\n", target[nodes[i]]);
+      ok = fclose(f) == 0 && ok;
+    }
+  }
+  if (!ok){
+    fprintf(stderr, "cannot write the output of %s\n", output);
+    return 1;
+  }
+  return result.converged ? 0 : 3;
+}
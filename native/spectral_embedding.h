@@ -0,0 +1,644 @@
+#ifndef SPECTRAL_EMBEDDING_H
+#define SPECTRAL_EMBEDDING_H
+
+/*
+ * Native version of the spectral embedding of
+ * data/citeseer/prepare_venue_subgraph.m: the largest connected
+ * component of a graph, and the eigenvectors of its Laplacian L = D - A
+ * with the smallest nonzero eigenvalues, as svds(L, num, 'smallestnz').
+ *
+ * Components come from union-find over the edges as they are read (path
+ * halving, union by size), so the edge list is never held in memory;
+ * only the adjacency of the largest component is, in compressed rows
+ * with each neighbor once, as (A + A') > 0.
+ *
+ * The eigenvectors come from thick-restart Lanczos (Wu and Simon). The
+ * first cycle runs on 1 - 2 L / shift, whose largest eigenvalues are the
+ * smallest of L since shift = 2 max degree bounds the spectrum of L.
+ * Later cycles run on a Chebyshev polynomial of L of degree
+ * SPECTRAL_FILTER_DEGREE that is small on [cut, shift] and grows fast
+ * below cut, cut being the largest kept Ritz value of the first cycle
+ * (an upper bound on the eigenvalues wanted): the wanted eigenvalues of
+ * clustered spectra such as citation graphs then come apart, which
+ * takes far fewer cycles, and orthogonalization, the bulk of the work
+ * of each step, is paid once per degree products with L.
+ *
+ * Every new basis vector is orthogonalized (classical Gram-Schmidt, a
+ * second time when the first pass removed most of it) against the
+ * previous ones and the constant vector, the null space of L on a
+ * connected graph, so the zero eigenvalue is never found. After each
+ * cycle of basis_size vectors the best Ritz vectors are kept and the
+ * search goes on from the residual; the eigenvalues are the Rayleigh
+ * quotients y'L y of the Ritz vectors, converged when every residual
+ * |L y - y'L y y| is below tolerance * shift. Eigenvalues of the small
+ * projected matrix come from cyclic Jacobi rotations.
+ *
+ * A Krylov space grown from one start vector holds a single direction of
+ * each eigenspace, so the other copies of a repeated eigenvalue (every
+ * eigenvalue of a cycle, those of symmetric subgraphs) are never found,
+ * however converged the residuals. Hence the converged vectors are
+ * locked, and Lanczos runs again on their complement from a new random
+ * start: the num smallest of the locked and the new Ritz vectors are
+ * locked in turn, until a round finds nothing below the largest locked
+ * eigenvalue. That is at least twice the work of a single run.
+ *
+ * Products with L, dot products and updates go over blocks of
+ * SPECTRAL_CHUNK rows claimed by the threads (parallel_for.h); partial
+ * sums are added in block order, so the result does not depend on the
+ * number of threads. The locked vectors and the basis take
+ * (num + basis_size + 1) n doubles.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "parallel_for.h"
+
+const uint32_t SPECTRAL_CHUNK = 4096;  /* rows per work item */
+const int SPECTRAL_FILTER_DEGREE = 10;  /* Chebyshev filter after the first
+                                           cycle */
+
+struct Spectral_components{
+  std::vector<uint32_t> parent;  /* union-find forest */
+  std::vector<uint32_t> size;    /* points under each root */
+};
+
+struct Spectral_graph{
+  uint32_t n = 0;
+  std::vector<uint64_t> ptr;     /* n + 1 row offsets */
+  std::vector<uint32_t> ind;     /* neighbors of each point, ascending */
+};
+
+struct Spectral_options{
+  int num = 20;                  /* eigenvectors, as k of svds */
+  int basis_size = 0;            /* 0: max(4 num, num + 60) */
+  int max_restarts = 10000;
+  double tolerance = 1e-10;      /* residual relative to the shift */
+  int num_threads = 1;
+};
+
+struct Spectral_filter{
+  int degree = 1;
+  double center = 0;             /* of the damped interval [cut, upper] */
+  double half_width = 1;
+  double largest = 1;            /* p(0), bounds |p| on the spectrum */
+};
+
+struct Spectral_result{
+  std::vector<double> values;    /* eigenvalues, ascending */
+  std::vector<double> vectors;   /* unit eigenvectors, n values each */
+  double residual = 0;            /* largest |L y - lambda y| */
+  int restarts = 0;
+  bool converged = false;
+};
+
+inline void spectral_components_grow(Spectral_components &c, uint32_t n)
+{
+  /* make points 0 .. n-1 exist, new ones on their own */
+  uint32_t i = (uint32_t)c.parent.size();
+  if (n <= i)
+    return;
+  c.parent.resize(n);
+  c.size.resize(n, 1);
+  for (; i < n; i++)
+    c.parent[i] = i;
+}
+
+inline uint32_t spectral_find(Spectral_components &c, uint32_t x)
+{
+  while (c.parent[x] != x){
+    c.parent[x] = c.parent[c.parent[x]];
+    x = c.parent[x];
+  }
+  return x;
+}
+
+inline void spectral_union(Spectral_components &c, uint32_t a, uint32_t b)
+{
+  a = spectral_find(c, a);
+  b = spectral_find(c, b);
+  if (a == b)
+    return;
+  if (c.size[a] < c.size[b])
+    std::swap(a, b);
+  c.parent[b] = a;
+  c.size[a] += c.size[b];
+}
+
+inline uint32_t spectral_largest(Spectral_components &c, uint32_t *num)
+{
+  /*
+   * root of the largest component, ties to the one with the smallest
+   * point; num (optional) gets the number of components
+   */
+  uint32_t i, best = 0, best_size = 0, count = 0;
+  for (i = 0; i < (uint32_t)c.parent.size(); i++){
+    uint32_t root = spectral_find(c, i);
+    if (root == i)
+      count++;
+    if (c.size[root] > best_size){
+      best = root;
+      best_size = c.size[root];
+    }
+  }
+  if (num)
+    *num = count;
+  return best;
+}
+
+inline int spectral_num_chunks(uint32_t n)
+{
+  return (int)((n + (uint64_t)SPECTRAL_CHUNK - 1) / SPECTRAL_CHUNK);
+}
+
+inline uint32_t spectral_chunk_end(uint32_t n, uint32_t start)
+{
+  return (uint32_t)std::min<uint64_t>(n, (uint64_t)start + SPECTRAL_CHUNK);
+}
+
+inline double spectral_uniform(uint64_t seed, uint64_t i)
+{
+  /* uniform in [0, 1) from (seed, i), splitmix64 */
+  uint64_t x = seed * 0x9E3779B97F4A7C15ULL + i + 1;
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline void spectral_apply(const Spectral_graph &g, double alpha,
+        double beta, double gamma, const double *x, const double *prev,
+        double *y, int num_threads)
+{
+  /* y = alpha L x + beta x + gamma prev (prev unread if gamma is 0) */
+  parallel_for(spectral_num_chunks(g.n), num_threads, [&](int c, int){
+    uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+    uint32_t end = spectral_chunk_end(g.n, start);
+    for (i = start; i < end; i++){
+      double sum = (double)(g.ptr[i+1] - g.ptr[i]) * x[i];
+      for (uint64_t k = g.ptr[i]; k < g.ptr[i+1]; k++)
+        sum -= x[g.ind[k]];
+      sum = alpha * sum + beta * x[i];
+      y[i] = gamma != 0 ? sum + gamma * prev[i] : sum;
+    }
+  });
+}
+
+inline void spectral_filter_init(Spectral_filter &filter, int degree,
+        double cut, double upper)
+{
+  /* map [cut, upper] to [-1, 1]; p(0) is the largest value */
+  double y0 = (upper + cut) / (upper - cut);
+  filter.degree = degree;
+  filter.center = (upper + cut) / 2;
+  filter.half_width = (upper - cut) / 2;
+  filter.largest = cosh(degree * acosh(y0));
+}
+
+inline void spectral_filter_apply(const Spectral_graph &g,
+        const Spectral_filter &filter, const double *x, double *y,
+        double *t0, double *t1, int num_threads)
+{
+  /*
+   * y = p(L) x = (-1)^degree T_degree((L - center) / half_width) x by the
+   * Chebyshev recurrence T_k+1 = 2 u T_k - T_k-1; t0 and t1 are n long
+   * scratch vectors
+   */
+  double *buffers[3] = {t0, t1, y};
+  double h = filter.half_width, c = filter.center;
+  double sign = filter.degree % 2 ? -1 : 1, f;
+  int k, d = filter.degree;
+
+  f = d == 1 ? sign : 1;
+  spectral_apply(g, f / h, -f * c / h, 0, x, NULL, buffers[0],
+          num_threads);
+  for (k = 2; k <= d; k++){
+    f = k == d ? sign : 1;
+    spectral_apply(g, 2 * f / h, -2 * f * c / h, -f, buffers[(k-2) % 3],
+            k == 2 ? x : buffers[(k-3) % 3], buffers[(k-1) % 3],
+            num_threads);
+  }
+  if ((d - 1) % 3 != 2)
+    std::copy(buffers[(d-1) % 3], buffers[(d-1) % 3] + g.n, y);
+}
+
+inline double spectral_orthogonalize(const double *basis, int num,
+        uint32_t n, double *w, double *coef, std::vector<double> &partial,
+        int num_threads)
+{
+  /*
+   * remove from w its components along the constant vector and the num
+   * orthonormal vectors of basis (n values each, one after the other);
+   * coef gets the components along the basis. Returns the fraction of
+   * the squared length of w that is left, from the removed components
+   * (too small after cancellation, never too large).
+   */
+  int chunks = spectral_num_chunks(n), c, j;
+  double mean = 0, length = 0, removed;
+
+  partial.assign((size_t)chunks * (num + 2), 0);
+  parallel_for(chunks, num_threads, [&](int c, int){
+    uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+    uint32_t end = spectral_chunk_end(n, start);
+    double *p = &partial[(size_t)c * (num + 2)];
+    for (int j = 0; j < num; j++){
+      const double *v = basis + (size_t)j * n;
+      double sum = 0;
+      for (i = start; i < end; i++)
+        sum += v[i] * w[i];
+      p[j] = sum;
+    }
+    for (i = start; i < end; i++){
+      p[num] += w[i];
+      p[num+1] += w[i] * w[i];
+    }
+  });
+  for (j = 0; j < num; j++)
+    coef[j] = 0;
+  for (c = 0; c < chunks; c++){
+    const double *p = &partial[(size_t)c * (num + 2)];
+    for (j = 0; j < num; j++)
+      coef[j] += p[j];
+    mean += p[num];
+    length += p[num+1];
+  }
+  removed = mean * mean / n;
+  for (j = 0; j < num; j++)
+    removed += coef[j] * coef[j];
+  mean /= n;
+
+  parallel_for(chunks, num_threads, [&](int c, int){
+    uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+    uint32_t end = spectral_chunk_end(n, start);
+    for (i = start; i < end; i++)
+      w[i] -= mean;
+    for (int j = 0; j < num; j++){
+      const double *v = basis + (size_t)j * n;
+      for (i = start; i < end; i++)
+        w[i] -= coef[j] * v[i];
+    }
+  });
+  return length > 0 ? 1 - removed / length : 0;
+}
+
+inline double spectral_normalize(double *w, uint32_t n,
+        std::vector<double> &partial, int num_threads)
+{
+  /* scale w to unit length; returns its length before */
+  int chunks = spectral_num_chunks(n), c;
+  double norm = 0;
+  partial.assign(chunks, 0);
+  parallel_for(chunks, num_threads, [&](int c, int){
+    uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+    uint32_t end = spectral_chunk_end(n, start);
+    for (i = start; i < end; i++)
+      partial[c] += w[i] * w[i];
+  });
+  for (c = 0; c < chunks; c++)
+    norm += partial[c];
+  norm = sqrt(norm);
+  if (norm > 0){
+    parallel_for(chunks, num_threads, [&](int c, int){
+      uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+      uint32_t end = spectral_chunk_end(n, start);
+      for (i = start; i < end; i++)
+        w[i] /= norm;
+    });
+  }
+  return norm;
+}
+
+inline void spectral_jacobi(int m, double *a, double *v)
+{
+  /*
+   * eigenvalues of the symmetric m x m matrix a (row-major) by cyclic
+   * Jacobi rotations: a ends up diagonal with them and the columns of v
+   * are the eigenvectors
+   */
+  int p, q, k, sweep;
+  for (p = 0; p < m * m; p++)
+    v[p] = p % (m + 1) == 0;
+  for (sweep = 0; sweep < 100; sweep++){
+    double off = 0, total = 0;
+    for (p = 0; p < m; p++){
+      total += a[p*m+p] * a[p*m+p];
+      for (q = p + 1; q < m; q++)
+        off += a[p*m+q] * a[p*m+q];
+    }
+    if (off <= DBL_EPSILON * DBL_EPSILON * (total + off))
+      break;
+    for (p = 0; p < m; p++){
+      for (q = p + 1; q < m; q++){
+        double apq = a[p*m+q];
+        if (apq == 0) continue;
+        double theta = (a[q*m+q] - a[p*m+p]) / (2 * apq);
+        double t = 1 / (fabs(theta) + sqrt(theta * theta + 1));
+        if (theta < 0)
+          t = -t;
+        double c = 1 / sqrt(t * t + 1), s = t * c;
+        for (k = 0; k < m; k++){
+          double akp = a[k*m+p], akq = a[k*m+q];
+          a[k*m+p] = c * akp - s * akq;
+          a[k*m+q] = s * akp + c * akq;
+        }
+        for (k = 0; k < m; k++){
+          double apk = a[p*m+k], aqk = a[q*m+k];
+          a[p*m+k] = c * apk - s * aqk;
+          a[q*m+k] = s * apk + c * aqk;
+        }
+        for (k = 0; k < m; k++){
+          double vkp = v[k*m+p], vkq = v[k*m+q];
+          v[k*m+p] = c * vkp - s * vkq;
+          v[k*m+q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+}
+
+inline void spectral_rotate(double *basis, uint32_t n, int m,
+        const double *s, const int *columns, int num, int num_threads)
+{
+  /*
+   * first num basis vectors <- basis (m vectors) times the given
+   * columns of the m x m matrix s (row-major): the Ritz vectors
+   */
+  std::vector<std::vector<double> > buffers(std::max(num_threads, 1));
+  parallel_for(spectral_num_chunks(n), num_threads, [&](int c, int thread){
+    uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+    uint32_t end = spectral_chunk_end(n, start), len = end - start;
+    std::vector<double> &out = buffers[thread];
+    int j, r;
+    out.assign((size_t)num * len, 0);
+    for (j = 0; j < m; j++){
+      const double *v = basis + (size_t)j * n + start;
+      for (r = 0; r < num; r++){
+        double f = s[j*m+columns[r]];
+        double *o = &out[(size_t)r * len];
+        for (i = 0; i < len; i++)
+          o[i] += f * v[i];
+      }
+    }
+    for (r = 0; r < num; r++)
+      std::copy(&out[(size_t)r * len], &out[(size_t)r * len] + len,
+              basis + (size_t)r * n + start);
+  });
+}
+
+inline double spectral_residual(const Spectral_graph &g, const double *y,
+        double *ly, double *rho, std::vector<double> &partial,
+        int num_threads)
+{
+  /* |L y - rho y| for the unit vector y and rho = y'L y; ly is scratch */
+  int chunks = spectral_num_chunks(g.n), c;
+  double sum = 0;
+  spectral_apply(g, 1, 0, 0, y, NULL, ly, num_threads);
+  for (int pass = 0; pass < 2; pass++){
+    partial.assign(chunks, 0);
+    parallel_for(chunks, num_threads, [&](int c, int){
+      uint32_t i, start = (uint32_t)c * SPECTRAL_CHUNK;
+      uint32_t end = spectral_chunk_end(g.n, start);
+      for (i = start; i < end; i++){
+        double r = ly[i] - *rho * y[i];
+        partial[c] += pass == 0 ? y[i] * ly[i] : r * r;
+      }
+    });
+    if (pass == 0)
+      *rho = 0;
+    sum = 0;
+    for (c = 0; c < chunks; c++)
+      sum += partial[c];
+    if (pass == 0)
+      *rho = sum;
+  }
+  return sqrt(sum);
+}
+
+inline bool spectral_lanczos(const Spectral_graph &g,
+        const Spectral_options &options, double *vectors, int num_locked,
+        int want, uint64_t seed, double upper, double *rho,
+        double *residuals, int *restarts)
+{
+  /*
+   * thick-restart Lanczos for the want smallest eigenvalues of L on the
+   * complement of the constant vector and the num_locked orthonormal
+   * vectors at the start of vectors; the basis follows them, and its
+   * first want vectors end up the Ritz vectors, with their Rayleigh
+   * quotients in rho and their residuals in residuals. Random vectors
+   * come from seed; restarts gets the restarts added. Returns whether
+   * every residual is below tolerance * upper.
+   */
+  uint32_t n = g.n, i;
+  int threads = options.num_threads, m, keep, j, r, cycle;
+  double beta = 0, residual, *basis = vectors + (size_t)num_locked * n;
+  Spectral_filter filter;
+  std::vector<double> t, a, s, coef, partial, scratch;
+  std::vector<int> order;
+
+  m = options.basis_size > 0 ? options.basis_size :
+          std::max(4 * want, want + 60);
+  m = (int)std::min<uint64_t>(std::max(m, want + 1), n - 1 - num_locked);
+  scratch.resize(2 * (size_t)n);
+  t.assign((size_t)m * m, 0);
+  a.resize((size_t)m * m);
+  s.resize((size_t)m * m);
+  coef.resize(num_locked + m + 1);
+  order.resize(m);
+
+  /* reproducible random start; the first cycle runs on 1 - 2 L / upper */
+  for (i = 0; i < n; i++)
+    basis[i] = spectral_uniform(seed, i) - 0.5;
+  for (r = 0; r < (num_locked > 0 ? 2 : 1); r++)
+    spectral_orthogonalize(vectors, num_locked, n, basis, coef.data(),
+            partial, threads);
+  spectral_normalize(basis, n, partial, threads);
+  spectral_filter_init(filter, 1, 0, upper);
+
+  keep = 0;
+  for (cycle = 0; ; cycle++, (*restarts)++){
+    for (j = keep; j < m; j++){
+      double *w = &basis[(size_t)(j + 1) * n], alpha = 0;
+      spectral_filter_apply(g, filter, &basis[(size_t)j * n], w,
+              scratch.data(), scratch.data() + n, threads);
+      for (r = 0; r < 2; r++){
+        /* the second pass only if the first removed over half of w */
+        double left = spectral_orthogonalize(vectors, num_locked + j + 1,
+                n, w, coef.data(), partial, threads);
+        alpha += coef[num_locked + j];
+        if (left > 0.5)
+          break;
+      }
+      t[(size_t)j*m+j] = alpha;
+      beta = spectral_normalize(w, n, partial, threads);
+      if (beta <= 1e-12 * filter.largest){
+        /* invariant subspace: go on from a new random direction */
+        for (i = 0; i < n; i++)
+          w[i] = spectral_uniform(seed + cycle * (uint64_t)m + j + 1, i) -
+                  0.5;
+        for (r = 0; r < 2; r++)
+          spectral_orthogonalize(vectors, num_locked + j + 1, n, w,
+                  coef.data(), partial, threads);
+        spectral_normalize(w, n, partial, threads);
+        beta = 0;
+      }
+      if (j + 1 < m)
+        t[(size_t)j*m+j+1] = t[(size_t)(j+1)*m+j] = beta;
+    }
+
+    /* Ritz vectors, largest Ritz value first (smallest eigenvalue) */
+    a = t;
+    spectral_jacobi(m, a.data(), s.data());
+    for (j = 0; j < m; j++)
+      order[j] = j;
+    std::stable_sort(order.begin(), order.end(), [&a, m](int x, int y){
+      return a[(size_t)x*m+x] > a[(size_t)y*m+y];
+    });
+    keep = std::min(m - 1, want + (m - want) / 2);
+    spectral_rotate(basis, n, m, s.data(), order.data(), keep, threads);
+
+    residual = 0;
+    for (j = 0; j < want; j++){
+      residuals[j] = spectral_residual(g, &basis[(size_t)j * n],
+              scratch.data(), &rho[j], partial, threads);
+      residual = std::max(residual, residuals[j]);
+    }
+    if (residual <= options.tolerance * upper)
+      return true;
+    if (*restarts >= options.max_restarts)
+      return false;
+
+    if (filter.degree == 1){
+      /*
+       * the keep-th Ritz value bounds the keep-th eigenvalue from above,
+       * so all wanted ones are below it: damp everything above with the
+       * Chebyshev filter and start over from the kept Ritz vectors
+       */
+      double cut = upper / 2 * (1 - a[(size_t)order[keep-1]*m+
+              order[keep-1]]);
+      if (cut > 0 && cut < upper / 2){
+        spectral_filter_init(filter, SPECTRAL_FILTER_DEGREE, cut, upper);
+        for (j = 1; j < keep; j++){
+          const double *y = &basis[(size_t)j * n];
+          for (i = 0; i < n; i++)
+            basis[i] += y[i];
+        }
+        spectral_normalize(basis, n, partial, threads);
+        std::fill(t.begin(), t.end(), 0);
+        keep = 0;
+        continue;
+      }
+    }
+
+    /* thick restart: the residual goes after the kept Ritz vectors */
+    std::copy(&basis[(size_t)m * n], &basis[(size_t)m * n] + n,
+            &basis[(size_t)keep * n]);
+    std::fill(t.begin(), t.end(), 0);
+    for (j = 0; j < keep; j++){
+      t[(size_t)j*m+j] = a[(size_t)order[j]*m+order[j]];
+      t[(size_t)j*m+keep] = t[(size_t)keep*m+j] =
+              beta * s[(size_t)(m-1)*m+order[j]];
+    }
+  }
+}
+
+inline void spectral_smallest(const Spectral_graph &g,
+        const Spectral_options &options, Spectral_result &result)
+{
+  /*
+   * the options.num smallest nonzero eigenvalues of the Laplacian of g,
+   * which must be connected, and their eigenvectors, each with its
+   * largest entry positive (fewer if g has at most num points)
+   */
+  uint32_t n = g.n, i;
+  int num, m, locked = 0, want, total, round, j;
+  double upper = 0, largest, smallest;
+  std::vector<double> vectors, rho, residuals, identity, sorted;
+  std::vector<int> order;
+
+  result.values.clear();
+  result.vectors.clear();
+  result.residual = 0;
+  result.restarts = 0;
+  result.converged = true;
+  num = (int)std::min<uint64_t>(std::max(options.num, 0), n > 0 ? n - 1 : 0);
+  if (num == 0)
+    return;
+  m = options.basis_size > 0 ? options.basis_size :
+          std::max(4 * num, num + 60);
+  m = (int)std::min<uint64_t>(std::max(m, num + 1), n - 1);
+  for (i = 0; i < n; i++)
+    upper = std::max(upper, 2.0 * (double)(g.ptr[i+1] - g.ptr[i]));
+  vectors.resize((size_t)(num + m + 1) * n);
+  rho.resize(2 * num);
+  residuals.resize(2 * num);
+  sorted.resize(2 * num);
+  order.resize(2 * num);
+
+  for (round = 0; ; round++){
+    /*
+     * the locked vectors are the num best found so far; search their
+     * complement from a new random start, which finds the other copies
+     * of repeated eigenvalues that a single Krylov space cannot hold
+     */
+    want = (int)std::min<uint64_t>(num, n - 1 - locked);
+    if (want == 0)
+      break;
+    result.converged = spectral_lanczos(g, options, vectors.data(), locked,
+            want, (uint64_t)round << 32, upper, &rho[locked],
+            &residuals[locked], &result.restarts);
+    if (locked > 0 && result.converged){
+      /* nothing in the complement below the locked ones: all found */
+      largest = *std::max_element(rho.begin(), rho.begin() + locked);
+      smallest = *std::min_element(rho.begin() + locked,
+              rho.begin() + locked + want);
+      if (smallest >= largest - options.tolerance * upper)
+        break;
+    }
+
+    /* keep the num smallest of the locked and the new vectors */
+    total = locked + want;
+    for (j = 0; j < total; j++)
+      order[j] = j;
+    std::stable_sort(order.begin(), order.begin() + total,
+            [&rho](int x, int y){
+      return rho[x] < rho[y];
+    });
+    identity.assign((size_t)total * total, 0);
+    for (j = 0; j < total; j++)
+      identity[(size_t)j*total+j] = 1;
+    locked = std::min(num, total);
+    spectral_rotate(vectors.data(), n, total, identity.data(), order.data(),
+            locked, options.num_threads);
+    for (j = 0; j < locked; j++)
+      sorted[j] = rho[order[j]];
+    std::copy(sorted.begin(), sorted.begin() + locked, rho.begin());
+    for (j = 0; j < locked; j++)
+      sorted[j] = residuals[order[j]];
+    std::copy(sorted.begin(), sorted.begin() + locked, residuals.begin());
+    if (!result.converged)
+      break;
+  }
+
+  /* the locked vectors, ascending by Rayleigh quotient */
+  result.values.resize(num);
+  result.vectors.resize((size_t)num * n);
+  for (j = 0; j < num; j++){
+    double *v = &result.vectors[(size_t)j * n];
+    const double *y = &vectors[(size_t)j * n];
+    uint32_t largest_entry = 0;
+    result.values[j] = rho[j];
+    result.residual = std::max(result.residual, residuals[j]);
+    for (i = 1; i < n; i++){
+      if (fabs(y[i]) > fabs(y[largest_entry]))
+        largest_entry = i;
+    }
+    for (i = 0; i < n; i++)
+      v[i] = y[largest_entry] < 0 ? -y[i] : y[i];
+  }
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "active_search.h"
+#include "knn_graph_file.h"
+#include "../models/knn_model.h"
+#include "../models/test_knn_graph.h"
+#include "../score_functions/ens_score.h"
+#include "../query_strategies/batch_ens_score.h"
+
+/*
+ * Checks the C API of active_search.h, linked from the library, against
+ * the headers it wraps: after random observations the probabilities, the
+ * top points, ranks and sums are those of a posterior updated directly
+ * and sorted; the ENS and batch-ENS scores are those of ens_scores and
+ * batch_ens_scores; pushes and pops leave the model as it was; a graph
+ * opened from a knn_graph_write file behaves as the one created from the
+ * same lists; the baselines and the cost expectations agree with sorting
+ * and merging by hand; and bad arguments get the documented status
+ * codes. The weights are small integers, so that every count is exact
+ * and the results must agree to the bit. Returns 1 on failure.
+ */
+
+const char *TEST_FILE = "test_active_search.knng";
+
+static int errors = 0;
+
+static void expect(bool ok, const char *what)
+{
+  if (!ok){
+    if (errors < 10)
+      printf("%s\n", what);
+    errors++;
+  }
+}
+
+static void compare_models(const as_model *model, const Knn_posterior &post,
+        int n, const char *what)
+{
+  /* probabilities, order, ranks and top sums against a stable sort */
+  std::vector<int> all(n), want, top;
+  std::vector<double> probs(n), direct(n);
+  int i, rank;
+  double sum = 0, got;
+
+  for (i = 0; i < n; i++)
+    all[i] = i;
+  expect(as_model_probabilities(model, all.data(), n, probs.data()) ==
+          AS_OK, what);
+  for (i = 0; i < n; i++){
+    direct[i] = knn_probability(post, i);
+    if (!post.observed[i])
+      want.push_back(i);
+  }
+  expect(probs == direct, what);
+  std::stable_sort(want.begin(), want.end(), [&direct](int a, int b){
+    return direct[a] > direct[b];
+  });
+  expect(as_model_num_unlabeled(model) == (int)want.size(), what);
+  top.resize(want.size());
+  expect(as_model_top(model, (int)top.size(), top.data()) == AS_OK &&
+          top == want, what);
+  for (i = 0; i < (int)want.size(); i++){
+    sum += direct[want[i]];
+    expect(as_model_rank(model, want[i], &rank) == AS_OK && rank == i,
+            what);
+    expect(as_model_top_sum(model, i + 1, &got) == AS_OK &&
+            fabs(got - sum) <= 1e-12 * (i + 1), what);
+  }
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double alpha[2] = {0.1, 0.9};
+  int n = 400, k = 8, budget = 20, i, j, step;
+
+  /* neighbor lists with integer weights, and their transpose */
+  Test_graph g;
+  test_random_graph(g, n, k, n, true, gen);
+  const Knn_weights &w = g.w;
+
+  as_graph *graph = NULL, *opened = NULL;
+  as_model *model = NULL, *model_opened = NULL;
+  expect(as_api_version() == AS_API_VERSION, "api version");
+  expect(as_graph_create(n, g.col_ptr.data(), g.row_ind.data(), g.vals.data(),
+          &graph) == AS_OK && as_graph_num_points(graph) == n,
+          "graph create");
+
+  Knn_graph_view view;
+  std::string error;
+  view.num_points = n;
+  view.neighbor_ptr = g.neighbor_ptr.data();
+  view.neighbor_ind = g.neighbor_ind.data();
+  view.neighbor_val = g.neighbor_val.data();
+  expect(knn_graph_write(TEST_FILE, view, &error), error.c_str());
+  expect(as_graph_open(TEST_FILE, &opened) == AS_OK &&
+          as_graph_num_points(opened) == n, "graph open");
+  expect(as_model_create(graph, alpha[0], alpha[1], &model) == AS_OK,
+          "model create");
+  expect(as_model_create(opened, alpha[0], alpha[1], &model_opened) ==
+          AS_OK, "model create (opened)");
+  if (errors > 0){
+    printf("%d errors\n", errors);
+    return 1;
+  }
+
+  Knn_posterior post;
+  knn_posterior_init(post, w, alpha, NULL, NULL, 0);
+  compare_models(model, post, n, "initial model");
+
+  for (step = 0; step < 30; step++){
+    /* a real observation */
+    int x = (int)(gen() % n), positive = (int)(gen() % 2);
+    if (post.observed[x]) continue;
+    knn_posterior_add(post, w, x, positive);
+    expect(as_model_observe(model, x, positive) == AS_OK &&
+            as_model_observe(model_opened, x, positive) == AS_OK,
+            "observe");
+    compare_models(model, post, n, "model after observe");
+    compare_models(model_opened, post, n, "opened model after observe");
+
+    /* fictional ones, which must leave the model as it was */
+    int depth = 1 + (int)(gen() % 3), d;
+    for (d = 0; d < depth; d++){
+      x = (int)(gen() % n);
+      positive = (int)(gen() % 2);
+      knn_posterior_push(post, w, x, positive);
+      expect(as_model_push(model, x, positive) == AS_OK, "push");
+    }
+    expect(as_model_num_pushed(model) == depth, "num pushed");
+    compare_models(model, post, n, "model after push");
+    expect(as_ens_scores(model, &x, 1, budget, NULL, NULL, NULL, NULL) ==
+            AS_ERROR_ARGUMENT && as_model_observe(model, x, 1) ==
+            AS_ERROR_ARGUMENT, "scores and observe with pushes");
+    for (d = 0; d < depth; d++){
+      knn_posterior_pop(post, w);
+      expect(as_model_pop(model) == AS_OK, "pop");
+    }
+    expect(as_model_pop(model) == AS_ERROR_ARGUMENT, "pop of nothing");
+    compare_models(model, post, n, "model after pop");
+
+    /* ENS and batch-ENS scores of every unlabeled point */
+    std::vector<int> candidates;
+    std::vector<double> probs, bound;
+    for (i = 0; i < n; i++){
+      if (post.observed[i]) continue;
+      candidates.push_back(i);
+      probs.push_back(knn_probability(post, i));
+      bound.push_back(probs.back() + budget * uniform(gen));
+    }
+    int num = (int)candidates.size(), best, want_best;
+    std::vector<double> scores(num), want(num);
+    std::vector<char> pruned(num), want_pruned(num);
+    Ens_context ctx;
+    ens_context_init(ctx, w, post);
+    want_best = ens_scores(ctx, candidates.data(), num, budget, bound.data(),
+            want.data(), want_pruned.data());
+    expect(as_ens_scores(model, candidates.data(), num, budget, bound.data(),
+            scores.data(), pruned.data(), &best) == AS_OK &&
+            best == want_best && scores == want && pruned == want_pruned,
+            "ens scores");
+
+    if (step % 5 != 0) continue;
+    int num_selected = 3, num_samples = 4;
+    std::vector<int> selected(candidates.begin(),
+            candidates.begin() + num_selected);
+    std::vector<double> samples(num_selected * num_samples);
+    std::vector<double> sample_weights(num_samples);
+    for (i = 0; i < (int)samples.size(); i++)
+      samples[i] = (double)(gen() % 2);
+    for (i = 0; i < num_samples; i++)
+      sample_weights[i] = 1 + (double)(gen() % 3);
+    Batch_ens_samples s;
+    batch_ens_samples_init(s, w, post, selected.data(), num_selected,
+            samples.data(), num_samples, budget, 1);
+    want_best = batch_ens_scores(s, sample_weights.data(),
+            candidates.data(), probs.data(), num, budget, bound.data(), 1,
+            want.data(), want_pruned.data(), NULL);
+    expect(as_batch_ens_scores(model, selected.data(), num_selected,
+            samples.data(), sample_weights.data(), num_samples,
+            candidates.data(), probs.data(), num, budget, bound.data(), 2,
+            scores.data(), pruned.data(), &best) == AS_OK &&
+            best == want_best && scores == want && pruned == want_pruned,
+            "batch ens scores");
+  }
+
+  /* reset forgets the observations */
+  knn_posterior_init(post, w, alpha, NULL, NULL, 0);
+  expect(as_model_reset(model) == AS_OK && as_model_num_observed(model) == 0,
+          "reset");
+  compare_models(model, post, n, "model after reset");
+
+  /* the baselines against sort(p, 'descend') and sort(abs(p - 0.5)) */
+  {
+    int m = 1000, num_greedy = 15, num_uncertain = 25;
+    std::vector<double> p(m);
+    std::vector<int> order(m), greedy(num_greedy), uncertain(num_uncertain);
+    for (i = 0; i < m; i++){
+      p[i] = (gen() % 64) / 63.0;
+      order[i] = i;
+    }
+    expect(as_top_k_select(p.data(), m, num_greedy, num_uncertain,
+            greedy.data(), uncertain.data()) == AS_OK, "top k select");
+    std::stable_sort(order.begin(), order.end(), [&p](int a, int b){
+      return p[a] > p[b];
+    });
+    expect(std::equal(greedy.begin(), greedy.end(), order.begin()),
+            "greedy selection");
+    for (i = 0; i < m; i++)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&p](int a, int b){
+      return fabs(p[a] - 0.5) < fabs(p[b] - 0.5);
+    });
+    expect(std::equal(uncertain.begin(), uncertain.end(), order.begin()),
+            "uncertain selection");
+  }
+
+  /* batched expectations against the merged lists one at a time */
+  {
+    int m = 300, q;
+    std::vector<double> p(m);
+    for (i = 0; i < m; i++)
+      p[i] = 0.5 * uniform(gen);
+    std::sort(p.begin(), p.end(), std::greater<double>());
+    std::vector<std::vector<int> > excluded(20);
+    std::vector<std::vector<double> > merged(20);
+    std::vector<as_npb_query> queries(20);
+    std::vector<double> expectations(20);
+    for (q = 0; q < 20; q++){
+      for (i = 0; i < m; i++){
+        if (gen() % 50 == 0)
+          excluded[q].push_back(i);
+      }
+      for (i = (int)(gen() % 4); i > 0; i--)
+        merged[q].push_back(uniform(gen));
+      std::sort(merged[q].begin(), merged[q].end(), std::greater<double>());
+      queries[q].excluded = excluded[q].data();
+      queries[q].num_excluded = (int)excluded[q].size();
+      queries[q].q = merged[q].data();
+      queries[q].num_q = (int)merged[q].size();
+      queries[q].num_heads = 1 + (int)(gen() % 10);
+    }
+    expect(as_npb_expectations(p.data(), m, queries.data(), 20, 0.999,
+            expectations.data()) == AS_OK, "npb expectations");
+    for (q = 0; q < 20; q++){
+      std::vector<double> coins(merged[q]);
+      double e = 0;
+      for (i = 0, j = 0; i < m; i++){
+        if (j < queries[q].num_excluded && excluded[q][j] == i)
+          j++;
+        else
+          coins.push_back(p[i]);
+      }
+      std::stable_sort(coins.begin(), coins.end(), std::greater<double>());
+      expect(as_npb_expectation(coins.data(), (int)coins.size(),
+              queries[q].num_heads, 0.999, &e) == AS_OK &&
+              fabs(expectations[q] - e) <= 1e-9 * e, "npb expectation");
+    }
+  }
+
+  /* bad arguments */
+  {
+    as_graph *none = NULL;
+    as_model *no_model = NULL;
+    int bad = n, rank;
+    double sum;
+    expect(as_graph_open("no_such_file.knng", &none) == AS_ERROR_IO &&
+            none == NULL, "missing graph file");
+    expect(as_graph_create(n, NULL, g.row_ind.data(), g.vals.data(), &none) ==
+            AS_ERROR_ARGUMENT, "graph without pointers");
+    expect(as_model_create(NULL, 1, 1, &no_model) == AS_ERROR_ARGUMENT &&
+            as_model_create(graph, 0, 1, &no_model) == AS_ERROR_ARGUMENT,
+            "model arguments");
+    expect(as_model_observe(model, bad, 1) == AS_ERROR_ARGUMENT &&
+            as_model_observe(model, -1, 1) == AS_ERROR_ARGUMENT &&
+            as_model_push(model, bad, 1) == AS_ERROR_ARGUMENT &&
+            as_model_rank(model, bad, &rank) == AS_ERROR_ARGUMENT &&
+            as_model_probabilities(model, &bad, 1, &sum) ==
+            AS_ERROR_ARGUMENT, "point out of range");
+    expect(as_model_top(model, n + 1, &rank) == AS_ERROR_ARGUMENT &&
+            as_model_top_sum(model, -1, &sum) == AS_ERROR_ARGUMENT,
+            "top of too many");
+    expect(as_npb_expectation(NULL, 3, 1, 1, &sum) == AS_ERROR_ARGUMENT,
+            "expectation without coins");
+    for (i = AS_OK; i <= AS_ERROR_IO; i++)
+      expect(as_status_string(i) != NULL, "status string");
+  }
+
+  as_model_free(model);
+  as_model_free(model_opened);
+  as_graph_free(graph);
+  as_graph_free(opened);
+  remove(TEST_FILE);
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
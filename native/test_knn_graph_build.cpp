@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "knn_graph_build.h"
+
+/*
+ * Checks knn_build_dense and knn_build_tanimoto against a brute force
+ * search that sorts all other points of each query by (distance, index)
+ * or (-similarity, index). The dense sets include points far from the
+ * origin with tiny spacing, where |x|^2 + |y|^2 - 2 x'y cancels, and
+ * duplicates. Returns 1 on failure.
+ */
+
+const int NUM_THREADS = 4;
+
+static int compare(const char *name, uint32_t n, int k,
+        const std::vector<uint32_t> &neighbors,
+        const std::vector<double> &values,
+        const std::vector<Knn_candidate> &all, int sign)
+{
+  /* all holds the n - 1 sorted candidates of every query, one after the
+     other; sign is -1 when the keys are negated similarities */
+  uint32_t q;
+  int j, errors = 0;
+  for (q = 0; q < n; q++){
+    const Knn_candidate *want = &all[(size_t)q * (n - 1)];
+    for (j = 0; j < k; j++){
+      uint32_t got = neighbors[(size_t)q * k + j];
+      double value = values[(size_t)q * k + j];
+      double want_value = sign < 0 ? -want[j].first : sqrt(want[j].first);
+      if (got != want[j].second || value != want_value){
+        if (errors < 10)
+          printf("%s: query %u neighbor %d is %u (%.17g), brute force %u "
+                  "(%.17g)\n", name, q, j, got, value, want[j].second,
+                  want_value);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+static int test_dense(const char *name, const std::vector<double> &points,
+        uint32_t n, int d, int k)
+{
+  std::vector<uint32_t> neighbors((size_t)n * k);
+  std::vector<double> distances((size_t)n * k);
+  std::vector<Knn_candidate> all;
+  uint32_t q, c;
+
+  knn_build_dense(points.data(), n, d, k, NUM_THREADS, neighbors.data(),
+          distances.data());
+  for (q = 0; q < n; q++){
+    size_t start = all.size();
+    for (c = 0; c < n; c++){
+      if (c != q)
+        all.push_back(Knn_candidate(knn_squared_distance(
+                &points[(size_t)q * d], &points[(size_t)c * d], d), c));
+    }
+    std::sort(all.begin() + start, all.end());
+  }
+  return compare(name, n, k, neighbors, distances, all, 1);
+}
+
+static int test_tanimoto(const std::vector<uint64_t> &fingerprints,
+        uint32_t n, int words, int k)
+{
+  std::vector<uint32_t> neighbors((size_t)n * k);
+  std::vector<double> similarities((size_t)n * k);
+  std::vector<Knn_candidate> all;
+  uint32_t q, c;
+  int w;
+
+  knn_build_tanimoto(fingerprints.data(), n, words, k, NUM_THREADS,
+          neighbors.data(), similarities.data());
+  for (q = 0; q < n; q++){
+    size_t start = all.size();
+    for (c = 0; c < n; c++){
+      int common = 0, total = 0;
+      if (c == q) continue;
+      for (w = 0; w < words; w++){
+        uint64_t x = fingerprints[(size_t)q * words + w];
+        uint64_t y = fingerprints[(size_t)c * words + w];
+        common += knn_popcount(x & y);
+        total += knn_popcount(x | y);
+      }
+      all.push_back(Knn_candidate(total > 0 ? -(double)common / total : 0,
+              c));
+    }
+    std::sort(all.begin() + start, all.end());
+  }
+  return compare("tanimoto", n, k, neighbors, similarities, all, -1);
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  uint32_t n = 700, i;
+  int d = 3, k = 10, j, errors = 0;
+  std::vector<double> points((size_t)n * d);
+
+  for (i = 0; i < n * d; i++)
+    points[i] = uniform(gen);
+  errors += test_dense("uniform", points, n, d, k);
+
+  /* far from the origin, 1e-3 apart on a grid with some jitter */
+  for (i = 0; i < n; i++){
+    for (j = 0; j < d; j++)
+      points[(size_t)i * d + j] = 1e4 + 1e-3 * (double)(gen() % 10) +
+              1e-9 * uniform(gen);
+  }
+  errors += test_dense("offset", points, n, d, k);
+
+  /* duplicates: ties go to the smaller index */
+  for (i = 0; i < n; i++){
+    for (j = 0; j < d; j++)
+      points[(size_t)i * d + j] = (double)(gen() % 4);
+  }
+  errors += test_dense("duplicates", points, n, d, k);
+
+  int words = 2;
+  std::vector<uint64_t> fingerprints((size_t)n * words);
+  for (i = 0; i < n * words; i++)
+    fingerprints[i] = gen() & gen() & gen();
+  errors += test_tanimoto(fingerprints, n, words, k);
+
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
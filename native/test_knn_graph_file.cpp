@@ -0,0 +1,149 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "knn_graph_file.h"
+
+/*
+ * Writes random k-NN graphs (rows of different lengths, repeated
+ * neighbors) with knn_graph_write, maps them back and compares the
+ * neighbor lists and the influence lists with the sparse(...) sum they
+ * stand for; then damages copies of a file in the ways a reader must
+ * reject (bad offsets, lists and sizes) and checks that
+ * knn_graph_map_open refuses each of them. Returns 1 on failure.
+ */
+
+const char *TEST_FILE = "test_knn_graph_file.knng";
+const char *DAMAGED_FILE = "test_knn_graph_file_damaged.knng";
+
+static int round_trip(int trial, std::mt19937_64 &gen)
+{
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  uint64_t n = 50 + gen() % 50, k = 6, i, e, j;
+  std::vector<uint64_t> ptr(1, 0);
+  std::vector<uint32_t> ind;
+  std::vector<double> val, dense(n * n, 0);
+  Knn_graph_view g;
+  Knn_graph_map map;
+  std::string error;
+  int errors = 0;
+
+  for (i = 0; i < n; i++){
+    uint64_t length = gen() % (k + 1);
+    for (e = 0; e < length; e++){
+      j = gen() % n;
+      ind.push_back((uint32_t)j);
+      val.push_back(uniform(gen));
+      /* weights(i, j) summed as sparse() does; column j is influence j */
+      dense[j * n + i] += val.back();
+    }
+    ptr.push_back(ind.size());
+  }
+  g.num_points = n;
+  g.dataset_hash = 12345 + trial;
+  g.neighbor_ptr = ptr.data();
+  g.neighbor_ind = ind.data();
+  g.neighbor_val = val.data();
+  if (!knn_graph_write(TEST_FILE, g, &error) ||
+          !knn_graph_map_open(map, TEST_FILE, &error)){
+    printf("trial %d: %s\n", trial, error.c_str());
+    return 1;
+  }
+
+  const Knn_graph_view &v = map.view;
+  if (v.num_points != n || v.dataset_hash != g.dataset_hash || v.k > k)
+    errors++;
+  for (i = 0; i <= n && errors == 0; i++){
+    if (v.neighbor_ptr[i] != ptr[i])
+      errors++;
+  }
+  for (e = 0; e < ind.size() && errors == 0; e++){
+    if (v.neighbor_ind[e] != ind[e] || v.neighbor_val[e] != val[e])
+      errors++;
+  }
+  /* influence lists: the nonzeros of each column, rows ascending */
+  for (j = 0; j < n && errors == 0; j++){
+    e = map.weights.col_ptr[j];
+    for (i = 0; i < n; i++){
+      if (dense[j * n + i] == 0) continue;
+      if (e >= map.weights.col_ptr[j+1] || map.weights.row_ind[e] != i ||
+              fabs(map.weights.vals[e] - dense[j * n + i]) > 1e-12)
+        errors++;
+      e++;
+    }
+    if (e != map.weights.col_ptr[j+1])
+      errors++;
+  }
+  if (errors)
+    printf("trial %d: the graph read back differs\n", trial);
+  return errors;
+}
+
+static bool open_damaged(const std::vector<char> &bytes)
+{
+  Knn_graph_map map;
+  FILE *f = fopen(DAMAGED_FILE, "wb");
+  fwrite(bytes.data(), 1, bytes.size(), f);
+  fclose(f);
+  return knn_graph_map_open(map, DAMAGED_FILE, NULL);
+}
+
+static int damaged_files()
+{
+  std::vector<char> bytes;
+  Knn_graph_header h;
+  char buf[4096];
+  size_t got;
+  int errors = 0, d;
+  FILE *f = fopen(TEST_FILE, "rb");
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+    bytes.insert(bytes.end(), buf, buf + got);
+  fclose(f);
+  memcpy(&h, bytes.data(), sizeof(h));
+
+  if (!open_damaged(bytes)){
+    printf("the undamaged copy is rejected\n");
+    errors++;
+  }
+  for (d = 0; d < 9; d++){
+    std::vector<char> copy(bytes);
+    Knn_graph_header c = h;
+    uint64_t *influence_ptr = (uint64_t*)&copy[h.influence_ptr_offset];
+    uint64_t *influence_ind = (uint64_t*)&copy[h.influence_ind_offset];
+    uint32_t *neighbor_ind = (uint32_t*)&copy[h.neighbor_ind_offset];
+    uint64_t *neighbor_ptr = (uint64_t*)&copy[h.neighbor_ptr_offset];
+    switch (d){
+      case 0: influence_ptr[1] = influence_ptr[2] + 1; break;
+      case 1: influence_ind[0] = h.num_points; break;
+      case 2: neighbor_ind[0] = (uint32_t)h.num_points; break;
+      case 3: c.influence_val_offset += 4; break;
+      case 4: c.num_influence = ~(uint64_t)0 / 4; break;
+      case 5: influence_ptr[h.num_points]--; break;
+      case 6: copy.resize(copy.size() - 8); break;
+      case 7: c.k = 0; break;
+      case 8: neighbor_ptr[0] = 1; break;
+    }
+    if (d == 3 || d == 4 || d == 7)
+      memcpy(copy.data(), &c, sizeof(c));
+    if (open_damaged(copy)){
+      printf("damage %d is not detected\n", d);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  int trial, errors = 0;
+  for (trial = 0; trial < 20; trial++)
+    errors += round_trip(trial, gen);
+  errors += damaged_files();
+  remove(TEST_FILE);
+  remove(DAMAGED_FILE);
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "label_oracle.h"
+
+/*
+ * Writes random replay streams (commas, tabs, repeated points, blank
+ * lines, and % and # comment lines, indented or holding numbers, in any
+ * order) and checks that label_oracle_read_replay keeps exactly the last
+ * recorded label of each point, as replay_oracle.m's read_replay_stream
+ * does (label_oracles/test_replay_oracle.m compares the two in Matlab);
+ * then checks that a malformed line is refused. Returns 1 on failure.
+ */
+
+const char *TEST_FILE = "test_label_oracle.txt";
+
+static int replay_stream(int trial, std::mt19937_64 &gen)
+{
+  const char *comments[] = {"% header\n", "# 7 1\n", "  % 3,1\n",
+          "\t# note\n", "%\n", "#\n", "\n", "   \n"};
+  const char *separators[] = {" ", ",", "\t", ", ", "  "};
+  int n = 20 + (int)(gen() % 30), i, errors = 0;
+  size_t num_recorded = 0;
+  std::vector<double> want(n, 0);
+  Label_oracle oracle;
+  std::string error;
+
+  FILE *f = fopen(TEST_FILE, "w");
+  for (i = 0; i < 3 * n; i++){
+    if (gen() % 3 == 0){
+      fputs(comments[gen() % 8], f);
+      continue;
+    }
+    int point = (int)(gen() % n), label = 1 + (int)(gen() % 2);
+    fprintf(f, "%s%d%s%d\n", gen() % 4 == 0 ? "  " : "", point + 1,
+            separators[gen() % 5], label);
+    want[point] = label;
+    num_recorded++;
+  }
+  fclose(f);
+
+  if (!label_oracle_read_replay(oracle, TEST_FILE, &error)){
+    printf("trial %d: %s\n", trial, error.c_str());
+    return 1;
+  }
+  if (oracle.num_recorded != num_recorded){
+    printf("trial %d: %zu observations, want %zu\n", trial,
+            oracle.num_recorded, num_recorded);
+    errors++;
+  }
+  for (i = 0; i < n; i++){
+    double got = (size_t)i < oracle.labels.size() ? oracle.labels[i] : 0;
+    if (got != want[i]){
+      if (errors < 10)
+        printf("trial %d point %d: label %g, want %g\n", trial, i + 1,
+                got, want[i]);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  Label_oracle oracle;
+  std::string error;
+  int trial, errors = 0;
+
+  for (trial = 0; trial < 20; trial++)
+    errors += replay_stream(trial, gen);
+
+  FILE *f = fopen(TEST_FILE, "w");
+  fprintf(f, "# bad\n1 1\n2\n");
+  fclose(f);
+  if (label_oracle_read_replay(oracle, TEST_FILE, &error)){
+    printf("a line without a label is accepted\n");
+    errors++;
+  }
+  remove(TEST_FILE);
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
@@ -0,0 +1,101 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "spectral_embedding.h"
+
+/*
+ * Checks spectral_smallest on graphs whose spectra are known: a cycle,
+ * where every nonzero eigenvalue 2 - 2 cos(2 pi j / n) but the last is
+ * repeated, and a path, where 2 - 2 cos(pi j / n) are simple. The
+ * eigenvalues must match, the eigenvectors must be orthonormal and
+ * orthogonal to the constant vector, and the result must be converged.
+ * Returns 1 on failure.
+ */
+
+const int NUM_THREADS = 4;
+
+static void ring(Spectral_graph &g, uint32_t n, bool closed)
+{
+  /* points i and i + 1 joined, and n - 1 and 0 if closed */
+  uint32_t i;
+  g.n = n;
+  g.ptr.assign(1, 0);
+  g.ind.clear();
+  for (i = 0; i < n; i++){
+    if (i > 0 || closed)
+      g.ind.push_back(i > 0 ? i - 1 : n - 1);
+    if (i + 1 < n || closed)
+      g.ind.push_back(i + 1 < n ? i + 1 : 0);
+    if (closed && g.ind[g.ind.size() - 2] > g.ind.back())
+      std::swap(g.ind[g.ind.size() - 2], g.ind.back());
+    g.ptr.push_back(g.ind.size());
+  }
+}
+
+static int test(const char *name, const Spectral_graph &g, int num,
+        const std::vector<double> &want)
+{
+  Spectral_options options;
+  Spectral_result result;
+  uint32_t n = g.n, i;
+  int j, l, errors = 0;
+
+  options.num = num;
+  options.num_threads = NUM_THREADS;
+  spectral_smallest(g, options, result);
+  if (!result.converged || (int)result.values.size() != num){
+    printf("%s: %d values, converged %d\n", name,
+            (int)result.values.size(), (int)result.converged);
+    return 1;
+  }
+  for (j = 0; j < num; j++){
+    if (fabs(result.values[j] - want[j]) > 1e-9 * want[j]){
+      printf("%s: eigenvalue %d is %.12g, want %.12g\n", name, j,
+              result.values[j], want[j]);
+      errors++;
+    }
+  }
+  for (j = 0; j < num; j++){
+    const double *x = &result.vectors[(size_t)j * n];
+    double sum = 0;
+    for (i = 0; i < n; i++)
+      sum += x[i];
+    if (fabs(sum) > 1e-8 * sqrt((double)n))
+      errors++;
+    for (l = 0; l <= j; l++){
+      const double *y = &result.vectors[(size_t)l * n];
+      double dot = 0;
+      for (i = 0; i < n; i++)
+        dot += x[i] * y[i];
+      if (fabs(dot - (l == j)) > 1e-8){
+        printf("%s: eigenvectors %d and %d have dot product %g\n", name, l,
+                j, dot);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  const double pi = 3.14159265358979323846;
+  uint32_t n = 5000;
+  int num = 20, j, errors = 0;
+  Spectral_graph g;
+  std::vector<double> want;
+
+  ring(g, n, true);
+  for (j = 0; j < num; j++)
+    want.push_back(2 - 2 * cos(2 * pi * (j / 2 + 1) / n));
+  errors += test("cycle", g, num, want);
+
+  ring(g, n, false);
+  want.clear();
+  for (j = 0; j < num; j++)
+    want.push_back(2 - 2 * cos(pi * (j + 1) / n));
+  errors += test("path", g, num, want);
+
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
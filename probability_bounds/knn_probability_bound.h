@@ -0,0 +1,266 @@
+#ifndef KNN_PROBABILITY_BOUND_H
+#define KNN_PROBABILITY_BOUND_H
+
+/*
+ * Native version of knn_probability_bound_improved.m for many label
+ * samples at once, as upper_bound_future_utility.m needs them.
+ *
+ * The bound of point i after num_positives more positive observations is
+ *
+ *   (alpha(1) + successes_i + count_i) /
+ *   (alpha(1) + alpha(2) + successes_i + count_i + failures_i)
+ *
+ * where count_i bounds the weight the new positives can add (see
+ * tight_level in knn_probability_bound_improved.m). count_i does not
+ * depend on the labels, so it is computed once, in O(1) per point from
+ * a Knn_bound_prefix: per row, the neighbors sorted by weight and the
+ * prefix sums of their weights, all of them and only those not in train.
+ * The latter are kept up to date with a train bitset; labeling a point
+ * redoes only the rows that list it (O(k) rows of O(k) each), so the
+ * tightest bound (level 4, any num_positives) costs as much as level 1.
+ * Rows sorted by weight, as load_data.m makes them, give the same counts
+ * as the Matlab code, which takes the first weights of a row; for other
+ * rows the largest weights keep the bound valid. Index 0 pads short
+ * rows (as load_knn_graph and knn_graph_convert write them); padding
+ * and zero weights are left out everywhere.
+ *
+ * The counts of the train
+ * points whose labels agree in all samples are accumulated once as well
+ * (one pass over their weight columns); each sample then only adds the
+ * columns of the points whose sampled labels differ, and keeps its top
+ * "budget" bounds.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "../models/knn_model.h"
+#include "../native/parallel_for.h"
+
+struct Knn_bound_prefix{
+  int n = 0, k = 0;
+  const double *knn_ind = NULL;      /* the lists it was built from */
+  uint64_t fingerprint = 0;
+  int num_train = 0;
+  std::vector<uint64_t> in_train;    /* bitset of the train points */
+  std::vector<int> sorted;           /* (n x k) neighbors by weight */
+  std::vector<double> all;           /* (n x (k+1)) prefix sums */
+  std::vector<double> free;          /* same, train points left out */
+  std::vector<int> num_free;
+  std::vector<int> rows_ptr, rows;   /* rows listing each point */
+};
+
+inline uint64_t knn_bound_fingerprint(const double *knn_ind,
+        const double *knn_weights, int n, int k)
+{
+  /* a few strided entries, enough to tell graphs apart */
+  uint64_t hash = ((uint64_t)n << 32) ^ (uint64_t)k, bits;
+  size_t i, size = (size_t)n * k, step = std::max<size_t>(1, size / 64);
+  for (i = 0; i < size; i += step){
+    memcpy(&bits, knn_ind + i, sizeof(bits));
+    hash = (hash ^ bits) * 0x100000001B3ULL;
+    memcpy(&bits, knn_weights + i, sizeof(bits));
+    hash = (hash ^ bits) * 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+inline double knn_bound_weight(const Knn_bound_prefix &p,
+        const double *knn_weights, int i, int x)
+{
+  /* weight of neighbor x of row i, 0 for padding */
+  size_t e = i + (size_t)x * p.n;
+  return p.knn_ind[e] >= 1 ? knn_weights[e] : 0;
+}
+
+inline bool knn_bound_is_train(const Knn_bound_prefix &p, int i)
+{
+  return p.in_train[i >> 6] >> (i & 63) & 1;
+}
+
+inline void knn_bound_prefix_row(Knn_bound_prefix &p,
+        const double *knn_weights, int i)
+{
+  /* prefix sums of the nonzero weights of row i not in train */
+  int j, m = 0, x;
+  double *out = &p.free[(size_t)i * (p.k + 1)];
+  out[0] = 0;
+  for (j = 0; j < p.k; j++){
+    x = p.sorted[(size_t)i * p.k + j];
+    double v = knn_bound_weight(p, knn_weights, i, x);
+    if (v == 0 || knn_bound_is_train(p, (int)p.knn_ind[i + (size_t)x * p.n]
+            - 1))
+      continue;
+    out[m+1] = out[m] + v;
+    m++;
+  }
+  p.num_free[i] = m;
+}
+
+inline void knn_bound_prefix_init(Knn_bound_prefix &p, const double *knn_ind,
+        const double *knn_weights, int n, int k)
+{
+  /*
+   * knn_ind and knn_weights are (n x k) and column-major with 1-based
+   * indices (0 for padding, otherwise at most n), as
+   * knn_probability_bound_improved.m gets them
+   */
+  size_t i, size = (size_t)n * k;
+  int j;
+  p.n = n;
+  p.k = k;
+  p.knn_ind = knn_ind;
+  p.fingerprint = knn_bound_fingerprint(knn_ind, knn_weights, n, k);
+  p.num_train = 0;
+  p.in_train.assign((n + 63) / 64, 0);
+  p.sorted.resize((size_t)n * k);
+  p.all.assign((size_t)n * (k + 1), 0);
+  p.free.assign((size_t)n * (k + 1), 0);
+  p.num_free.assign(n, 0);
+  p.rows_ptr.assign(n + 1, 0);
+  for (i = 0; i < (size_t)n; i++){
+    int *order = &p.sorted[i * k];
+    for (j = 0; j < k; j++)
+      order[j] = j;
+    std::stable_sort(order, order + k, [&](int a, int b){
+      return knn_bound_weight(p, knn_weights, (int)i, a) >
+              knn_bound_weight(p, knn_weights, (int)i, b);
+    });
+    for (j = 0; j < k; j++)
+      p.all[i * (k + 1) + j + 1] = p.all[i * (k + 1) + j] +
+              knn_bound_weight(p, knn_weights, (int)i, order[j]);
+    knn_bound_prefix_row(p, knn_weights, (int)i);
+  }
+  /* reverse lists: the rows a newly labeled point changes */
+  for (i = 0; i < size; i++){
+    if (knn_ind[i] >= 1 && knn_weights[i] != 0)
+      p.rows_ptr[(int)knn_ind[i]]++;
+  }
+  for (j = 0; j < n; j++)
+    p.rows_ptr[j+1] += p.rows_ptr[j];
+  p.rows.resize(p.rows_ptr[n]);
+  std::vector<int> next(p.rows_ptr.begin(), p.rows_ptr.end() - 1);
+  for (i = 0; i < size; i++){
+    if (knn_ind[i] >= 1 && knn_weights[i] != 0)
+      p.rows[next[(int)knn_ind[i] - 1]++] = (int)(i % n);
+  }
+}
+
+inline void knn_bound_prefix_set_train(Knn_bound_prefix &p,
+        const double *knn_weights, const int *train_ind, int num_train)
+{
+  /* updates the rows of the points that joined or left train */
+  std::vector<uint64_t> in_train((p.n + 63) / 64, 0);
+  std::vector<int> dirty;
+  size_t w;
+  int i, r;
+  for (i = 0; i < num_train; i++)
+    in_train[train_ind[i] >> 6] |= (uint64_t)1 << (train_ind[i] & 63);
+  for (w = 0; w < in_train.size(); w++){
+    uint64_t changed = in_train[w] ^ p.in_train[w];
+    while (changed){
+      int j = (int)(w * 64) + __builtin_ctzll(changed);
+      changed &= changed - 1;
+      for (r = p.rows_ptr[j]; r < p.rows_ptr[j+1]; r++)
+        dirty.push_back(p.rows[r]);
+    }
+  }
+  p.in_train.swap(in_train);
+  p.num_train = num_train;
+  std::sort(dirty.begin(), dirty.end());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+  for (int row : dirty)
+    knn_bound_prefix_row(p, knn_weights, row);
+}
+
+inline double knn_bound_prefix_count(const Knn_bound_prefix &p, int i,
+        int num_positives, int tight_level)
+{
+  /*
+   * weight num_positives new positives can add to point i: the largest
+   * (level 2), the num_positives largest (3), or the num_positives
+   * largest of the neighbors not in train (4)
+   */
+  if (num_positives <= 0 || p.k == 0)
+    return 0;
+  if (tight_level <= 2)
+    return p.all[(size_t)i * (p.k + 1) + 1] * num_positives;
+  if (tight_level == 3)
+    return p.all[(size_t)i * (p.k + 1) + std::min(num_positives, p.k)];
+  return p.free[(size_t)i * (p.k + 1) + std::min(num_positives,
+          p.num_free[i])];
+}
+
+inline void knn_success_count_bounds(const Knn_bound_prefix &p,
+        const int *test_ind, int num_test, int num_positives,
+        int tight_level, double *count)
+{
+  /* count[t] for test_ind[t]; level 1 uses the largest for all points */
+  int t;
+  double max_count = 0;
+  for (t = 0; t < num_test; t++){
+    count[t] = knn_bound_prefix_count(p, test_ind[t], num_positives,
+            tight_level);
+    max_count = std::max(max_count, count[t]);
+  }
+  if (tight_level == 1){
+    for (t = 0; t < num_test; t++)
+      count[t] = max_count;
+  }
+}
+
+inline void knn_probability_bounds(const Knn_weights &w, const double *alpha,
+        const int *train_ind, const double *labels, int num_train,
+        int num_samples, const int *test_ind, int num_test,
+        const double *count, int budget, int num_threads, double *bounds)
+{
+  /*
+   * labels is column-major (num_train x num_samples), label 1 means
+   * target; bounds is column-major (budget x num_samples), each column
+   * in descending order (budget <= num_test)
+   */
+  std::vector<double> successes(w.n, 0), failures(w.n, 0);
+  std::vector<int> varying;
+  int i, j;
+  size_t k;
+
+  for (i = 0; i < num_train; i++){
+    bool positive = labels[i] == 1, same = true;
+    for (j = 1; j < num_samples && same; j++)
+      same = (labels[i + (size_t)j * num_train] == 1) == positive;
+    if (!same){
+      varying.push_back(i);
+      continue;
+    }
+    std::vector<double> &counts = positive ? successes : failures;
+    for (k = w.col_ptr[train_ind[i]]; k < w.col_ptr[train_ind[i] + 1]; k++)
+      counts[w.row_ind[k]] += w.vals[k];
+  }
+
+  parallel_for(num_samples, std::min(num_threads, num_samples),
+          [&](int s, int){
+    std::vector<double> pos(successes), neg(failures), probs(num_test);
+    const double *sample = labels + (size_t)s * num_train;
+    int t;
+    size_t kk;
+    for (int v : varying){
+      std::vector<double> &counts = sample[v] == 1 ? pos : neg;
+      for (kk = w.col_ptr[train_ind[v]]; kk < w.col_ptr[train_ind[v] + 1];
+              kk++)
+        counts[w.row_ind[kk]] += w.vals[kk];
+    }
+    for (t = 0; t < num_test; t++){
+      int x = test_ind[t];
+      double a = alpha[0] + pos[x] + count[t];
+      probs[t] = a / (a + alpha[1] + neg[x]);
+    }
+    std::partial_sort(probs.begin(), probs.begin() + budget, probs.end(),
+            std::greater<double>());
+    std::copy(probs.begin(), probs.begin() + budget,
+            bounds + (size_t)s * budget);
+  });
+}
+
+#endif
@@ -42,7 +42,7 @@
 
 % Copyright (c) 2011--2014 Roman Garnett.
 
-function bound = knn_probability_bound_improved(~, train_ind, observed_labels, ...
+function bound = knn_probability_bound_improved(problem, train_ind, observed_labels, ...
   test_ind, num_positives, budget, tight_level, weights, knn_ind, knn_weights, alpha)
 % add two more parameters than the 'knn_probability_bound':
 %    budget, tight_level
@@ -53,8 +53,34 @@ function bound = knn_probability_bound_improved(~, train_ind, observed_labels, .
 %    3: use each test_point's own top 'num_positives' weights
 % Note tight_level 3 should provide the tightest bound, but also more
 % expansive to compute
+%
+% observed_labels may have one column per label sample (all for the same
+% train_ind); bound then has one column per sample.
   if nargin < 6 || ~exist('budget', 'var'), budget = 1; end
   if ~exist('tight_level', 'var'), tight_level = 3; end
+
+  % all samples in one threaded call if compiled
+  % (see probability_bounds/knn_probability_bounds.cpp)
+  if exist('knn_probability_bounds', 'file') == 3
+    if isfield(problem, 'num_threads')
+      num_threads = problem.num_threads;
+    else
+      num_threads = [];
+    end
+    bound = knn_probability_bounds(weights, knn_ind, knn_weights, alpha, ...
+      train_ind, observed_labels, test_ind, num_positives, budget, ...
+      tight_level, num_threads);
+    return;
+  end
+  if size(observed_labels, 2) > 1
+    bound = [];
+    for j = 1:size(observed_labels, 2)
+      bound = [bound, knn_probability_bound_improved(problem, train_ind, ...
+        observed_labels(:, j), test_ind, num_positives, budget, ...
+        tight_level, weights, knn_ind, knn_weights, alpha)]; %#ok<AGROW>
+    end
+    return;
+  end
   % transform observed_labels to handle multi-class
   positive_ind = (observed_labels == 1);
   successes = sum(weights(test_ind, train_ind( positive_ind)), 2);
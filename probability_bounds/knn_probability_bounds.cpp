@@ -0,0 +1,96 @@
+#include "mex.h"
+#include <algorithm>
+#include <vector>
+#include "knn_probability_bound.h"
+#include "../models/knn_mex.h"
+
+/*
+ * bounds = knn_probability_bounds(weights, knn_ind, knn_weights, alpha, ...
+ *     train_ind, observed_labels, test_ind, num_positives, budget, ...
+ *     tight_level, num_threads)
+ *
+ * knn_probability_bound_improved for every column of observed_labels
+ * (num_train x num_samples) in one call, threaded over the columns (see
+ * knn_probability_bound.h). Column j of bounds holds the top "budget"
+ * bounds of test_ind under labels observed_labels(:, j), in descending
+ * order (budget <= 1: just the largest). num_threads defaults to all
+ * cores. Entries of knn_ind are 1-based point indices or 0 for padding.
+ *
+ * The sorted prefix sums of knn_weights are kept between calls, as long
+ * as knn_ind is the same array (checked by a fingerprint of its
+ * entries), and updated for the points that joined or left train_ind.
+ */
+
+#define WEIGHTS_ARG       prhs[0]
+#define KNN_IND_ARG       prhs[1]
+#define KNN_WEIGHTS_ARG   prhs[2]
+#define ALPHA_ARG         prhs[3]
+#define TRAIN_IND_ARG     prhs[4]
+#define LABELS_ARG        prhs[5]
+#define TEST_IND_ARG      prhs[6]
+#define NUM_POSITIVES_ARG prhs[7]
+#define BUDGET_ARG        prhs[8]
+#define TIGHT_LEVEL_ARG   prhs[9]
+#define NUM_THREADS_ARG   prhs[10]
+
+#define BOUNDS_ARG        plhs[0]
+
+static Knn_bound_prefix prefix;
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  const double *knn_ind, *knn_weights;
+  int n, k, num_train, num_samples, num_test, budget, num_threads;
+
+  if (nrhs < 10)
+    mexErrMsgIdAndTxt("knn_probability_bounds:nargin",
+            "at least 10 inputs required");
+
+  /* get input */
+  Knn_weights weights = knn_weights_from_mx(WEIGHTS_ARG,
+          "knn_probability_bounds:weights");
+  std::vector<int> train = indices_from_mx(TRAIN_IND_ARG);
+  std::vector<int> test = indices_from_mx(TEST_IND_ARG);
+  n = (int)mxGetM(KNN_IND_ARG);
+  k = (int)mxGetN(KNN_IND_ARG);
+  if (n != weights.n || mxGetM(KNN_WEIGHTS_ARG) != mxGetM(KNN_IND_ARG) ||
+          mxGetN(KNN_WEIGHTS_ARG) != mxGetN(KNN_IND_ARG))
+    mexErrMsgIdAndTxt("knn_probability_bounds:knn",
+            "knn_ind and knn_weights must be (num_points x k)");
+  knn_ind = mxGetPr(KNN_IND_ARG);
+  knn_weights = mxGetPr(KNN_WEIGHTS_ARG);
+  for (size_t e = 0; e < (size_t)n * k; e++){
+    if (!(knn_ind[e] >= 0 && knn_ind[e] <= n) ||
+            knn_ind[e] != (double)(int)knn_ind[e])
+      mexErrMsgIdAndTxt("knn_probability_bounds:knn",
+              "knn_ind must hold point indices (or 0 for padding)");
+  }
+  num_train = (int)train.size();
+  num_test = (int)test.size();
+  num_samples = num_train > 0 ?
+          (int)(mxGetNumberOfElements(LABELS_ARG) / num_train) : 1;
+  budget = std::max(1, (int)mxGetScalar(BUDGET_ARG));
+  if (budget > num_test)
+    mexErrMsgIdAndTxt("knn_probability_bounds:budget",
+            "budget exceeds the number of test points");
+  num_threads = (nrhs > 10 && !mxIsEmpty(NUM_THREADS_ARG)) ?
+          (int)(mxGetScalar(NUM_THREADS_ARG)) : default_num_threads();
+
+  /* the sorted prefix sums persist; only train changes are applied */
+  if (prefix.knn_ind != knn_ind || prefix.n != n || prefix.k != k ||
+          prefix.fingerprint != knn_bound_fingerprint(knn_ind, knn_weights,
+          n, k))
+    knn_bound_prefix_init(prefix, knn_ind, knn_weights, n, k);
+  knn_bound_prefix_set_train(prefix, knn_weights, train.data(), num_train);
+  std::vector<double> count(num_test);
+  knn_success_count_bounds(prefix, test.data(), num_test,
+          (int)mxGetScalar(NUM_POSITIVES_ARG),
+          (int)mxGetScalar(TIGHT_LEVEL_ARG), count.data());
+
+  BOUNDS_ARG = mxCreateDoubleMatrix(budget, num_samples, mxREAL);
+  knn_probability_bounds(weights, mxGetPr(ALPHA_ARG), train.data(),
+          num_train > 0 ? mxGetPr(LABELS_ARG) : NULL, num_train,
+          num_samples, test.data(), num_test, count.data(), budget,
+          std::max(num_threads, 1), mxGetPr(BOUNDS_ARG));
+}
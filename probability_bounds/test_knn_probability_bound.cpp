@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "knn_probability_bound.h"
+
+/*
+ * Checks the success count bounds of a Knn_bound_prefix against a direct
+ * computation from the rows, on random neighbor lists where some rows
+ * are padded with index 0 (as load_knn_graph leaves short rows), while
+ * train grows and shrinks. Returns 1 on failure.
+ */
+
+static double direct_count(const std::vector<double> &knn_ind,
+        const std::vector<double> &knn_weights, const std::vector<char> &train,
+        int n, int k, int i, int num_positives, int tight_level)
+{
+  /* the top weights of row i, leaving out padding (and train at level 4) */
+  std::vector<double> v;
+  double sum = 0;
+  int j;
+  if (num_positives <= 0)
+    return 0;
+  for (j = 0; j < k; j++){
+    int x = (int)knn_ind[i + (size_t)j * n];
+    double weight = knn_weights[i + (size_t)j * n];
+    if (x == 0 || weight == 0) continue;
+    if (tight_level == 4 && train[x - 1]) continue;
+    v.push_back(weight);
+  }
+  std::sort(v.begin(), v.end(), std::greater<double>());
+  if (tight_level <= 2)
+    return v.empty() ? 0 : v[0] * num_positives;
+  for (j = 0; j < num_positives && j < (int)v.size(); j++)
+    sum += v[j];
+  return sum;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  int n = 200, k = 6, errors = 0, step, i, j, level, num_positives;
+  std::vector<double> knn_ind((size_t)n * k), knn_weights((size_t)n * k);
+  std::vector<char> train(n, 0);
+  Knn_bound_prefix p;
+
+  for (i = 0; i < n; i++){
+    /* every fifth row has only some neighbors, padded with 0 */
+    int length = i % 5 == 0 ? (int)(gen() % (k + 1)) : k;
+    for (j = 0; j < k; j++){
+      size_t e = i + (size_t)j * n;
+      knn_ind[e] = j < length ? (double)(gen() % n + 1) : 0;
+      knn_weights[e] = j < length ? uniform(gen) : 0;
+    }
+  }
+  knn_bound_prefix_init(p, knn_ind.data(), knn_weights.data(), n, k);
+
+  for (step = 0; step < 50; step++){
+    std::vector<int> train_ind;
+    /* a few points join or leave train */
+    for (i = 0; i < 10; i++){
+      int x = (int)(gen() % n);
+      train[x] = !train[x];
+    }
+    for (i = 0; i < n; i++){
+      if (train[i])
+        train_ind.push_back(i);
+    }
+    knn_bound_prefix_set_train(p, knn_weights.data(), train_ind.data(),
+            (int)train_ind.size());
+    for (level = 2; level <= 4; level++){
+      for (num_positives = 0; num_positives <= k + 1; num_positives++){
+        for (i = 0; i < n; i++){
+          double got = knn_bound_prefix_count(p, i, num_positives, level);
+          double want = direct_count(knn_ind, knn_weights, train, n, k, i,
+                  num_positives, level);
+          if (fabs(got - want) > 1e-12){
+            if (errors < 10)
+              printf("step %d level %d num_positives %d row %d: %g, "
+                      "direct %g\n", step, level, num_positives, i, got,
+                      want);
+            errors++;
+          }
+        }
+      }
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
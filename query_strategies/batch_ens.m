@@ -29,6 +29,12 @@
 %     for i = 1..b, x_i = argmax_{x} f(S_{i-1} U {x}) - f(S_{i-1})
 %   If f(S) is really submodular, this greedy solution would have nice
 %   guarantee (Nemhauser et al. 1978).
+%   With problem.lazy_greedy, the greedy steps are lazy (Minoux 1978):
+%   the score of a point in an earlier slot bounds its score in later
+%   ones, so each slot evaluates points in descending order of these
+%   stale bounds and stops once the best fresh score beats the next
+%   bound. problem.test_lazy checks every slot against the full scan
+%   and reports how often the choices differ.
 %   (2) for large batch size, we approximate the expected future utility
 %   part by Monte Carlo simulation:
 %     We use a small number of samples from the posterior of y_S given D
@@ -120,7 +126,19 @@ all_probs        = repmat(probs, 1, max_num_samples);
 weights(train_ind, :) = 0;
 test_pruning = isfield(problem, 'test_pruning') && problem.test_pruning;
 test_memo = isfield(problem, 'test_memo') && problem.test_memo;
+test_lazy = isfield(problem, 'test_lazy') && problem.test_lazy;
+if isfield(problem, 'lazy_greedy') && problem.lazy_greedy
+  stale_bound = inf(num_points, 1);  % scores of earlier slots
+else
+  stale_bound = [];
+end
+num_diverged = 0;
 save_score = isfield(problem, 'save_score') && problem.save_score;
+% update the probabilities under fictional labels natively if compiled
+% and model is the k-NN model (problem.use_native_ens, see
+% models/knn_fictional_probabilities.cpp)
+use_native = isfield(problem, 'use_native_ens') && problem.use_native_ens && ...
+  exist('knn_fictional_probabilities', 'file') == 3;
 
 if save_score
   all_estimates = zeros(num_points, batch_size, 3);
@@ -132,14 +150,28 @@ for i = 1:batch_size
 
   
   tt = tic;
-  [chosen_ind, cand_ind, estimates, which_ind, upper_bound_of_score] = ...
-    batch_ens_select_next(...
+  [chosen_ind, cand_ind, estimates, which_ind, upper_bound_of_score, ...
+    stale_bound] = batch_ens_select_next(...
     problem, train_and_selected_ind, observed_labels, test_ind, test_probs, ...
     model, weights, ...
     i, samples, sample_weights, all_probs, ...
-    num_samples, next_batch_size, probability_bound);
+    num_samples, next_batch_size, probability_bound, stale_bound);
   time = toc(tt);
   
+  if test_lazy && ~isempty(stale_bound)
+    tt0 = tic;
+    chosen_ind0 = batch_ens_select_next(...
+      problem, train_and_selected_ind, observed_labels, test_ind, test_probs, ...
+      model, weights, ...
+      i, samples, sample_weights, all_probs, ...
+      num_samples, next_batch_size, probability_bound);
+    time0 = toc(tt0);
+    chose_same = (chosen_ind == chosen_ind0);
+    num_diverged = num_diverged + ~chose_same;
+    fprintf('lazy greedy: %.2f vs. %.2f (full scan), chose same: %d, diverged %d / %d\n', ...
+      time, time0, chose_same, num_diverged, i)
+  end
+  
   if test_pruning
     problem.do_pruning = 0;
     tt0 = tic;
@@ -203,6 +235,15 @@ for i = 1:batch_size
   %% sample for this chosen point conditioned on existing samples
   if num_samples * 2 <= max_num_samples  % double the samples
     sample_weights0 = sample_weights;
+    if use_native
+      % all 2*num_samples updates at once, column 2*j-2+fake_label
+      parent = kron(1:num_samples, ones(1, num_classes));
+      fake_labels = [samples(1:(i-1), parent); ...
+        repmat(1:num_classes, 1, num_samples)];
+      fictional_probs = knn_fictional_probabilities(weights, ...
+        problem.alpha, train_ind, observed_labels, batch_ind(1:i), ...
+        fake_labels, updating_ind);
+    end
     for j = num_samples:-1:1
       % probability of positive/negative
       both_probs = [all_probs(chosen_ind, j); ...
@@ -216,13 +257,17 @@ for i = 1:batch_size
         % use chain rule to update the weights of the samples
         sample_weights(sample_idx) = sample_weights0(j) * both_probs(fake_label);
         
-        observed_and_sampled = [observed_labels; ...  % points already observed
-          samples(1:(i-1), j); ...  % points already in the batch
-          fake_label];  % newly added point
-        
-        updated_probs = model(problem, ...
-          [train_and_selected_ind; chosen_ind], ...
-          observed_and_sampled, updating_ind);
+        if use_native
+          updated_probs = fictional_probs(:, sample_idx);
+        else
+          observed_and_sampled = [observed_labels; ...  % points already observed
+            samples(1:(i-1), j); ...  % points already in the batch
+            fake_label];  % newly added point
+          
+          updated_probs = model(problem, ...
+            [train_and_selected_ind; chosen_ind], ...
+            observed_and_sampled, updating_ind);
+        end
         all_probs(:, sample_idx) = all_probs(:,j);
         all_probs(updating_ind, sample_idx) = updated_probs(:,1);
       end
@@ -247,17 +292,26 @@ for i = 1:batch_size
       fake_label = randsample(num_classes, 1, true, ...
         [all_probs(chosen_ind, j); 1 - all_probs(chosen_ind, j)]);
       
-      observed_and_sampled = [observed_labels; ...  % points already observed
-        samples(1:(i-1), j); ...  % points already in the batch
-        fake_label];  % newly added point
-      updated_probs = model(problem, ...
-        [train_and_selected_ind; chosen_ind], ...
-        observed_and_sampled, updating_ind);
-      
-      all_probs(updating_ind, j) = updated_probs(:,1);
+      if ~use_native
+        observed_and_sampled = [observed_labels; ...  % points already observed
+          samples(1:(i-1), j); ...  % points already in the batch
+          fake_label];  % newly added point
+        updated_probs = model(problem, ...
+          [train_and_selected_ind; chosen_ind], ...
+          observed_and_sampled, updating_ind);
+        
+        all_probs(updating_ind, j) = updated_probs(:,1);
+      end
       
       samples(i, j) = fake_label;
     end
+    if use_native
+      % samples that share their first labels share the pushed updates
+      all_probs(updating_ind, 1:num_samples) = ...
+        knn_fictional_probabilities(weights, problem.alpha, train_ind, ...
+        observed_labels, batch_ind(1:i), samples(1:i, 1:num_samples), ...
+        updating_ind);
+    end
   end
 end
 if save_score
@@ -0,0 +1,134 @@
+#ifndef BATCH_ENS_CACHE_H
+#define BATCH_ENS_CACHE_H
+
+/*
+ * Memo of batch-ENS work that is shared between label samples and kept
+ * across the greedy iterations of batch_ens.m (and across the repeated
+ * calls of its test_pruning / test_memo checks).
+ *
+ * Two kinds of entries, both keyed by a 64-bit hash:
+ *
+ *   - the fictional probabilities q of the points a candidate influences
+ *     (both labels, sorted), keyed by the train set, the candidate and
+ *     the labels of only those batch points that influence one of these
+ *     points. Label samples that agree on these few labels share one
+ *     entry, and so do later greedy iterations as long as the new batch
+ *     points are far from the candidate.
+ *   - the merged future utility of a candidate under one label sample,
+ *     keyed by the full sample and the budget, for exact repeats.
+ *
+ * Entries are evicted least recently used first once their estimated
+ * size exceeds the byte budget. The worker threads share the cache,
+ * split by key into shards with a mutex each; lookups copy the values
+ * out.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* bookkeeping bytes per entry (list and hash nodes) on top of the values */
+const size_t BATCH_ENS_CACHE_OVERHEAD = 96;
+const int BATCH_ENS_CACHE_SHARDS = 16;  /* independently locked parts */
+
+struct Batch_ens_cache_shard{
+  typedef std::pair<uint64_t, std::vector<double> > Entry;
+  size_t max_bytes = 0;
+  size_t bytes = 0;
+  std::list<Entry> entries;          /* most recently used first */
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> map;
+  std::mutex mutex;
+};
+
+struct Batch_ens_cache{
+  Batch_ens_cache_shard shards[BATCH_ENS_CACHE_SHARDS];
+  std::atomic<size_t> hits{0}, misses{0};
+};
+
+inline uint64_t batch_ens_hash(uint64_t hash, uint64_t x)
+{
+  /* combine x into hash (splitmix64 finalizer) */
+  hash ^= x + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+inline uint64_t batch_ens_hash_double(uint64_t hash, double x)
+{
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return batch_ens_hash(hash, bits);
+}
+
+inline size_t batch_ens_cache_entry_bytes(const std::vector<double> &v)
+{
+  return BATCH_ENS_CACHE_OVERHEAD + v.size() * sizeof(double);
+}
+
+inline void batch_ens_cache_evict(Batch_ens_cache_shard &shard, size_t bytes)
+{
+  /* drop least recently used entries until bytes more fit */
+  while (shard.bytes + bytes > shard.max_bytes && !shard.entries.empty()){
+    shard.bytes -= batch_ens_cache_entry_bytes(shard.entries.back().second);
+    shard.map.erase(shard.entries.back().first);
+    shard.entries.pop_back();
+  }
+}
+
+inline void batch_ens_cache_resize(Batch_ens_cache &cache, size_t max_bytes)
+{
+  /* set the byte budget (0 disables), evicting what no longer fits */
+  for (int i = 0; i < BATCH_ENS_CACHE_SHARDS; i++){
+    Batch_ens_cache_shard &shard = cache.shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.max_bytes = max_bytes / BATCH_ENS_CACHE_SHARDS;
+    batch_ens_cache_evict(shard, 0);
+  }
+}
+
+inline Batch_ens_cache_shard& batch_ens_cache_shard(Batch_ens_cache &cache,
+        uint64_t key)
+{
+  return cache.shards[key >> 60 & (BATCH_ENS_CACHE_SHARDS - 1)];
+}
+
+inline bool batch_ens_cache_find(Batch_ens_cache &cache, uint64_t key,
+        std::vector<double> &values)
+{
+  Batch_ens_cache_shard &shard = batch_ens_cache_shard(cache, key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.map.find(key);
+  if (it == shard.map.end()){
+    cache.misses++;
+    return false;
+  }
+  cache.hits++;
+  shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+  values = it->second->second;
+  return true;
+}
+
+inline void batch_ens_cache_insert(Batch_ens_cache &cache, uint64_t key,
+        const std::vector<double> &values)
+{
+  Batch_ens_cache_shard &shard = batch_ens_cache_shard(cache, key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  size_t size = batch_ens_cache_entry_bytes(values);
+  if (size > shard.max_bytes || shard.map.count(key))
+    return;
+  batch_ens_cache_evict(shard, size);
+  shard.entries.push_front(Batch_ens_cache_shard::Entry(key, values));
+  shard.map[key] = shard.entries.begin();
+  shard.bytes += size;
+}
+
+#endif
@@ -0,0 +1,603 @@
+#ifndef BATCH_ENS_SCORE_H
+#define BATCH_ENS_SCORE_H
+
+/*
+ * Multithreaded candidate scoring for batch_ens_select_next.m.
+ *
+ * Each of the num_samples fictional label samples of the points already
+ * in the batch defines its own k-NN posterior (the columns of all_probs
+ * in batch_ens.m). The score of a candidate x is
+ *
+ *   Pr(y=1|x,D) + sum_j w_j (future_utility_j(x) - current_utility_j)
+ *
+ * where future_utility_j is the ENS future utility under sample j (see
+ * ens_score.h) and w_j the normalized sample weights.
+ *
+ * A sample only differs from the real observations (the base posterior)
+ * at the points the batch influences, the union of the columns of the
+ * batch points, which all samples share. So a sample is stored as
+ *
+ *   - the counts of these delta points, a sparse delta against the base
+ *     counts (O(k num_selected) instead of O(n));
+ *   - its frontier: the first budget + (largest column + 1) unlabeled
+ *     points in descending order of probability, with prefix sums.
+ *
+ * A future utility only needs the top "budget" values after removing
+ * the candidate and the points it influences, so the frontier answers
+ * every merge exactly as the whole sorted order would. The frontiers
+ * overlay the sorted delta points of each sample on one shared base
+ * order, found by a single sharded pass over the base probabilities
+ * in shards of BATCH_ENS_SHARD points (each thread keeps a bounded heap
+ * of the best points), so no sample sorts all points. Ties are broken
+ * by index, as the stable sort of ens_context_init does.
+ *
+ * Worker threads claim candidates in descending order of their upper
+ * bounds and share the best score found so far; a worker skips the
+ * candidate it claimed if its bound does not exceed that score (later
+ * ones are skipped as quickly, their bounds being even smaller). Every
+ * claimed candidate is checked on its own, so a candidate whose bound
+ * beats the final best score is always scored, however the threads are
+ * scheduled; ties are resolved by the position in test_ind, as in the
+ * serial loop.
+ *
+ * With a Batch_ens_cache (batch_ens_cache.h), the fictional
+ * probabilities and future utilities are looked up before they are
+ * computed; the scores are the same either way.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "../score_functions/ens_score.h"
+#include "batch_ens_cache.h"
+#include "../native/parallel_for.h"
+
+const int BATCH_ENS_SHARD = 1 << 14;  /* points per work item */
+const int BATCH_ENS_WEIGHT_PROBES = 64;  /* entries of the weights hashed
+                                            into the cache version */
+
+struct Batch_ens_sample{
+  std::vector<double> successes;     /* counts of Batch_ens_samples.delta */
+  std::vector<double> failures;
+  std::vector<int> top_ind;          /* frontier, descending probability */
+  std::vector<double> sorted;        /* their probabilities */
+  std::vector<std::pair<int, int> > position;  /* (point, position) */
+  Top_sum_index index;
+  double current_utility = 0;        /* top "budget" sum */
+};
+
+struct Batch_ens_samples{
+  const Knn_weights *weights = NULL;
+  const Knn_posterior *base = NULL;
+  std::vector<char> observed;        /* base observations and the batch */
+  std::vector<int> delta;            /* points the batch influences */
+  std::vector<int> delta_index;      /* position in delta, -1 if none */
+  std::vector<Batch_ens_sample> samples;
+
+  /* cache keys, set by batch_ens_samples_keys */
+  uint64_t train_version = 0;        /* hash of the train set and alpha */
+  std::vector<int> selected;
+  std::vector<char> labels;          /* num_selected x num_samples */
+  std::vector<uint64_t> history;     /* hash of each sample */
+  std::vector<uint64_t> influenced_by;  /* bit b: batch point b (b < 64) */
+};
+
+struct Batch_ens_workspace{
+  std::vector<int> removed;          /* frontier positions, ascending */
+  std::vector<double> q;
+  std::vector<double> values;        /* cache entries */
+};
+
+inline bool batch_ens_before(double p, int i, double q, int j)
+{
+  /* order of the frontiers: probability descending, then index */
+  return p > q || (p == q && i < j);
+}
+
+inline double batch_ens_count(const Batch_ens_samples &s, int j, int i,
+        bool positive)
+{
+  /* successes (failures) of point i under sample j */
+  int d = s.delta_index[i];
+  if (d >= 0)
+    return positive ? s.samples[j].successes[d] : s.samples[j].failures[d];
+  return positive ? s.base->successes[i] : s.base->failures[i];
+}
+
+inline double batch_ens_probability(const Batch_ens_samples &s, int j,
+        int i)
+{
+  /* as knn_probability under sample j */
+  double a = s.base->alpha_success + batch_ens_count(s, j, i, true);
+  return a / (a + s.base->alpha_failure + batch_ens_count(s, j, i, false));
+}
+
+inline void batch_ens_base_top(const Batch_ens_samples &s, int size,
+        int num_threads, std::vector<int> &top)
+{
+  /*
+   * the first "size" points of the base posterior that are unlabeled in
+   * every sample, in frontier order, from one pass over all points
+   */
+  typedef std::pair<double, int> Entry;
+  const Knn_posterior &post = *s.base;
+  int n = s.weights->n;
+  int num_shards = (n + BATCH_ENS_SHARD - 1) / BATCH_ENS_SHARD, t;
+  /* heap top is the worst kept entry */
+  auto before = [](const Entry &a, const Entry &b){
+    return batch_ens_before(a.first, a.second, b.first, b.second);
+  };
+  if (num_threads > num_shards)
+    num_threads = num_shards;
+  if (num_threads < 1)
+    num_threads = 1;
+  std::vector<std::vector<Entry> > heaps(num_threads);
+
+  parallel_for(num_shards, num_threads, [&](int shard, int thread){
+    std::vector<Entry> &heap = heaps[thread];
+    int i, last = std::min(n, (shard + 1) * BATCH_ENS_SHARD);
+    for (i = shard * BATCH_ENS_SHARD; i < last; i++){
+      if (s.observed[i]) continue;
+      Entry e(knn_probability(post, i), i);
+      if ((int)heap.size() < size){
+        heap.push_back(e);
+        std::push_heap(heap.begin(), heap.end(), before);
+      }
+      else if (size > 0 && before(e, heap.front())){
+        std::pop_heap(heap.begin(), heap.end(), before);
+        heap.back() = e;
+        std::push_heap(heap.begin(), heap.end(), before);
+      }
+    }
+  });
+
+  std::vector<Entry> all;
+  for (t = 0; t < num_threads; t++)
+    all.insert(all.end(), heaps[t].begin(), heaps[t].end());
+  std::sort(all.begin(), all.end(), before);
+  if ((int)all.size() > size)
+    all.resize(size);
+  top.resize(all.size());
+  for (t = 0; t < (int)all.size(); t++)
+    top[t] = all[t].second;
+}
+
+inline void batch_ens_sample_frontier(const Batch_ens_samples &s,
+        Batch_ens_sample &sample, const std::vector<int> &base_top,
+        int frontier, int budget)
+{
+  /* base_top without the delta points, merged with them */
+  const Knn_posterior &base = *s.base;
+  std::vector<std::pair<double, int> > moved;
+  size_t d, b = 0, t;
+
+  for (d = 0; d < s.delta.size(); d++){
+    int x = s.delta[d];
+    if (s.observed[x]) continue;
+    double a = base.alpha_success + sample.successes[d];
+    moved.push_back(std::make_pair(a / (a + base.alpha_failure +
+            sample.failures[d]), x));
+  }
+  std::sort(moved.begin(), moved.end(), [](const std::pair<double, int> &x,
+          const std::pair<double, int> &y){
+    return batch_ens_before(x.first, x.second, y.first, y.second);
+  });
+
+  sample.top_ind.clear();
+  sample.sorted.clear();
+  for (t = 0; t < base_top.size() && (int)sample.top_ind.size() < frontier;
+          t++){
+    int x = base_top[t];
+    if (s.delta_index[x] >= 0) continue;
+    double p = knn_probability(base, x);
+    for (; b < moved.size() && (int)sample.top_ind.size() < frontier &&
+            batch_ens_before(moved[b].first, moved[b].second, p, x); b++){
+      sample.top_ind.push_back(moved[b].second);
+      sample.sorted.push_back(moved[b].first);
+    }
+    if ((int)sample.top_ind.size() < frontier){
+      sample.top_ind.push_back(x);
+      sample.sorted.push_back(p);
+    }
+  }
+  for (; b < moved.size() && (int)sample.top_ind.size() < frontier; b++){
+    sample.top_ind.push_back(moved[b].second);
+    sample.sorted.push_back(moved[b].first);
+  }
+
+  sample.position.resize(sample.top_ind.size());
+  for (t = 0; t < sample.top_ind.size(); t++)
+    sample.position[t] = std::make_pair(sample.top_ind[t], (int)t);
+  std::sort(sample.position.begin(), sample.position.end());
+  top_sum_index_init(sample.index, sample.sorted.data(),
+          (int)sample.sorted.size(), NULL);
+  sample.current_utility = 0;
+  for (t = 0; (int)t < budget && t < sample.sorted.size(); t++)
+    sample.current_utility += sample.sorted[t];
+}
+
+inline void batch_ens_samples_init(Batch_ens_samples &s,
+        const Knn_weights &w, const Knn_posterior &base,
+        const int *selected_ind, int num_selected,
+        const double *samples, int num_samples, int budget, int num_threads)
+{
+  /*
+   * samples is column-major (num_selected x num_samples) with the
+   * fictional labels of selected_ind (0-based) under each sample; base
+   * must outlive s
+   */
+  int i, frontier = 0;
+  size_t k;
+
+  s.weights = &w;
+  s.base = &base;
+  s.observed = base.observed;
+  s.delta.clear();
+  for (i = 0; i < num_selected; i++){
+    s.observed[selected_ind[i]] = 1;
+    for (k = w.col_ptr[selected_ind[i]]; k < w.col_ptr[selected_ind[i]+1];
+            k++)
+      s.delta.push_back((int)w.row_ind[k]);
+  }
+  std::sort(s.delta.begin(), s.delta.end());
+  s.delta.erase(std::unique(s.delta.begin(), s.delta.end()), s.delta.end());
+  s.delta_index.assign(w.n, -1);
+  for (k = 0; k < s.delta.size(); k++)
+    s.delta_index[s.delta[k]] = (int)k;
+
+  /* room for the removed points of any candidate */
+  for (i = 0; i < w.n; i++)
+    frontier = std::max(frontier, (int)(w.col_ptr[i+1] - w.col_ptr[i]));
+  frontier += budget + 1;
+
+  /* the shared order, long enough to stand in for the delta points */
+  std::vector<int> base_top;
+  batch_ens_base_top(s, frontier + (int)s.delta.size(), num_threads,
+          base_top);
+
+  s.samples.assign(num_samples, Batch_ens_sample());
+  parallel_for(num_samples, num_threads, [&](int j, int){
+    Batch_ens_sample &sample = s.samples[j];
+    const double *labels = samples + (size_t)j * num_selected;
+    size_t kk, d;
+    int t;
+
+    sample.successes.resize(s.delta.size());
+    sample.failures.resize(s.delta.size());
+    for (d = 0; d < s.delta.size(); d++){
+      sample.successes[d] = base.successes[s.delta[d]];
+      sample.failures[d] = base.failures[s.delta[d]];
+    }
+    /* in batch order, so the counts round as knn_posterior_add's */
+    for (t = 0; t < num_selected; t++){
+      std::vector<double> &counts = labels[t] == 1 ? sample.successes :
+              sample.failures;
+      for (kk = w.col_ptr[selected_ind[t]];
+              kk < w.col_ptr[selected_ind[t]+1]; kk++)
+        counts[s.delta_index[w.row_ind[kk]]] += w.vals[kk];
+    }
+    batch_ens_sample_frontier(s, sample, base_top, frontier, budget);
+  });
+}
+
+inline int batch_ens_removed_points(const Batch_ens_samples &s, int j,
+        Batch_ens_workspace &ws, int candidate)
+{
+  /*
+   * frontier positions (ascending) of the candidate and the points it
+   * influences under sample j in ws.removed; returns the number of
+   * influenced points
+   */
+  const Knn_weights &w = *s.weights;
+  const std::vector<std::pair<int, int> > &position =
+          s.samples[j].position;
+  int nq = 0;
+  size_t k;
+
+  ws.removed.clear();
+  for (k = w.col_ptr[candidate]; k <= w.col_ptr[candidate+1]; k++){
+    /* the candidate itself last */
+    int i = k < w.col_ptr[candidate+1] ? (int)w.row_ind[k] : candidate;
+    if (k < w.col_ptr[candidate+1]){
+      if (s.observed[i] || i == candidate) continue;
+      nq++;
+    }
+    auto it = std::lower_bound(position.begin(), position.end(),
+            std::make_pair(i, -1));
+    if (it != position.end() && it->first == i)
+      ws.removed.push_back(it->second);
+  }
+  std::sort(ws.removed.begin(), ws.removed.end());
+  return nq;
+}
+
+inline void batch_ens_fake_probabilities(const Batch_ens_samples &s, int j,
+        int candidate, bool positive, double *q)
+{
+  /* ens_fake_probabilities under sample j */
+  const Knn_weights &w = *s.weights;
+  int nq = 0;
+  size_t k;
+
+  for (k = w.col_ptr[candidate]; k < w.col_ptr[candidate+1]; k++){
+    int i = (int)w.row_ind[k];
+    if (s.observed[i] || i == candidate) continue;
+    /* rounded as knn_fake_probability */
+    double a = s.base->alpha_success + batch_ens_count(s, j, i, true);
+    double b = s.base->alpha_failure + batch_ens_count(s, j, i, false);
+    if (positive)
+      a += w.vals[k];
+    else
+      b += w.vals[k];
+    q[nq++] = a / (a + b);
+  }
+  std::sort(q, q + nq, std::greater<double>());
+}
+
+inline double batch_ens_merge(const Batch_ens_samples &s, int j,
+        const Batch_ens_workspace &ws, const double *q, int nq, int budget)
+{
+  /* merge_top_sum under sample j */
+  return top_sum_index_merged_sum(s.samples[j].index, ws.removed.data(),
+          (int)ws.removed.size(), q, nq, budget, NULL);
+}
+
+inline double batch_ens_future_utility(const Batch_ens_samples &s, int j,
+        Batch_ens_workspace &ws, int candidate, int budget)
+{
+  /* ens_future_utility under sample j */
+  double prob = batch_ens_probability(s, j, candidate);
+  double fake_utilities[2];
+  int nq, label;
+
+  nq = batch_ens_removed_points(s, j, ws, candidate);
+  if (nq == 0)
+    return batch_ens_merge(s, j, ws, NULL, 0, budget);
+  ws.q.resize(nq);
+  for (label = 0; label < 2; label++){
+    batch_ens_fake_probabilities(s, j, candidate, label == 0, ws.q.data());
+    fake_utilities[label] = batch_ens_merge(s, j, ws, ws.q.data(), nq,
+            budget);
+  }
+  return prob * fake_utilities[0] + (1 - prob) * fake_utilities[1];
+}
+
+inline uint64_t batch_ens_weights_version(const Knn_weights &w,
+        uint64_t hash)
+{
+  /*
+   * fold the weights into a cache version: the addresses of their
+   * arrays, their size and BATCH_ENS_WEIGHT_PROBES offsets and nonzeros
+   * spread over them, so that another graph on the same points (another
+   * k or similarity) never shares keys with this one
+   */
+  size_t nnz = w.col_ptr[w.n], k, stride;
+  int j, column_stride;
+  hash = batch_ens_hash(hash, (uint64_t)(uintptr_t)w.col_ptr);
+  hash = batch_ens_hash(hash, (uint64_t)(uintptr_t)w.row_ind);
+  hash = batch_ens_hash(hash, (uint64_t)(uintptr_t)w.vals);
+  hash = batch_ens_hash(batch_ens_hash(hash, w.n), nnz);
+  column_stride = w.n / BATCH_ENS_WEIGHT_PROBES + 1;
+  for (j = 0; j <= w.n; j += column_stride)
+    hash = batch_ens_hash(hash, w.col_ptr[j]);
+  stride = nnz / BATCH_ENS_WEIGHT_PROBES + 1;
+  for (k = 0; k < nnz; k += stride)
+    hash = batch_ens_hash_double(batch_ens_hash(hash, w.row_ind[k]),
+            w.vals[k]);
+  return hash;
+}
+
+inline void batch_ens_samples_keys(Batch_ens_samples &s,
+        const Knn_weights &w, const int *selected_ind, int num_selected,
+        const double *samples, int num_samples, uint64_t train_version)
+{
+  /*
+   * prepares the cache keys of batch_ens_scores; train_version must
+   * change whenever the train set, its labels, alpha or the weights do
+   * (see batch_ens_weights_version)
+   */
+  int i, j, b;
+  size_t k;
+  s.train_version = train_version;
+  s.selected.assign(selected_ind, selected_ind + num_selected);
+  s.labels.resize((size_t)num_selected * num_samples);
+  s.history.resize(num_samples);
+  for (j = 0; j < num_samples; j++){
+    uint64_t hash = train_version;
+    for (i = 0; i < num_selected; i++){
+      char label = samples[(size_t)j * num_selected + i] == 1;
+      s.labels[(size_t)j * num_selected + i] = label;
+      hash = batch_ens_hash(batch_ens_hash(hash, selected_ind[i]), label);
+    }
+    s.history[j] = hash;
+  }
+  /* a batch point changes its own posterior and those of its column */
+  s.influenced_by.assign(w.n, 0);
+  for (b = 0; b < num_selected && b < 64; b++){
+    uint64_t bit = (uint64_t)1 << b;
+    j = selected_ind[b];
+    s.influenced_by[j] |= bit;
+    for (k = w.col_ptr[j]; k < w.col_ptr[j+1]; k++)
+      s.influenced_by[w.row_ind[k]] |= bit;
+  }
+}
+
+inline uint64_t batch_ens_candidate_key(const Batch_ens_samples &s,
+        int candidate, uint64_t *relevant)
+{
+  /*
+   * hash of everything the fictional probabilities of the candidate
+   * depend on besides the batch labels; relevant gets the batch points
+   * (b < 64) that influence one of the points involved
+   */
+  const Knn_weights &w = *s.weights;
+  uint64_t key = batch_ens_hash(s.train_version, candidate), mask = 0;
+  size_t k;
+  for (k = w.col_ptr[candidate]; k < w.col_ptr[candidate+1]; k++){
+    int i = (int)w.row_ind[k];
+    mask |= s.influenced_by[i];
+    if (s.observed[i] || i == candidate) continue;
+    key = batch_ens_hash(key, i);
+    key = batch_ens_hash_double(key, w.vals[k]);
+    key = batch_ens_hash_double(key, s.base->successes[i]);
+    key = batch_ens_hash_double(key, s.base->failures[i]);
+  }
+  *relevant = mask;
+  return key;
+}
+
+inline uint64_t batch_ens_sample_key(const Batch_ens_samples &s, int j,
+        uint64_t key, uint64_t relevant)
+{
+  /* adds the labels of the relevant batch points under sample j */
+  int b, num_selected = (int)s.selected.size();
+  const char *labels = s.labels.data() + (size_t)j * num_selected;
+  for (b = 0; b < num_selected; b++){
+    if (b < 64 && !(relevant >> b & 1)) continue;
+    key = batch_ens_hash(batch_ens_hash(key, s.selected[b]), labels[b]);
+  }
+  return key;
+}
+
+inline double batch_ens_cached_utility(const Batch_ens_samples &s, int j,
+        Batch_ens_cache &cache, Batch_ens_workspace &ws, int candidate,
+        int budget, uint64_t candidate_key, uint64_t relevant)
+{
+  /* batch_ens_future_utility through the cache */
+  std::vector<double> &values = ws.values;
+  uint64_t utility_key = batch_ens_hash(batch_ens_hash(batch_ens_hash(
+          candidate_key, ~(uint64_t)0), s.history[j]), budget);
+  double prob, utility;
+  int nq;
+
+  if (batch_ens_cache_find(cache, utility_key, values))
+    return values[0];
+  prob = batch_ens_probability(s, j, candidate);
+  nq = batch_ens_removed_points(s, j, ws, candidate);
+  if (nq == 0)
+    utility = batch_ens_merge(s, j, ws, NULL, 0, budget);
+  else {
+    /* q for both labels, positive first */
+    uint64_t q_key = batch_ens_sample_key(s, j, candidate_key, relevant);
+    if (!batch_ens_cache_find(cache, q_key, values) ||
+            (int)values.size() != 2 * nq){
+      values.resize(2 * nq);
+      batch_ens_fake_probabilities(s, j, candidate, true, values.data());
+      batch_ens_fake_probabilities(s, j, candidate, false,
+              values.data() + nq);
+      batch_ens_cache_insert(cache, q_key, values);
+    }
+    utility = prob * batch_ens_merge(s, j, ws, values.data(), nq, budget) +
+            (1 - prob) * batch_ens_merge(s, j, ws, values.data() + nq, nq,
+            budget);
+  }
+  values.assign(1, utility);
+  batch_ens_cache_insert(cache, utility_key, values);
+  return utility;
+}
+
+template <typename Score>
+int batch_ens_pruned_loop(int num_candidates, const double *upper_bound,
+        int num_threads, double *scores, char *pruned, char *scored_out,
+        int *num_computed, Score score_of)
+{
+  /*
+   * scores[c] = score_of(c, thread) in descending order of upper_bound
+   * with the pruning described above; the return value and outputs are
+   * those of batch_ens_scores
+   */
+  int i, best = -1;
+  double best_score = -INFINITY;
+  std::vector<int> order(num_candidates);
+  std::vector<char> scored(num_candidates, 0);
+  std::atomic<double> shared_max(-INFINITY);
+  std::atomic<int> computed(0);
+
+  for (i = 0; i < num_candidates; i++){
+    order[i] = i;
+    scores[i] = 0;
+  }
+  if (upper_bound){
+    std::stable_sort(order.begin(), order.end(), [upper_bound](int a, int b){
+      return upper_bound[a] > upper_bound[b];
+    });
+  }
+
+  parallel_for(num_candidates, num_threads, [&](int t, int thread){
+    int c = order[t];
+    double score, old;
+    if (upper_bound && upper_bound[c] <= shared_max.load())
+      return;
+    score = score_of(c, thread);
+    scores[c] = score;
+    scored[c] = 1;
+    computed++;
+    /* publish the improvement */
+    old = shared_max.load();
+    while (score > old && !shared_max.compare_exchange_weak(old, score))
+      ;
+  });
+
+  for (i = 0; i < num_candidates; i++){
+    if (scored[i] && scores[i] > best_score){
+      best_score = scores[i];
+      best = i;
+    }
+  }
+  if (pruned){
+    for (i = 0; i < num_candidates; i++)
+      pruned[i] = upper_bound && upper_bound[i] <= best_score;
+  }
+  if (scored_out)
+    std::copy(scored.begin(), scored.end(), scored_out);
+  if (num_computed)
+    *num_computed = computed;
+  return best;
+}
+
+inline int batch_ens_scores(const Batch_ens_samples &s,
+        const double *sample_weights, const int *candidates,
+        const double *probs, int num_candidates, int budget,
+        const double *upper_bound, int num_threads,
+        double *scores, char *pruned, int *num_computed,
+        Batch_ens_cache *cache = NULL, char *scored = NULL)
+{
+  /*
+   * Returns the position of the best candidate (-1 if none); skipped
+   * candidates get score 0, pruned (optional) marks all candidates
+   * whose bound does not exceed the best score, as in
+   * batch_ens_select_next.m, and scored (optional) those whose score was
+   * computed. cache (optional) needs batch_ens_samples_keys.
+   */
+  int num_samples = (int)s.samples.size();
+
+  if (num_threads > num_candidates)
+    num_threads = num_candidates;
+  if (num_threads < 1)
+    num_threads = 1;
+  std::vector<Batch_ens_workspace> ws(num_threads);
+
+  return batch_ens_pruned_loop(num_candidates, upper_bound, num_threads,
+          scores, pruned, scored, num_computed, [&](int c, int thread){
+    uint64_t key = 0, relevant = 0;
+    double score = 0, utility;
+    int j;
+    if (cache)
+      key = batch_ens_candidate_key(s, candidates[c], &relevant);
+    for (j = 0; j < num_samples; j++){
+      if (sample_weights[j] < DBL_EPSILON) continue;  /* Matlab eps */
+      utility = cache ? batch_ens_cached_utility(s, j, *cache, ws[thread],
+              candidates[c], budget, key, relevant) :
+              batch_ens_future_utility(s, j, ws[thread], candidates[c],
+              budget);
+      score += sample_weights[j] * (utility - s.samples[j].current_utility);
+    }
+    return score + probs[c];
+  });
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "mex.h"
+#include <vector>
+#include "batch_ens_score.h"
+#include "../models/knn_mex.h"
+
+/*
+ * [estimated_expected_utility, pruned, best, num_computed, scored] = ...
+ *     batch_ens_scores(weights, alpha, train_ind, observed_labels, ...
+ *     selected_ind, samples, sample_weights, test_ind, probs, ...
+ *     remaining_budget, upper_bound, num_threads)
+ *
+ * Multithreaded version of the candidate loop of batch_ens_select_next.m
+ * (see batch_ens_score.h). samples is (numel(selected_ind) x num_samples)
+ * with the fictional labels of the points already in the batch, and
+ * sample_weights their normalized weights. upper_bound may be empty to
+ * disable pruning; num_threads defaults to the number of cores. scored
+ * marks the candidates whose utility was computed (the others get 0).
+ *
+ * Fictional probabilities and future utilities are memoized across
+ * calls in a cache of at most cache_bytes bytes (see batch_ens_cache.h;
+ * default BATCH_ENS_CACHE_BYTES, 0 disables and empties it). Entries are
+ * keyed by the weights (see batch_ens_weights_version), alpha and the
+ * train set, so problems on other graphs never see each other's entries.
+ */
+
+const size_t BATCH_ENS_CACHE_BYTES = (size_t)256 << 20;
+
+static Batch_ens_cache cache;
+
+#define WEIGHTS_ARG        prhs[0]
+#define ALPHA_ARG          prhs[1]
+#define TRAIN_IND_ARG      prhs[2]
+#define LABELS_ARG         prhs[3]
+#define SELECTED_IND_ARG   prhs[4]
+#define SAMPLES_ARG        prhs[5]
+#define SAMPLE_WEIGHTS_ARG prhs[6]
+#define TEST_IND_ARG       prhs[7]
+#define PROBS_ARG          prhs[8]
+#define BUDGET_ARG         prhs[9]
+#define UPPER_BOUND_ARG    prhs[10]
+#define NUM_THREADS_ARG    prhs[11]
+#define CACHE_BYTES_ARG    prhs[12]
+
+#define UTILITIES_ARG      plhs[0]
+#define PRUNED_ARG         plhs[1]
+#define BEST_ARG           plhs[2]
+#define NUM_COMPUTED_ARG   plhs[3]
+#define SCORED_ARG         plhs[4]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *upper_bound, *alpha, *labels;
+  size_t cache_bytes;
+  uint64_t version;
+  int budget, num_samples, num_test, num_threads, i, best, num_computed;
+
+  if (nrhs < 10)
+    mexErrMsgIdAndTxt("batch_ens_scores:nargin", "at least 10 inputs required");
+
+  /* get input */
+  Knn_weights weights = knn_weights_from_mx(WEIGHTS_ARG,
+          "batch_ens_scores:weights");
+  std::vector<int> train = indices_from_mx(TRAIN_IND_ARG);
+  std::vector<int> selected = indices_from_mx(SELECTED_IND_ARG);
+  std::vector<int> candidates = indices_from_mx(TEST_IND_ARG);
+  budget = (int)(mxGetScalar(BUDGET_ARG));
+  upper_bound = (nrhs > 10 && !mxIsEmpty(UPPER_BOUND_ARG)) ?
+          mxGetPr(UPPER_BOUND_ARG) : NULL;
+  num_threads = (nrhs > 11 && !mxIsEmpty(NUM_THREADS_ARG)) ?
+          (int)(mxGetScalar(NUM_THREADS_ARG)) : default_num_threads();
+  cache_bytes = (nrhs > 12 && !mxIsEmpty(CACHE_BYTES_ARG)) ?
+          (size_t)(mxGetScalar(CACHE_BYTES_ARG)) : BATCH_ENS_CACHE_BYTES;
+  num_samples = (int)mxGetNumberOfElements(SAMPLE_WEIGHTS_ARG);
+  num_test = (int)candidates.size();
+  alpha = mxGetPr(ALPHA_ARG);
+  labels = mxGetPr(LABELS_ARG);
+
+  Knn_posterior base;
+  knn_posterior_init(base, weights, alpha, train.data(), labels,
+          (int)train.size());
+  Batch_ens_samples samples;
+  batch_ens_samples_init(samples, weights, base, selected.data(),
+          (int)selected.size(), mxGetPr(SAMPLES_ARG), num_samples, budget,
+          num_threads);
+
+  batch_ens_cache_resize(cache, cache_bytes);
+  if (cache_bytes > 0){
+    version = batch_ens_weights_version(weights, train.size());
+    version = batch_ens_hash_double(version, alpha[0]);
+    version = batch_ens_hash_double(version, alpha[1]);
+    for (i = 0; i < (int)train.size(); i++)
+      version = batch_ens_hash(batch_ens_hash(version, train[i]),
+              labels[i] == 1);
+    batch_ens_samples_keys(samples, weights, selected.data(),
+            (int)selected.size(), mxGetPr(SAMPLES_ARG), num_samples,
+            version);
+  }
+
+  UTILITIES_ARG = mxCreateDoubleMatrix(num_test, 1, mxREAL);
+  std::vector<char> pruned(num_test), scored(num_test);
+
+  best = batch_ens_scores(samples, mxGetPr(SAMPLE_WEIGHTS_ARG),
+          candidates.data(), mxGetPr(PROBS_ARG), num_test, budget,
+          upper_bound, num_threads, mxGetPr(UTILITIES_ARG), pruned.data(),
+          &num_computed, cache_bytes > 0 ? &cache : NULL, scored.data());
+
+  if (nlhs > 1){
+    PRUNED_ARG = mxCreateLogicalMatrix(num_test, 1);
+    mxLogical *out = mxGetLogicals(PRUNED_ARG);
+    for (i = 0; i < num_test; i++)
+      out[i] = pruned[i] != 0;
+  }
+  if (nlhs > 2)
+    BEST_ARG = mxCreateDoubleScalar(best + 1);
+  if (nlhs > 3)
+    NUM_COMPUTED_ARG = mxCreateDoubleScalar(num_computed);
+  if (nlhs > 4){
+    SCORED_ARG = mxCreateLogicalMatrix(num_test, 1);
+    mxLogical *out = mxGetLogicals(SCORED_ARG);
+    for (i = 0; i < num_test; i++)
+      out[i] = scored[i] != 0;
+  }
+}
@@ -15,15 +15,20 @@
 % Inputs:
 %   test_ind: test indices (unlabeled ind) in descending order of probs
 %      probs: probabilities of test_ind in descending order
+%   stale_bound: (optional) scores of the points in earlier slots of this
+%      batch (num_points x 1, Inf if never computed); for a submodular f
+%      they bound the current scores (lazy greedy, see batch_ens.m)
+%
+% Output stale_bound is the input with the scores computed here filled in.
 % 9/24/2017
 
 function [point_added_to_batch, cand_ind, estimated_expected_utility, ...
-  which_index, upper_bound_of_score] = ...
+  which_index, upper_bound_of_score, stale_bound] = ...
   batch_ens_select_next(...
   problem, train_and_selected_ind, observed_labels, test_ind, probs, ...
   model, weights, ...
   iter, samples, sample_weights, all_probs, ...
-  num_samples, remaining_budget, probability_bound)
+  num_samples, remaining_budget, probability_bound, stale_bound)
 
 num_test   = numel(test_ind);
 num_points = size(problem.points, 1);
@@ -43,13 +48,30 @@ else
   do_pruning = true;
 end
 pruned = false(num_test, 1);
+scored = false(num_test, 1);
+
+% the native engine (see query_strategies/batch_ens_scores.cpp, used when
+% problem.use_native_ens says the model is the k-NN model) keeps its own
+% sparse samples; the bound below then only needs the top
+% remaining_budget points of each sample, not the whole order
+native = isfield(problem, 'use_native_ens') && problem.use_native_ens && ...
+  exist('batch_ens_scores', 'file') == 3 && ~isfield(problem, 'limit');
+if native
+  num_top = min(remaining_budget, num_unlabeled);
+else
+  num_top = num_unlabeled;
+end
 unlabeled_probs = nan(num_unlabeled, num_samples);
-top_ind = nan(num_unlabeled, num_samples);
+top_ind = nan(num_top, num_samples);
 cur_future_utility = zeros(num_samples, 1);
 estimated_expected_utility = zeros(num_test, 1);
 for j = 1:num_samples
   unlabeled_probs(:,j) = all_probs(unlabeled_ind, j);
-  [~, top_ind(:,j)] = sort(unlabeled_probs(:,j), 'descend');
+  if native
+    [~, top_ind(:,j)] = maxk(unlabeled_probs(:,j), num_top);
+  else
+    [~, top_ind(:,j)] = sort(unlabeled_probs(:,j), 'descend');
+  end
   cur_future_utility(j) = sum(unlabeled_probs(...
     top_ind(1:remaining_budget,j),j));
 end
@@ -61,8 +83,17 @@ future_utility_bound = upper_bound_future_utility(problem, ...
   probability_bound, top_ind, cur_future_utility);
 upper_bound_of_score = probs + future_utility_bound(reverse_ind(test_ind));
 
-% if compute by descending order of upper bound
-if isfield(problem, 'sort_upper') && problem.sort_upper
+% lazy greedy: a score from an earlier slot bounds the current one
+lazy = exist('stale_bound', 'var') && ~isempty(stale_bound);
+if lazy
+  upper_bound_of_score = min(upper_bound_of_score, stale_bound(test_ind));
+else
+  stale_bound = [];
+end
+
+% if compute by descending order of upper bound (always when lazy, so
+% that candidates are evaluated from the top of the stale bounds down)
+if lazy || (isfield(problem, 'sort_upper') && problem.sort_upper)
   [upper_bound_of_score, sort_ind] = sort(upper_bound_of_score, 'descend');
   test_ind = test_ind(sort_ind);
   probs    = probs(sort_ind);
@@ -90,6 +121,40 @@ if memorize && 2^(iter-1) > num_samples  % to track repeated samples due to resa
   end
   sample_weights = new_weights / sum(new_weights);
 end
+
+% score all candidates with the multithreaded native engine if compiled
+if native
+  if do_pruning
+    bound = upper_bound_of_score;
+  else
+    bound = [];
+  end
+  if isfield(problem, 'num_threads')
+    num_threads = problem.num_threads;
+  else
+    num_threads = [];
+  end
+  % memo of fictional probabilities kept across calls (bytes, 0 disables)
+  if isfield(problem, 'batch_ens_cache_bytes')
+    cache_bytes = problem.batch_ens_cache_bytes;
+  else
+    cache_bytes = [];
+  end
+  num_observed = numel(observed_labels);
+  [estimated_expected_utility, pruned, best, num_computed, scored] = ...
+    batch_ens_scores(weights, problem.alpha, ...
+    train_and_selected_ind(1:num_observed), observed_labels, ...
+    train_and_selected_ind((num_observed+1):end), ...
+    samples(1:(iter-1), 1:num_samples), sample_weights(1:num_samples), ...
+    test_ind, probs, remaining_budget, bound, num_threads, cache_bytes);
+  point_added_to_batch = test_ind(best);
+  which_index = [best, num_computed];
+  cand_ind = test_ind(~pruned);
+  if lazy
+    stale_bound(test_ind(scored)) = estimated_expected_utility(scored);
+  end
+  return;
+end
 for i = 1:num_test
   if do_pruning && pruned(i), continue; end
   %   disp(i);
@@ -150,6 +215,7 @@ for i = 1:num_test
       sample_weights(j)*delta_future_utility;
   end
   estimated_expected_utility(i) = probs(i) + average_future_utility;
+  scored(i) = true;
   if estimated_expected_utility(i) > current_max
     current_max    = estimated_expected_utility(i);
     
@@ -165,4 +231,6 @@ for i = 1:num_test
   end
 end
 cand_ind = test_ind(~pruned);
-
+if lazy
+  stale_bound(test_ind(scored)) = estimated_expected_utility(scored);
+end
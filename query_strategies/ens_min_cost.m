@@ -61,13 +61,27 @@ elseif contains(approx, '_dp')
 
 end
 
+% the upper bounds below may use the rigorous lower bound on the cost of
+% min_cost/npb_normal.h, O(n) instead of the DP (problem.npb_normal_tolerance:
+% largest gap between the bound and the normal approximation, relative to
+% the latter, before falling back to the DP); it never exceeds the DP, so
+% the scores keep their upper bounds
+bound_cost_func_direct = cost_func_direct;
+normal_cost_func = 'compute_negative_poisson_binomial_expectation_normal';
+if contains(approx, '_dp') && isfield(problem, 'npb_normal_tolerance') && ...
+    exist(normal_cost_func, 'file') == 3
+  bound_cost_func_direct = @(p, remaining_goal_after_this_point) ...
+    npb_cost_lower_bound(p, remaining_goal_after_this_point, ...
+    problem.npb_normal_tolerance, approx_one);
+end
+
 %% upper bound the score
 
 %% if conditioning on another negative point, current probabilities 
 %% are already upper bound
 extra = 1e-3;
-future_utility_if_neg = -cost_func_direct(success_probabilities(top_ind), ...
-  yet_to_be_found) + extra;
+future_utility_if_neg = -bound_cost_func_direct(...
+  success_probabilities(top_ind), yet_to_be_found) + extra;
 %% if conditioning on another positive point
 num_positives = 1;
 % sorted probability upper bounds
@@ -84,7 +98,7 @@ if max_num_influence < yet_to_be_found
     prob_upper_bound((max_num_influence+1):end))];
 end
 
-future_utility_if_pos = -cost_func_direct(prob_upper_bound, ...
+future_utility_if_pos = -bound_cost_func_direct(prob_upper_bound, ...
   yet_to_be_found-1) + extra;
 
 upper_bound_of_score = success_probabilities * future_utility_if_pos  + ...
@@ -102,6 +116,27 @@ else
   do_pruning = true;
 end
 
+batch_cost_func = ...
+  'compute_negative_poisson_binomial_expectation_dp_approx_batch';
+if contains(approx, '_dp') && exist(batch_cost_func, 'file') == 3
+  [query_ind, cand_ind, expected_utilities] = ens_min_cost_batched(...
+    problem, train_ind, observed_labels, model, weights, probabilities, ...
+    top_ind, test_ind, reverse_ind, yet_to_be_found, approx_one, ...
+    batch_cost_func, do_pruning, upper_bound_of_score, ...
+    future_utility_if_pos, future_utility_if_neg);
+  return;
+end
+
+% for argmin_sum, answer the merges with prefix sums of the sorted
+% probabilities built once per step (see score_functions/top_sum_index.h)
+use_index = strcmp(approx, 'argmin_sum') && ...
+  exist('merge_sum_indexed', 'file') == 3;
+if use_index
+  p_sorted = success_probabilities(top_ind);
+  cumsum_p = cumsum(p_sorted);
+  sorted_pos = zeros(num_test, 1);
+  sorted_pos(top_ind) = 1:num_test;
+end
 for i = 1:num_test
   if do_pruning && pruned(i), continue; end
 
@@ -141,8 +176,15 @@ for i = 1:num_test
 
       q = sort(fake_probabilities(:, 1), 'descend');
 
-      fake_utilities(fake_label) = ...
-        -cost_func(p, q, top_ind, remaining_goal_after_this_point);
+      if use_index
+        removed_pos = ...
+          sorted_pos(reverse_ind([this_test_ind; fake_test_ind]));
+        fake_utilities(fake_label) = -merge_sum_indexed(p_sorted, ...
+          cumsum_p, removed_pos, q, remaining_goal_after_this_point);
+      else
+        fake_utilities(fake_label) = ...
+          -cost_func(p, q, top_ind, remaining_goal_after_this_point);
+      end
     end
     %% use this implementation to match with batch-ens (numerical issues)
     success_prob = probabilities(reverse_ind(this_test_ind), 1);
@@ -170,3 +212,95 @@ fprintf('\n#train/#total: %d/%d, #pruned/#candidate: %d/%d=%.2f%%\n', ...
   sum(pruned), num_test, mean(pruned)*100);
 
 end
+
+function cost = npb_cost_lower_bound(p, remaining_goal, tolerance, approx_one)
+% rigorous lower bound on the expected cost (the DP when the bound is not
+% within tolerance)
+cost = compute_negative_poisson_binomial_expectation_normal(...
+  p, remaining_goal, tolerance, approx_one, 'bound');
+end
+
+function [query_ind, cand_ind, expected_utilities] = ens_min_cost_batched(...
+  problem, train_ind, observed_labels, model, weights, probabilities, ...
+  top_ind, test_ind, reverse_ind, yet_to_be_found, approx_one, ...
+  batch_cost_func, do_pruning, upper_bound_of_score, ...
+  future_utility_if_pos, future_utility_if_neg)
+% the candidate loop of ens_min_cost with the expectations of all
+% candidates asked for through the batched DP mex
+success_probabilities = probabilities(:, 1);
+num_test = numel(test_ind);
+expected_utilities = zeros(num_test, 1);
+pruned = false(num_test, 1);
+current_max = -problem.num_points;
+
+% evaluate the candidates in chunks with one batched call each, pruning
+% in between; the mex keeps the dynamic program over the shared sorted
+% probabilities between the calls of a step, so it is done once per goal
+% (see min_cost/npb_batch.h)
+chunk_size = 64;
+p_sorted = success_probabilities(top_ind);
+sorted_pos = zeros(num_test, 1);
+sorted_pos(top_ind) = 1:num_test;
+i = 1;
+while i <= num_test
+  chunk = zeros(0, 1);
+  while i <= num_test && numel(chunk) < chunk_size
+    if ~(do_pruning && pruned(i))
+      chunk(end+1, 1) = i; %#ok<AGROW>
+    end
+    i = i + 1;
+  end
+  
+  num_chunk = numel(chunk);
+  excluded = cell(2*num_chunk, 1);
+  qs = cell(2*num_chunk, 1);
+  goals = zeros(2*num_chunk, 1);
+  for c = 1:num_chunk
+    this_test_ind = test_ind(chunk(c));
+    fake_train_ind = [train_ind; this_test_ind];
+    fake_test_ind = find(weights(:, this_test_ind));
+    for fake_label = 1:problem.num_classes
+      query = 2*(c-1) + fake_label;
+      excluded{query} = ...
+        sorted_pos(reverse_ind([this_test_ind; fake_test_ind]));
+      goals(query) = yet_to_be_found-(fake_label==1);
+      if ~isempty(fake_test_ind)
+        fake_observed_labels = [observed_labels; fake_label];
+        fake_probabilities = ...
+          model(problem, fake_train_ind, fake_observed_labels, ...
+          fake_test_ind);
+        qs{query} = sort(fake_probabilities(:, 1), 'descend');
+      end
+    end
+  end
+  costs = feval(batch_cost_func, p_sorted, excluded, qs, goals, ...
+    approx_one);
+  
+  for c = 1:num_chunk
+    ii = chunk(c);
+    if do_pruning && pruned(ii), continue; end
+    fake_utilities = -costs((2*c-1):(2*c));
+    success_prob = probabilities(reverse_ind(test_ind(ii)), 1);
+    expected_utilities(ii) = ...
+      [success_prob, 1 - success_prob] * fake_utilities;
+    if do_pruning
+      if (future_utility_if_pos < fake_utilities(1) || ...
+          future_utility_if_neg < fake_utilities(2))
+        warning('upper bound bug: upper bound (%f %f), actual (%f, %f)', ...
+          future_utility_if_pos, future_utility_if_neg, ...
+          fake_utilities(1), fake_utilities(2));
+      end
+    end
+    if expected_utilities(ii) > current_max
+      current_max = expected_utilities(ii);
+      query_ind = test_ind(ii);
+      pruned(upper_bound_of_score < current_max) = true;
+    end
+  end
+end
+
+cand_ind = test_ind(~pruned);
+fprintf('\n#train/#total: %d/%d, #pruned/#candidate: %d/%d=%.2f%%\n', ...
+  length(train_ind), problem.num_points, ...
+  sum(pruned), num_test, mean(pruned)*100);
+end
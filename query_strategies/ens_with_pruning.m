@@ -74,6 +74,23 @@ else
   do_pruning = true;
 end
 
+% score all candidates in one call if the native engine is compiled and
+% model is the k-NN model with problem.alpha (see
+% score_functions/ens_scores.cpp), which problem.use_native_ens asserts
+if isfield(problem, 'use_native_ens') && problem.use_native_ens && ...
+    exist('ens_scores', 'file') == 3
+  if do_pruning
+    bound = upper_bound_of_score;
+  else
+    bound = [];
+  end
+  [expected_utilities, pruned, best] = ens_scores(weights, problem.alpha, ...
+    train_ind, observed_labels, test_ind, remaining_budget, bound);
+  query_ind = test_ind(best);
+  cand_ind = test_ind(~pruned);
+  return;
+end
+
 for i = 1:num_test
   if do_pruning && pruned(i), continue; end
   
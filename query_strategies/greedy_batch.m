@@ -0,0 +1,30 @@
+% function batch_ind = greedy_batch(problem, train_ind, observed_labels, ...
+%         test_ind, model)
+%
+% greedy (one-step) batch: the problem.batch_size points of test_ind with
+% the highest probabilities, in descending order (ties to the earlier
+% point, as sort does). With query_strategies/top_k_select.cpp compiled
+% they are selected in one pass instead of sorting all probabilities.
+%
+% Output:
+%    batch_ind: indices of the chosen batch
+
+function batch_ind = greedy_batch(problem, train_ind, observed_labels, ...
+  test_ind, model)
+
+if isfield(problem, 'batch_size')
+  batch_size = problem.batch_size;
+else
+  batch_size = 1;
+end
+test_probs = model(problem, train_ind, observed_labels, test_ind);
+
+if exist('top_k_select', 'file') == 3
+  top = top_k_select(test_probs(:,1), batch_size);
+else
+  [~, top] = sort(test_probs(:,1), 'descend');
+  top = top(1:min(batch_size, numel(top)));
+end
+batch_ind = test_ind(top);
+
+end
@@ -0,0 +1,74 @@
+#ifndef MERGE_SUM_H
+#define MERGE_SUM_H
+
+#include <cstddef>
+
+/*
+ * Kernel of merge_sum.cpp: the (fractional) number of points, taken from
+ * p (m values walked in the order of top_ind, 1-based, skipping zeros)
+ * merged with q (n values, descending), whose probabilities add up to
+ * remaining_goal; m-1 if they never do.
+ */
+
+inline double merge_sum_cost(const double *p, size_t m, const double *q,
+        size_t n, const double *top_ind, int remaining_goal)
+{
+#define P_IND ((int)(top_ind[j]) - 1)
+  double utility = 0, cost = 0, last_p = 0;
+  size_t j = 0, k = 0;
+
+  while (p[P_IND] == 0)
+    j++;
+  while ((j < m) && (k < n)) {
+    if (p[P_IND] > q[k]) {
+      utility += p[P_IND];
+      last_p = p[P_IND];
+      do {
+        j++;
+      } while (p[P_IND] == 0);
+    }
+    else {
+      utility += q[k];
+      last_p = q[k];
+      k++;
+    }
+    cost += 1;
+    if (utility >= remaining_goal){
+      break;
+    }
+  }
+  if (utility < remaining_goal){
+    while (j < m) {
+      utility += p[P_IND];
+      last_p = p[P_IND];
+      do {
+        j++;
+      } while (p[P_IND] == 0);
+
+      cost += 1;
+      if (utility >= remaining_goal){
+        break;
+      }
+    }
+
+    while (k < n) {
+      utility += q[k];
+      last_p = q[k];
+      k++;
+      cost += 1;
+      if (utility >= remaining_goal){
+        break;
+      }
+    }
+  }
+  if (utility < remaining_goal){
+    cost = m-1;
+  }
+  else{  // corretion by subtracting the extra utility
+    cost = cost - (utility - remaining_goal)/last_p;
+  }
+#undef P_IND
+  return cost;
+}
+
+#endif
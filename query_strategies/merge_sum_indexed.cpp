@@ -0,0 +1,55 @@
+#include "mex.h"
+#include <vector>
+#include "../score_functions/top_sum_index.h"
+
+/*
+ * cost = merge_sum_indexed(p_sorted, cumsum_p, removed_pos, q, remaining_goal)
+ *
+ * Same as merge_sum(p, q, top_ind, remaining_goal), where
+ * p_sorted = p(top_ind) before zeroing, cumsum_p = cumsum(p_sorted) is
+ * computed once per selection step, and removed_pos are the positions
+ * in p_sorted of the zeroed entries. The crossing of the cumulative sum
+ * is found by binary search over the indexed merge (see top_sum_index.h).
+ */
+
+#define P_ARG       prhs[0]
+#define CUMSUM_ARG  prhs[1]
+#define REMOVED_ARG prhs[2]
+#define Q_ARG       prhs[3]
+#define REM_GOAL    prhs[4]
+#define SUM_ARG     plhs[0]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *removed_pos, remaining_goal, utility = 0, last_p = 0, cost;
+  int num_removed, m, count, i;
+
+  if (nrhs < 5)
+    mexErrMsgIdAndTxt("merge_sum_indexed:nargin", "5 inputs required");
+
+  /* get input */
+  m = (int)mxGetNumberOfElements(P_ARG);
+  Top_sum_index index;
+  top_sum_index_init(index, mxGetPr(P_ARG), m, mxGetPr(CUMSUM_ARG));
+  removed_pos = mxGetPr(REMOVED_ARG);
+  num_removed = (int)mxGetNumberOfElements(REMOVED_ARG);
+  remaining_goal = (int)(mxGetScalar(REM_GOAL));
+
+  /* Matlab indices are 1-based */
+  std::vector<int> removed(num_removed);
+  for (i = 0; i < num_removed; i++)
+    removed[i] = (int)removed_pos[i] - 1;
+  std::sort(removed.begin(), removed.end());
+
+  count = top_sum_index_crossing(index, removed.data(), num_removed,
+          mxGetPr(Q_ARG), (int)mxGetNumberOfElements(Q_ARG), remaining_goal,
+          &utility, &last_p);
+  if (count == 0){
+    cost = m-1;
+  }
+  else{  // corretion by subtracting the extra utility
+    cost = count - (utility - remaining_goal)/last_p;
+  }
+  SUM_ARG = mxCreateDoubleScalar(cost);
+}
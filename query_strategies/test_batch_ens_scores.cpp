@@ -0,0 +1,177 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include "batch_ens_score.h"
+#include "../models/test_knn_graph.h"
+
+/*
+ * Checks the multithreaded, pruned candidate loop of batch_ens_score.h
+ * against the serial loop without pruning: the same best candidate, the
+ * same score for every candidate marked scored, and every candidate
+ * that was not pruned marked scored. Returns 1 on failure.
+ */
+
+const int NUM_THREADS = 8;
+
+static void copy_graph(Test_graph &g, const Test_graph &from)
+{
+  /* same weights at other addresses */
+  g = from;
+  test_graph_point_weights(g);
+}
+
+static int check(const char *name, int trial, int num, const double *bound,
+        const std::vector<double> &want, int want_best,
+        const std::vector<double> &got, const std::vector<char> &pruned,
+        const std::vector<char> &scored, int best)
+{
+  /* got against the serial scores want */
+  int i, errors = 0;
+  if (best != want_best){
+    printf("%s trial %d: best %d, serial %d\n", name, trial, best,
+            want_best);
+    errors++;
+  }
+  for (i = 0; i < num; i++){
+    if (bound[i] > want[want_best] && pruned[i]){
+      printf("%s trial %d: candidate %d pruned with bound %g > %g\n", name,
+              trial, i, bound[i], want[want_best]);
+      errors++;
+    }
+    if (!pruned[i] && !scored[i]){
+      printf("%s trial %d: candidate %d neither pruned nor scored\n", name,
+              trial, i);
+      errors++;
+    }
+    if (scored[i] && fabs(got[i] - want[i]) > 1e-12 * (1 + fabs(want[i]))){
+      printf("%s trial %d: candidate %d scored %g, serial %g\n", name,
+              trial, i, got[i], want[i]);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static int test_loop(std::mt19937_64 &gen)
+{
+  /*
+   * batch_ens_pruned_loop with a synthetic score that yields, so that
+   * threads get preempted between claiming a candidate and scoring it;
+   * most bounds are barely above their scores, so pruning starts early
+   */
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  int trial, i, errors = 0, num = 64;
+  for (trial = 0; trial < 200; trial++){
+    std::vector<double> want(num), bound(num), got(num);
+    std::vector<char> pruned(num), scored(num);
+    int want_best = 0, best;
+    for (i = 0; i < num; i++){
+      want[i] = uniform(gen);
+      bound[i] = want[i] + (uniform(gen) < 0.9 ? 1e-3 : 0.5) *
+              uniform(gen);
+      if (want[i] > want[want_best])
+        want_best = i;
+    }
+    best = batch_ens_pruned_loop(num, bound.data(), NUM_THREADS,
+            got.data(), pruned.data(), scored.data(), NULL,
+            [&](int c, int){
+      std::this_thread::yield();
+      if ((c + trial) % 4 == 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      return want[c];
+    });
+    errors += check("loop", trial, num, bound.data(), want, want_best, got,
+            pruned, scored, best);
+  }
+  return errors;
+}
+
+static int test_scores(std::mt19937_64 &gen)
+{
+  /*
+   * batch_ens_scores on three graphs of the same points, train set and
+   * samples (k = 10, the same with other weights, k = 8), in turns, each
+   * copied to new arrays; the cache is kept across the calls, as the
+   * static cache of the mex file is, so its keys must tell the graphs
+   * apart
+   */
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  int trial, i, errors = 0, n = 400, budget = 20, num_samples = 16;
+  double alpha[2] = {0.1, 0.9};
+  std::vector<int> train, selected, candidates;
+  std::vector<double> labels, samples, weights;
+  Batch_ens_cache cache;
+  Test_graph graphs[3];
+
+  test_random_graph(graphs[0], n, 10, n / 2, false, gen);
+  copy_graph(graphs[1], graphs[0]);
+  for (i = 0; i < (int)graphs[1].vals.size(); i++)
+    graphs[1].vals[i] *= graphs[1].vals[i];
+  test_random_graph(graphs[2], n, 8, n / 2, false, gen);
+  for (i = 0; i < n; i++){
+    double r = uniform(gen);
+    if (r < 0.05){
+      train.push_back(i);
+      labels.push_back(uniform(gen) < 0.5 ? 1 : 0);
+    }
+    else if (r < 0.07)
+      selected.push_back(i);
+    else
+      candidates.push_back(i);
+  }
+  for (i = 0; i < (int)selected.size() * num_samples; i++)
+    samples.push_back(uniform(gen) < 0.3 ? 1 : 0);
+  for (i = 0; i < num_samples; i++)
+    weights.push_back(1.0 / num_samples);
+  int num = (int)candidates.size();
+  batch_ens_cache_resize(cache, (size_t)1 << 24);
+
+  for (trial = 0; trial < 20; trial++){
+    Test_graph g;
+    Knn_posterior base;
+    Batch_ens_samples s;
+    std::vector<double> probs;
+    int want_best, best, with_cache;
+    copy_graph(g, graphs[trial % 3]);
+    knn_posterior_init(base, g.w, alpha, train.data(), labels.data(),
+            (int)train.size());
+    for (i = 0; i < num; i++)
+      probs.push_back(knn_probability(base, candidates[i]));
+    batch_ens_samples_init(s, g.w, base, selected.data(),
+            (int)selected.size(), samples.data(), num_samples, budget,
+            NUM_THREADS);
+    batch_ens_samples_keys(s, g.w, selected.data(), (int)selected.size(),
+            samples.data(), num_samples, batch_ens_weights_version(g.w, 0));
+
+    /* serial loop, every candidate scored */
+    std::vector<double> want(num), bound(num);
+    want_best = batch_ens_scores(s, weights.data(), candidates.data(),
+            probs.data(), num, budget, NULL, 1, want.data(), NULL, NULL);
+    for (i = 0; i < num; i++)
+      bound[i] = want[i] + (uniform(gen) < 0.8 ? 1e-4 : 1) * uniform(gen);
+
+    for (with_cache = 0; with_cache < 2; with_cache++){
+      std::vector<double> got(num);
+      std::vector<char> pruned(num), scored(num);
+      best = batch_ens_scores(s, weights.data(), candidates.data(),
+              probs.data(), num, budget, bound.data(), NUM_THREADS,
+              got.data(), pruned.data(), NULL, with_cache ? &cache : NULL,
+              scored.data());
+      errors += check(with_cache ? "scores with cache" : "scores", trial,
+              num, bound.data(), want, want_best, got, pruned, scored, best);
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  int errors = test_loop(gen);
+  errors += test_scores(gen);
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
@@ -0,0 +1,52 @@
+#include "mex.h"
+#include <vector>
+#include "top_k_select.h"
+
+/*
+ * [greedy_ind, uncertain_ind] = top_k_select(probs, num_greedy, ...
+ *     num_uncertain)
+ *
+ * Positions (1-based, column vectors) of the num_greedy largest entries
+ * of probs and of the num_uncertain entries closest to 0.5, the same as
+ *
+ *   [~, ind] = sort(probs, 'descend');       greedy_ind = ind(1:num_greedy)
+ *   [~, ind] = sort(abs(probs - 0.5));    uncertain_ind = ind(1:num_uncertain)
+ *
+ * in one pass without sorting (see top_k_select.h). Counts larger than
+ * numel(probs) return all positions.
+ */
+
+#define PROBS_ARG         prhs[0]
+#define NUM_GREEDY_ARG    prhs[1]
+#define NUM_UNCERTAIN_ARG prhs[2]
+
+#define GREEDY_ARG        plhs[0]
+#define UNCERTAIN_ARG     plhs[1]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  int n, num_greedy, num_uncertain, num_found[2], i;
+
+  if (nrhs < 2)
+    mexErrMsgIdAndTxt("top_k_select:nargin", "at least 2 inputs required");
+
+  /* get input */
+  n = (int)mxGetNumberOfElements(PROBS_ARG);
+  num_greedy = std::max(0, std::min(n, (int)mxGetScalar(NUM_GREEDY_ARG)));
+  num_uncertain = (nrhs > 2 && nlhs > 1) ? std::max(0, std::min(n,
+          (int)mxGetScalar(NUM_UNCERTAIN_ARG))) : 0;
+
+  std::vector<int> greedy(num_greedy), uncertain(num_uncertain);
+  top_k_select(mxGetPr(PROBS_ARG), n, num_greedy, num_uncertain,
+          greedy.data(), uncertain.data(), num_found);
+
+  GREEDY_ARG = mxCreateDoubleMatrix(num_found[0], 1, mxREAL);
+  for (i = 0; i < num_found[0]; i++)
+    mxGetPr(GREEDY_ARG)[i] = greedy[i] + 1;
+  if (nlhs > 1){
+    UNCERTAIN_ARG = mxCreateDoubleMatrix(num_found[1], 1, mxREAL);
+    for (i = 0; i < num_found[1]; i++)
+      mxGetPr(UNCERTAIN_ARG)[i] = uncertain[i] + 1;
+  }
+}
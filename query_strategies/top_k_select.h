@@ -0,0 +1,152 @@
+#ifndef TOP_K_SELECT_H
+#define TOP_K_SELECT_H
+
+/*
+ * Fused selection of the batch points of the greedy and uncertainty
+ * baselines (uncertainty_greedy.m, uncertainty_greedy_combined.m and
+ * greedy_batch.m).
+ *
+ * Instead of sorting all probabilities twice, one pass keeps two bounded
+ * heaps: the num_greedy most probable points, in the order of
+ * sort(p, 'descend'), and the num_uncertain most uncertain ones, in the
+ * order of sort(abs(p - 0.5)). Both sorts are stable, so ties go to the
+ * smaller position; a point that only ties the worst kept one can then
+ * never enter a heap, so each block of TOP_K_BLOCK values is first
+ * compared with the two current thresholds and only the values passing
+ * either comparison are pushed. The comparisons use AVX2 when compiled
+ * with it (see poisson_binomial_row.h) and a scalar loop otherwise; both
+ * give the same selection. The cost is O(n + m log k) for m pushes,
+ * which is small once the heaps are full.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+const int TOP_K_BLOCK = 256;
+
+struct Top_k_heap{
+  typedef std::pair<double, int> Entry;  /* (key, position) */
+  int k = 0;
+  std::vector<Entry> entries;            /* front: the worst kept one */
+};
+
+inline bool top_k_before(const Top_k_heap::Entry &a,
+        const Top_k_heap::Entry &b)
+{
+  /* a comes first: larger key, then smaller position */
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+inline double top_k_threshold(const Top_k_heap &heap)
+{
+  /* keys not above it cannot enter */
+  if (heap.k == 0)
+    return INFINITY;
+  if ((int)heap.entries.size() < heap.k)
+    return -INFINITY;
+  return heap.entries.front().first;
+}
+
+inline void top_k_push(Top_k_heap &heap, double key, int position)
+{
+  Top_k_heap::Entry e(key, position);
+  if ((int)heap.entries.size() < heap.k){
+    heap.entries.push_back(e);
+    std::push_heap(heap.entries.begin(), heap.entries.end(), top_k_before);
+  }
+  else if (heap.k > 0 && top_k_before(e, heap.entries.front())){
+    std::pop_heap(heap.entries.begin(), heap.entries.end(), top_k_before);
+    heap.entries.back() = e;
+    std::push_heap(heap.entries.begin(), heap.entries.end(), top_k_before);
+  }
+}
+
+inline int top_k_sorted(Top_k_heap &heap, int *out)
+{
+  /* positions in selection order; returns their number */
+  std::sort(heap.entries.begin(), heap.entries.end(), top_k_before);
+  for (size_t i = 0; i < heap.entries.size(); i++)
+    out[i] = heap.entries[i].second;
+  return (int)heap.entries.size();
+}
+
+inline int top_k_block_mask(const double *p, int len, double greedy,
+        double uncertain, char *mask)
+{
+  /*
+   * mask[i] = p[i] > greedy || -abs(p[i] - 0.5) > uncertain; returns
+   * the number of set entries
+   */
+  int i = 0, count = 0;
+#if defined(__AVX2__)
+  __m256d vg = _mm256_set1_pd(greedy), vu = _mm256_set1_pd(uncertain);
+  __m256d half = _mm256_set1_pd(0.5), sign = _mm256_set1_pd(-0.0);
+  for (; i + 4 <= len; i += 4){
+    __m256d v = _mm256_loadu_pd(p + i);
+    /* -abs(x) sets the sign bit */
+    __m256d certainty = _mm256_or_pd(_mm256_sub_pd(v, half), sign);
+    int bits = _mm256_movemask_pd(_mm256_or_pd(
+            _mm256_cmp_pd(v, vg, _CMP_GT_OQ),
+            _mm256_cmp_pd(certainty, vu, _CMP_GT_OQ)));
+    for (int b = 0; b < 4; b++){
+      mask[i + b] = bits >> b & 1;
+      count += mask[i + b];
+    }
+  }
+#endif
+  for (; i < len; i++){
+    mask[i] = p[i] > greedy || -fabs(p[i] - 0.5) > uncertain;
+    count += mask[i];
+  }
+  return count;
+}
+
+inline void top_k_select(const double *probs, int n, int num_greedy,
+        int num_uncertain, int *greedy, int *uncertain, int *num_found)
+{
+  /*
+   * greedy gets the positions (0-based) of the min(num_greedy, n) most
+   * probable points, uncertain those of the min(num_uncertain, n) most
+   * uncertain ones (either may be NULL if its count is 0); num_found
+   * (optional) gets both counts
+   */
+  Top_k_heap most_probable, most_uncertain;
+  char mask[TOP_K_BLOCK];
+  int start, i;
+
+  most_probable.k = std::max(0, std::min(num_greedy, n));
+  most_uncertain.k = std::max(0, std::min(num_uncertain, n));
+  most_probable.entries.reserve(most_probable.k);
+  most_uncertain.entries.reserve(most_uncertain.k);
+
+  for (start = 0; start < n; start += TOP_K_BLOCK){
+    int len = std::min(TOP_K_BLOCK, n - start);
+    const double *p = probs + start;
+    /* the uncertainty key is -abs(p - 0.5), larger is better */
+    if (top_k_block_mask(p, len, top_k_threshold(most_probable),
+            top_k_threshold(most_uncertain), mask) == 0)
+      continue;
+    for (i = 0; i < len; i++){
+      if (!mask[i]) continue;
+      top_k_push(most_probable, p[i], start + i);
+      top_k_push(most_uncertain, -fabs(p[i] - 0.5), start + i);
+    }
+  }
+
+  int found_greedy = most_probable.k > 0 ?
+          top_k_sorted(most_probable, greedy) : 0;
+  int found_uncertain = most_uncertain.k > 0 ?
+          top_k_sorted(most_uncertain, uncertain) : 0;
+  if (num_found){
+    num_found[0] = found_greedy;
+    num_found[1] = found_uncertain;
+  }
+}
+
+#endif
@@ -32,13 +32,22 @@ if remaining_budget <= batch_size
   return;
 end
 
+native = exist('top_k_select', 'file') == 3;  % selects without sorting
 if budget_spent <= transition_ratio * total_budget
   % uncertainty sampling 
-  certainty = abs(test_probs(:,1) - 0.5);  % close to 0 means uncertain
-  [~, sort_idx] = sort(certainty);
+  if native
+    [~, sort_idx] = top_k_select(test_probs(:,1), 0, batch_size);
+  else
+    certainty = abs(test_probs(:,1) - 0.5);  % close to 0 means uncertain
+    [~, sort_idx] = sort(certainty);
+  end
 else 
   % if remaining budget is small, greedy sampling 
-  [~, sort_idx] = sort(test_probs(:,1), 'descend');
+  if native
+    sort_idx = top_k_select(test_probs(:,1), batch_size);
+  else
+    [~, sort_idx] = sort(test_probs(:,1), 'descend');
+  end
 end
 
 batch_ind = test_ind(sort_idx(1:batch_size));  
@@ -33,11 +33,18 @@ if remaining_budget <= batch_size
   batch_ind = test_ind(1:remaining_budget);  
   return;
 end
-certainty = abs(test_probs(:,1) - 0.5);  % close to 0 means uncertain
-[~, sort_idx1] = sort(certainty);
-[~, sort_idx2] = sort(test_probs(:,1), 'descend');
-
 uncertain_amount = max(1, round(batch_size * epsilon));
+
+% only the first batch_size points of either order are ever used, so the
+% native kernel selects them in one pass without sorting
+if exist('top_k_select', 'file') == 3
+  [sort_idx2, sort_idx1] = top_k_select(test_probs(:,1), batch_size, ...
+    uncertain_amount);
+else
+  certainty = abs(test_probs(:,1) - 0.5);  % close to 0 means uncertain
+  [~, sort_idx1] = sort(certainty);
+  [~, sort_idx2] = sort(test_probs(:,1), 'descend');
+end
 batch_ind = nan(batch_size, 1);
 batch_ind(1:uncertain_amount) = test_ind(sort_idx1(1:uncertain_amount));
 
@@ -22,40 +22,36 @@ if ~exist('cur_future_utility', 'var')
   cur_future_utility = zeros(num_samples, 1);
 end
 
-total_future_utility = zeros(num_unlabeled, 1);
+% bounds of all samples in one call (columns), then the utilities of all
+% samples at once
+observed_and_sampled = [repmat(observed_labels, 1, num_samples); ...
+  samples(1:(i-1), 1:num_samples)];
+num_positives = 1;
+prob_upper_bound = probability_bound(problem, train_and_selected_ind, ...
+  observed_and_sampled, unlabeled_ind, num_positives, remaining_budget);
 
+future_utility_if_neg = zeros(1, num_samples);
+future_utility_if_pos = zeros(1, num_samples);
+max_num_influence = problem.max_num_influence;
 for j = 1:num_samples
-  
-  observed_and_sampled = [observed_labels; samples(1:(i-1), j)];
-  
-  num_positives = 1;
-
-  prob_upper_bound = probability_bound(problem, train_and_selected_ind, ...
-    observed_and_sampled, unlabeled_ind, num_positives, remaining_budget);
-  
-  future_utility_if_neg = ...
+  future_utility_if_neg(j) = ...
     sum(unlabeled_probs(top_ind(1:remaining_budget, j), j));
-  
-  max_num_influence = problem.max_num_influence;
   if max_num_influence >= remaining_budget
-    future_utility_if_pos = sum(prob_upper_bound(1:remaining_budget));
+    future_utility_if_pos(j) = sum(prob_upper_bound(1:remaining_budget, j));
   else
     tmp_ind = top_ind(1:(remaining_budget-max_num_influence), j);
-    future_utility_if_pos = ...
+    future_utility_if_pos(j) = ...
       sum(unlabeled_probs(tmp_ind, j)) + ...
-      sum(prob_upper_bound(1:max_num_influence));
-%       max_num_influence * prob_upper_bound(1);
+      sum(prob_upper_bound(1:max_num_influence, j));
   end
-
-  future_utility = unlabeled_probs(:, j) * future_utility_if_pos  + ...
-    (1 - unlabeled_probs(:, j)) * future_utility_if_neg;
-  
-  delta_future_utility = future_utility - cur_future_utility(j);  % delta
-  
-  total_future_utility = total_future_utility + ...
-    sample_weights(j) * delta_future_utility;
-  
 end
 
-future_utility_bound = ...
-  total_future_utility / sum(sample_weights(1:num_samples));
\ No newline at end of file
+unlabeled_probs = unlabeled_probs(:, 1:num_samples);
+future_utility = unlabeled_probs .* future_utility_if_pos + ...
+  (1 - unlabeled_probs) .* future_utility_if_neg;
+delta_future_utility = future_utility - ...
+  reshape(cur_future_utility(1:num_samples), 1, []);  % delta
+
+future_utility_bound = delta_future_utility * ...
+  reshape(sample_weights(1:num_samples), [], 1) / ...
+  sum(sample_weights(1:num_samples));
@@ -0,0 +1,229 @@
+#ifndef ENS_SCORE_H
+#define ENS_SCORE_H
+
+/*
+ * Native ENS scoring engine.
+ *
+ * Computes for every candidate x the score used by ens_with_pruning.m
+ * (and two_step_score.m with budget 1):
+ *
+ *   Pr(y=1|x,D) + E_y[ sum of top "budget" probabilities | D, (x, y) ]
+ *
+ * The fictional update of the k-NN model, the sort of the updated
+ * probabilities and the merge with the current probabilities (as in
+ * merge_sort.cpp) are all done here, so a whole selection step needs a
+ * single call from Matlab.
+ *
+ * Instead of copying and zeroing the probability vector per candidate,
+ * the positions of the affected points in the current descending order
+ * are collected, and the merge is answered with the prefix sums of that
+ * order (see top_sum_index.h).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "../models/knn_model.h"
+#include "../models/knn_order.h"
+#include "top_sum_index.h"
+
+struct Ens_context{
+  const Knn_weights *weights = NULL;
+  const Knn_posterior *posterior = NULL;
+  std::vector<double> probs;   /* current probabilities (0 if observed) */
+  std::vector<int> top_ind;    /* unlabeled points, descending probability */
+  std::vector<int> position;   /* position of each point in top_ind */
+  std::vector<double> sorted;  /* probs(top_ind) */
+  Top_sum_index index;         /* prefix sums of sorted */
+};
+
+struct Ens_workspace{
+  std::vector<int> removed;    /* positions of the removed points */
+  std::vector<double> q;       /* fictional probabilities of one label */
+};
+
+inline void ens_context_index(Ens_context &ctx)
+{
+  /* positions, sorted probabilities and prefix sums of ctx.top_ind */
+  int i;
+  ctx.position.assign(ctx.weights->n, -1);
+  ctx.sorted.resize(ctx.top_ind.size());
+  for (i = 0; i < (int)ctx.top_ind.size(); i++){
+    ctx.position[ctx.top_ind[i]] = i;
+    ctx.sorted[i] = ctx.probs[ctx.top_ind[i]];
+  }
+  top_sum_index_init(ctx.index, ctx.sorted.data(), (int)ctx.sorted.size(),
+          NULL);
+}
+
+inline void ens_context_init(Ens_context &ctx, const Knn_weights &weights,
+        const Knn_posterior &posterior)
+{
+  int i;
+  ctx.weights = &weights;
+  ctx.posterior = &posterior;
+  ctx.probs.assign(weights.n, 0);
+  ctx.top_ind.clear();
+  for (i = 0; i < weights.n; i++){
+    if (posterior.observed[i]) continue;
+    ctx.probs[i] = knn_probability(posterior, i);
+    ctx.top_ind.push_back(i);
+  }
+  /* stable, so that ties are broken as sort(..., 'descend') does */
+  const std::vector<double> &probs = ctx.probs;
+  std::stable_sort(ctx.top_ind.begin(), ctx.top_ind.end(),
+          [&probs](int a, int b){ return probs[a] > probs[b]; });
+  ens_context_index(ctx);
+}
+
+inline void ens_context_init_ordered(Ens_context &ctx,
+        const Knn_weights &weights, const Knn_posterior &posterior,
+        const Knn_order &order)
+{
+  /*
+   * same as ens_context_init, reading the order kept up to date by
+   * knn_order.h instead of sorting: O(n) instead of O(n log n)
+   */
+  int i, num = knn_order_size(order);
+  ctx.weights = &weights;
+  ctx.posterior = &posterior;
+  ctx.probs.assign(weights.n, 0);
+  ctx.top_ind.resize(num);
+  knn_order_top(order, num, ctx.top_ind.data());
+  for (i = 0; i < num; i++)
+    ctx.probs[ctx.top_ind[i]] = order.key[ctx.top_ind[i]];
+  ens_context_index(ctx);
+}
+
+inline void ens_workspace_init(Ens_workspace &ws, const Ens_context &)
+{
+  ws.removed.clear();
+  ws.q.clear();
+}
+
+inline double merge_top_sum(const Ens_context &ctx, const Ens_workspace &ws,
+        const double *q, int nq, int budget)
+{
+  /*
+   * sum of the top "budget" values of the current probabilities (minus
+   * the removed points) merged with q, where q is sorted in descending
+   * order; same as merge_sort.cpp
+   */
+  return top_sum_index_merged_sum(ctx.index, ws.removed.data(),
+          (int)ws.removed.size(), q, nq, budget, NULL);
+}
+
+inline int ens_removed_points(const Ens_context &ctx, Ens_workspace &ws,
+        int candidate)
+{
+  /*
+   * positions (ascending) of the candidate and every point it influences
+   * in ws.removed; returns the number of influenced points
+   */
+  const Knn_weights &w = *ctx.weights;
+  const Knn_posterior &post = *ctx.posterior;
+  int nq = 0;
+  size_t k;
+
+  ws.removed.clear();
+  ws.removed.push_back(ctx.position[candidate]);
+  for (k = w.col_ptr[candidate]; k < w.col_ptr[candidate+1]; k++){
+    int i = (int)w.row_ind[k];
+    if (post.observed[i] || i == candidate) continue;
+    ws.removed.push_back(ctx.position[i]);
+    nq++;
+  }
+  std::sort(ws.removed.begin(), ws.removed.end());
+  return nq;
+}
+
+inline void ens_fake_probabilities(const Ens_context &ctx, int candidate,
+        bool positive, double *q)
+{
+  /*
+   * probabilities of the points the candidate influences if it had the
+   * given label, in descending order
+   */
+  const Knn_weights &w = *ctx.weights;
+  const Knn_posterior &post = *ctx.posterior;
+  int nq = 0;
+  size_t k;
+
+  for (k = w.col_ptr[candidate]; k < w.col_ptr[candidate+1]; k++){
+    int i = (int)w.row_ind[k];
+    if (post.observed[i] || i == candidate) continue;
+    q[nq++] = knn_fake_probability(post, i, w.vals[k], positive);
+  }
+  std::sort(q, q + nq, std::greater<double>());
+}
+
+inline double ens_future_utility(const Ens_context &ctx, Ens_workspace &ws,
+        int candidate, int budget)
+{
+  /*
+   * expected sum of the top "budget" probabilities after observing the
+   * candidate, taken over its two possible labels
+   */
+  double prob = ctx.probs[candidate];
+  double fake_utilities[2];
+  int nq, label;
+
+  /* remove the candidate and every point it influences */
+  nq = ens_removed_points(ctx, ws, candidate);
+  if (nq == 0){
+    /* this point won't affect any other point */
+    return merge_top_sum(ctx, ws, NULL, 0, budget);
+  }
+
+  ws.q.resize(nq);
+  for (label = 0; label < 2; label++){
+    ens_fake_probabilities(ctx, candidate, label == 0, ws.q.data());
+    fake_utilities[label] = merge_top_sum(ctx, ws, ws.q.data(), nq, budget);
+  }
+  return prob * fake_utilities[0] + (1 - prob) * fake_utilities[1];
+}
+
+inline double ens_score_candidate(const Ens_context &ctx, Ens_workspace &ws,
+        int candidate, int budget)
+{
+  return ctx.probs[candidate] +
+          ens_future_utility(ctx, ws, candidate, budget);
+}
+
+inline int ens_scores(const Ens_context &ctx, const int *candidates,
+        int num_candidates, int budget, const double *upper_bound,
+        double *scores, char *pruned)
+{
+  /*
+   * score candidates in the given order; if upper_bound is not NULL,
+   * skip every candidate whose bound is below the best score so far
+   * (as ens_with_pruning.m does)
+   *
+   * Returns the position of the best candidate (-1 if none); skipped
+   * candidates get score 0, and pruned (optional) marks all candidates
+   * whose bound is below the best score.
+   */
+  Ens_workspace ws;
+  double current_max = -INFINITY;
+  int i, best = -1;
+
+  ens_workspace_init(ws, ctx);
+  for (i = 0; i < num_candidates; i++){
+    scores[i] = 0;
+    if (upper_bound && upper_bound[i] < current_max) continue;
+    scores[i] = ens_score_candidate(ctx, ws, candidates[i], budget);
+    if (scores[i] > current_max){
+      current_max = scores[i];
+      best = i;
+    }
+  }
+  if (pruned){
+    for (i = 0; i < num_candidates; i++){
+      pruned[i] = upper_bound && upper_bound[i] < current_max;
+    }
+  }
+  return best;
+}
+
+#endif
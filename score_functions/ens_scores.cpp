@@ -0,0 +1,67 @@
+#include "mex.h"
+#include <vector>
+#include "ens_score.h"
+#include "../models/knn_mex.h"
+
+/*
+ * [expected_utilities, pruned, best] = ens_scores(weights, alpha, ...
+ *     train_ind, observed_labels, test_ind, budget, upper_bound)
+ *
+ * Scores all candidates test_ind with the ENS score in one call (see
+ * ens_score.h). upper_bound (optional) enables pruning in the order of
+ * test_ind; best is the index into test_ind of the chosen point.
+ */
+
+#define WEIGHTS_ARG     prhs[0]
+#define ALPHA_ARG       prhs[1]
+#define TRAIN_IND_ARG   prhs[2]
+#define LABELS_ARG      prhs[3]
+#define TEST_IND_ARG    prhs[4]
+#define BUDGET_ARG      prhs[5]
+#define UPPER_BOUND_ARG prhs[6]
+
+#define UTILITIES_ARG   plhs[0]
+#define PRUNED_ARG      plhs[1]
+#define BEST_ARG        plhs[2]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *upper_bound, *utilities;
+  int budget, num_test, i, best;
+
+  if (nrhs < 6)
+    mexErrMsgIdAndTxt("ens_scores:nargin", "at least 6 inputs required");
+
+  /* get input */
+  Knn_weights weights = knn_weights_from_mx(WEIGHTS_ARG,
+          "ens_scores:weights");
+  std::vector<int> train = indices_from_mx(TRAIN_IND_ARG);
+  std::vector<int> candidates = indices_from_mx(TEST_IND_ARG);
+  budget = (int)(mxGetScalar(BUDGET_ARG));
+  upper_bound = (nrhs > 6 && !mxIsEmpty(UPPER_BOUND_ARG)) ?
+          mxGetPr(UPPER_BOUND_ARG) : NULL;
+  num_test = (int)candidates.size();
+
+  Knn_posterior posterior;
+  knn_posterior_init(posterior, weights, mxGetPr(ALPHA_ARG), train.data(),
+          mxGetPr(LABELS_ARG), (int)train.size());
+  Ens_context ctx;
+  ens_context_init(ctx, weights, posterior);
+
+  UTILITIES_ARG = mxCreateDoubleMatrix(num_test, 1, mxREAL);
+  utilities = mxGetPr(UTILITIES_ARG);
+  std::vector<char> pruned(num_test);
+
+  best = ens_scores(ctx, candidates.data(), num_test, budget, upper_bound,
+          utilities, pruned.data());
+
+  if (nlhs > 1){
+    PRUNED_ARG = mxCreateLogicalMatrix(num_test, 1);
+    mxLogical *out = mxGetLogicals(PRUNED_ARG);
+    for (i = 0; i < num_test; i++)
+      out[i] = pruned[i] != 0;
+  }
+  if (nlhs > 2)
+    BEST_ARG = mxCreateDoubleScalar(best + 1);
+}
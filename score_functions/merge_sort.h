@@ -0,0 +1,50 @@
+#ifndef MERGE_SORT_H
+#define MERGE_SORT_H
+
+#include <cstddef>
+
+/*
+ * Kernel of merge_sort.cpp: sum of the top "budget" values of p (walked
+ * in the order of top_ind, 1-based, skipping zeros) merged with q (n
+ * values, descending). p must have enough nonzero entries for budget.
+ */
+
+inline double merge_sort_sum(const double *p, const double *q, size_t n,
+        const double *top_ind, int budget)
+{
+#define P_IND ((int)(top_ind[j]) - 1)
+  double sum = 0;
+  int i = 0, j = 0;
+  size_t k = 0;
+
+  while (p[P_IND] == 0)
+    j++;
+
+  while ((i < budget) && (k < n)) {
+    if (p[P_IND] > q[k]) {
+      sum += p[P_IND];
+      do {
+        j++;
+      } while (p[P_IND] == 0);
+    }
+    else {
+      sum += q[k];
+      k++;
+    }
+
+    i++;
+  }
+
+  while (i < budget) {
+    sum += p[P_IND];
+    do {
+      j++;
+    } while (p[P_IND] == 0);
+
+    i++;
+  }
+#undef P_IND
+  return sum;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "mex.h"
+#include <vector>
+#include "top_sum_index.h"
+
+/*
+ * sum = merge_sort_indexed(p_sorted, cumsum_p, removed_pos, q, budget)
+ *
+ * Same as merge_sort(p, q, top_ind, budget), where p_sorted = p(top_ind)
+ * before zeroing, cumsum_p = cumsum(p_sorted) is computed once per
+ * selection step, and removed_pos are the positions in p_sorted of the
+ * zeroed entries. Costs O(numel(q) log n + numel(removed_pos)) instead
+ * of a walk over p (see top_sum_index.h).
+ */
+
+#define P_ARG       prhs[0]
+#define CUMSUM_ARG  prhs[1]
+#define REMOVED_ARG prhs[2]
+#define Q_ARG       prhs[3]
+#define BUDGET_ARG  prhs[4]
+#define SUM_ARG     plhs[0]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *removed_pos;
+  int budget, num_removed, i;
+
+  if (nrhs < 5)
+    mexErrMsgIdAndTxt("merge_sort_indexed:nargin", "5 inputs required");
+
+  /* get input */
+  Top_sum_index index;
+  top_sum_index_init(index, mxGetPr(P_ARG),
+          (int)mxGetNumberOfElements(P_ARG), mxGetPr(CUMSUM_ARG));
+  removed_pos = mxGetPr(REMOVED_ARG);
+  num_removed = (int)mxGetNumberOfElements(REMOVED_ARG);
+  budget = (int)(mxGetScalar(BUDGET_ARG));
+
+  /* Matlab indices are 1-based */
+  std::vector<int> removed(num_removed);
+  for (i = 0; i < num_removed; i++)
+    removed[i] = (int)removed_pos[i] - 1;
+  std::sort(removed.begin(), removed.end());
+
+  SUM_ARG = mxCreateDoubleScalar(top_sum_index_merged_sum(index,
+          removed.data(), num_removed, mxGetPr(Q_ARG),
+          (int)mxGetNumberOfElements(Q_ARG), budget, NULL));
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "merge_sort.h"
+#include "top_sum_index.h"
+#include "../query_strategies/merge_sum.h"
+
+/*
+ * Checks the indexed merge of top_sum_index.h against the kernels it
+ * replaces: top_sum_index_merged_sum against merge_sort_sum and the cost
+ * from top_sum_index_crossing (as merge_sum_indexed.cpp computes it)
+ * against merge_sum_cost, on probabilities with a few entries removed
+ * (zeroed for the kernels) and a few values q merged in. The values are
+ * multiples of 1/16, so that there are many ties and every sum is exact
+ * and the results must agree to the bit. Returns 1 on failure.
+ */
+
+int main()
+{
+  std::mt19937_64 gen(2019);
+  int trial, errors = 0;
+
+  for (trial = 0; trial < 2000; trial++){
+    int m = 1 + (int)(gen() % 60), nq = (int)(gen() % 8), i, r;
+    int num_removed = (int)(gen() % std::min(m, 6));
+    std::vector<double> p(m + 1), q(nq), sorted(m), zeroed;
+    std::vector<double> top_ind(m + 1);
+    std::vector<int> order(m), removed;
+
+    for (i = 0; i < m; i++)
+      p[i] = (1 + gen() % 16) / 16.0;
+    for (i = 0; i < nq; i++)
+      q[i] = (1 + gen() % 16) / 16.0;
+    std::sort(q.begin(), q.end(), std::greater<double>());
+
+    /*
+     * top_ind = sort(p, 'descend') with a sentinel behind it, smaller
+     * than every q so that the kernels never take it
+     */
+    for (i = 0; i < m; i++)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&p](int a, int b){
+      return p[a] > p[b];
+    });
+    for (i = 0; i < m; i++){
+      sorted[i] = p[order[i]];
+      top_ind[i] = order[i] + 1;
+    }
+    p[m] = 1 / 1024.0;
+    top_ind[m] = m + 1;
+
+    /* distinct removed positions, ascending; zeroed in p for the kernels */
+    zeroed = p;
+    for (i = 0; i < m; i++)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), gen);
+    removed.assign(order.begin(), order.begin() + num_removed);
+    std::sort(removed.begin(), removed.end());
+    for (r = 0; r < num_removed; r++)
+      zeroed[(int)top_ind[removed[r]] - 1] = 0;
+
+    Top_sum_index index;
+    top_sum_index_init(index, sorted.data(), m, NULL);
+
+    int available = m - num_removed;
+    for (int budget = 1; budget <= available + nq; budget++){
+      double last, want, got;
+      /* merge_sort_sum needs a nonzero p to stand on */
+      if (available == 0) break;
+      want = merge_sort_sum(zeroed.data(), q.data(), nq, top_ind.data(),
+              budget);
+      got = top_sum_index_merged_sum(index, removed.data(), num_removed,
+              q.data(), nq, budget, &last);
+      if (got != want){
+        if (errors < 10)
+          printf("trial %d budget %d: merged sum %.17g, want %.17g\n",
+                  trial, budget, got, want);
+        errors++;
+      }
+    }
+
+    for (int goal = 1; goal <= 8; goal++){
+      double utility = 0, last_p = 0, want, got;
+      int count;
+      if (available == 0) break;
+      want = merge_sum_cost(zeroed.data(), m, q.data(), nq, top_ind.data(),
+              goal);
+      count = top_sum_index_crossing(index, removed.data(), num_removed,
+              q.data(), nq, goal, &utility, &last_p);
+      got = count == 0 ? m - 1 : count - (utility - goal) / last_p;
+      if (got != want){
+        if (errors < 10)
+          printf("trial %d goal %d: cost %.17g, want %.17g\n",
+                  trial, goal, got, want);
+        errors++;
+      }
+    }
+  }
+  printf("%d errors\n", errors);
+  return errors > 0;
+}
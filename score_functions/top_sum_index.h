@@ -0,0 +1,154 @@
+#ifndef TOP_SUM_INDEX_H
+#define TOP_SUM_INDEX_H
+
+/*
+ * Index over the current probabilities (sorted in descending order) to
+ * answer the questions asked by merge_sort.cpp and merge_sum.cpp without
+ * walking the whole list:
+ *
+ *   - the sum of the top "budget" values after removing a few entries
+ *     and merging in a few new values q, and
+ *   - how many of those values are needed for their sum to reach a
+ *     remaining goal (the cumulative-sum crossing of merge_sum).
+ *
+ * The index is just the prefix sums of the sorted list (cumsum in
+ * Matlab), built once per selection step. The removed entries are
+ * passed as their ascending positions in the sorted list; since they
+ * are only removed for one query, a sorted list of them is enough to
+ * correct the prefix sums, and no tree has to be updated. A query costs
+ * O(|q| log n + k) for k removed entries.
+ */
+
+#include <algorithm>
+#include <vector>
+
+struct Top_sum_index{
+  int n = 0;
+  const double *sorted = NULL;  /* values in descending order */
+  const double *cumsum = NULL;  /* cumsum[i] = sorted[0] + ... + sorted[i] */
+  std::vector<double> storage;  /* owns cumsum if not given */
+};
+
+inline void top_sum_index_init(Top_sum_index &index, const double *sorted,
+        int n, const double *cumsum)
+{
+  /* cumsum may be NULL, then it is computed here */
+  int i;
+  index.n = n;
+  index.sorted = sorted;
+  if (cumsum == NULL){
+    index.storage.resize(n);
+    double sum = 0;
+    for (i = 0; i < n; i++){
+      sum += sorted[i];
+      index.storage[i] = sum;
+    }
+    cumsum = index.storage.data();
+  }
+  index.cumsum = cumsum;
+}
+
+inline double top_sum_index_remaining_top(const Top_sum_index &index,
+        const int *removed, int num_removed, int count, double *last)
+{
+  /*
+   * sum of the top "count" sorted values that are not removed
+   * (count must not exceed the number of those values); last gets the
+   * smallest of them
+   */
+  int pos = count, r = 0;
+  double sum;
+  if (count <= 0){
+    return 0;
+  }
+  /* smallest pos with pos - #(removed before pos) == count */
+  while (r < num_removed && removed[r] < pos){
+    pos++;
+    r++;
+  }
+  sum = index.cumsum[pos-1];
+  while (r > 0){
+    sum -= index.sorted[removed[--r]];
+  }
+  if (last)
+    *last = index.sorted[pos-1];
+  return sum;
+}
+
+inline int top_sum_index_count_greater(const Top_sum_index &index,
+        const int *removed, int num_removed, double value)
+{
+  /* number of sorted values that are not removed and larger than value */
+  int pos = (int)(std::lower_bound(index.sorted, index.sorted + index.n,
+          value, [](double a, double b){ return a > b; }) - index.sorted);
+  return pos - (int)(std::lower_bound(removed, removed + num_removed, pos) -
+          removed);
+}
+
+inline double top_sum_index_merged_sum(const Top_sum_index &index,
+        const int *removed, int num_removed, const double *q, int nq,
+        int count, double *last)
+{
+  /*
+   * sum of the first "count" values of the sorted list (minus removed)
+   * merged with q (descending), using the same tie rule as merge_sort.cpp
+   * (a sorted value goes first only if it is strictly larger); last
+   * (optional) gets the count-th merged value
+   */
+  int available = index.n - num_removed;
+  int t = 0, from_p;
+  double sum = 0, last_p = 0;
+
+  if (count > available + nq)
+    count = available + nq;
+  if (count <= 0)
+    return 0;
+
+  /* q[t] is at merged position t + #(values larger than q[t]) */
+  while (t < nq &&
+          t + top_sum_index_count_greater(index, removed, num_removed, q[t])
+          < count){
+    sum += q[t];
+    t++;
+  }
+  from_p = count - t;
+  sum += top_sum_index_remaining_top(index, removed, num_removed, from_p,
+          &last_p);
+  if (last){
+    if (from_p == 0)
+      *last = q[t-1];
+    else if (t == 0)
+      *last = last_p;
+    else
+      *last = std::min(q[t-1], last_p);
+  }
+  return sum;
+}
+
+inline int top_sum_index_crossing(const Top_sum_index &index,
+        const int *removed, int num_removed, const double *q, int nq,
+        double goal, double *sum, double *last)
+{
+  /*
+   * smallest count such that the first count merged values sum to at
+   * least goal (0 if they never do), with their sum and the last value
+   */
+  int lo = 1, hi = index.n - num_removed + nq, mid;
+  if (hi <= 0 ||
+          top_sum_index_merged_sum(index, removed, num_removed, q, nq, hi,
+          NULL) < goal)
+    return 0;
+  while (lo < hi){
+    mid = lo + (hi - lo) / 2;
+    if (top_sum_index_merged_sum(index, removed, num_removed, q, nq, mid,
+            NULL) >= goal)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  *sum = top_sum_index_merged_sum(index, removed, num_removed, q, nq, lo,
+          last);
+  return lo;
+}
+
+#endif
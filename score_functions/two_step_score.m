@@ -32,6 +32,16 @@ end
 budget = 1;
 weights(train_ind, :) = 0;
 
+% score all candidates in one call if the native engine is compiled and
+% model is the k-NN model with problem.alpha (see
+% score_functions/ens_scores.cpp), which problem.use_native_ens asserts
+if isfield(problem, 'use_native_ens') && problem.use_native_ens && ...
+    exist('ens_scores', 'file') == 3
+  expected_utilities = current_found + ens_scores(weights, problem.alpha, ...
+    train_ind, observed_labels, test_ind, budget);
+  return;
+end
+
 expected_utilities = zeros(num_test, 1);
 for i = 1:num_test
   this_test_ind = test_ind(i);
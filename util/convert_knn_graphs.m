@@ -0,0 +1,28 @@
+% function convert_knn_graphs(data_names, data_dir)
+%
+% Writes the k-NN graph files (see native/knn_graph_file.h) of the given
+% datasets from their nearest neighbor .mat caches, so later calls of
+% load_data read the graph directly. Needs the save_knn_graph and
+% load_knn_graph mex files.
+%
+% Example: convert_knn_graphs({'citeseer_data', 'ecfp1'}, './data')
+
+function convert_knn_graphs(data_names, data_dir)
+
+if ~exist('data_dir', 'var')
+  data_dir = './data';
+end
+if ischar(data_names)
+  data_names = {data_names};
+end
+if exist('save_knn_graph', 'file') ~= 3 || ...
+    exist('load_knn_graph', 'file') ~= 3
+  error('convert_knn_graphs:mex', ...
+    'compile util/save_knn_graph.cpp and util/load_knn_graph.cpp first');
+end
+
+for i = 1:numel(data_names)
+  tt = tic;
+  load_data(data_names{i}, data_dir);  % writes the graph file if missing
+  fprintf('%s: %.1f sec\n', data_names{i}, toc(tt));
+end
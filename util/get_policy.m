@@ -13,11 +13,8 @@ policy_name = policy.name;
 
 if ismember(policy_name, {'greedy', 'random-greedy'})
   
-  score_function = @(problem, train_ind, observed_labels, test_ind) ...
-    search_expected_utility(problem, train_ind, observed_labels, ...
-    test_ind, model);
-  query_strategy = get_query_strategy(@argmax, score_function, ...
-    batch_size);
+  % the one-step expected utility is the probability itself
+  query_strategy = get_query_strategy(@greedy_batch, model);
   if strcmp(policy_name, 'random-greedy')
     selector    = get_selector(@random_greedy_selector);
   end
@@ -0,0 +1,91 @@
+#include "mex.h"
+#include <vector>
+#include "../native/knn_graph_build.h"
+
+/*
+ * [nearest_neighbors, values] = knn_search(points, k, num_threads)
+ *
+ * Multithreaded replacement for knnsearch(points, points, 'k', k + 1)
+ * (see native/knn_graph_build.h). points is (num_points x d), one point
+ * per row:
+ *
+ *   - double: values are Euclidean distances, ascending;
+ *   - logical (fingerprints): values are Tanimoto similarities,
+ *     descending.
+ *
+ * Both outputs are (num_points x (k + 1)) with the point itself in the
+ * first column (distance 0, similarity 1), so duplicate points never
+ * displace it; ties go to the smaller index. num_threads defaults to all
+ * cores.
+ */
+
+#define POINTS_ARG      prhs[0]
+#define K_ARG           prhs[1]
+#define NUM_THREADS_ARG prhs[2]
+
+#define NEIGHBORS_ARG   plhs[0]
+#define VALUES_ARG      plhs[1]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  mwSize n, d, i, j;
+  int k, num_threads = default_num_threads();
+  bool tanimoto;
+
+  if (nrhs < 2)
+    mexErrMsgIdAndTxt("knn_search:nargin", "points and k required");
+  tanimoto = mxIsLogical(POINTS_ARG);
+  if (mxIsSparse(POINTS_ARG) || (!tanimoto && !mxIsDouble(POINTS_ARG)))
+    mexErrMsgIdAndTxt("knn_search:points",
+            "points must be a full double or logical matrix");
+
+  n = mxGetM(POINTS_ARG);
+  d = mxGetN(POINTS_ARG);
+  k = (int)mxGetScalar(K_ARG);
+  if (nrhs > 2)
+    num_threads = (int)mxGetScalar(NUM_THREADS_ARG);
+  if (k <= 0 || (mwSize)k >= n || n >= 4294967295u)
+    mexErrMsgIdAndTxt("knn_search:k", "need 0 < k < number of points");
+
+  std::vector<uint32_t> neighbors(n * k);
+  std::vector<double> values(n * k);
+
+  /* Matlab is column-major, the search wants one point per row */
+  if (tanimoto){
+    mwSize words = (d + 63) / 64;
+    const mxLogical *x = mxGetLogicals(POINTS_ARG);
+    std::vector<uint64_t> fingerprints(n * words, 0);
+    for (j = 0; j < d; j++){
+      for (i = 0; i < n; i++){
+        if (x[i + j*n])
+          fingerprints[i*words + j/64] |= (uint64_t)1 << (j % 64);
+      }
+    }
+    knn_build_tanimoto(fingerprints.data(), (uint32_t)n, (int)words, k,
+            num_threads, neighbors.data(), values.data());
+  }
+  else {
+    const double *x = mxGetPr(POINTS_ARG);
+    std::vector<double> points(n * d);
+    for (j = 0; j < d; j++){
+      for (i = 0; i < n; i++)
+        points[i*d + j] = x[i + j*n];
+    }
+    knn_build_dense(points.data(), (uint32_t)n, (int)d, k, num_threads,
+            neighbors.data(), values.data());
+  }
+
+  NEIGHBORS_ARG = mxCreateDoubleMatrix(n, k + 1, mxREAL);
+  VALUES_ARG = mxCreateDoubleMatrix(n, k + 1, mxREAL);
+  double *nearest_neighbors = mxGetPr(NEIGHBORS_ARG);
+  double *out = mxGetPr(VALUES_ARG);
+  for (i = 0; i < n; i++){
+    nearest_neighbors[i] = i + 1;
+    out[i] = tanimoto ? 1 : 0;
+    for (j = 0; j < (mwSize)k; j++){
+      nearest_neighbors[i + (j + 1)*n] = neighbors[i*k + j] + 1;
+      out[i + (j + 1)*n] = values[i*k + j];
+    }
+  }
+}
@@ -16,27 +16,34 @@ switch data_name
     % prior probabilities of the two classes
     alpha               = [0.1 0.9];
     
+    k = 50;
+    graph_file = fullfile(data_dir, ...
+      sprintf('%s_k%d.knng', data_name(1:end-1), k));
     nn_file  = sprintf('%s_nearest_neighbors.mat', data_name(1:end-1));
     filename = fullfile(data_dir, nn_file);
+    [weights, nearest_neighbors, similarities, found] = ...
+      read_knn_graph(graph_file, filename);
+    if ~found
+      if exist(filename, 'file')
+        load(filename);
+      else
+        [nearest_neighbors, distances] = ...
+          find_nearest_neighbors(problem.points, max_k);
+        save(filename, 'nearest_neighbors', 'distances');
+      end
+      nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
+      distances = distances(:, 2:(k + 1))';
+      similarities = 1./distances; %exp(-distances.^2/2);
     
-    if exist(filename, 'file')
-      load(filename);
-    else
-      [nearest_neighbors, distances] = ...
-        knnsearch(problem.points, problem.points, ...
-        'k', max_k + 1);
-      save(filename, 'nearest_neighbors', 'distances');
-    end
-    k = 50;
-    nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
-    distances = distances(:, 2:(k + 1))';
-    similarities = 1./distances; %exp(-distances.^2/2);
+      % precompute sparse weight matrix
+      num_points = problem.num_points;
+      row_index = kron((1:num_points)', ones(k, 1));
+      weights = sparse(row_index, nearest_neighbors(:), similarities(:), ...
+        num_points, num_points);
     
-    % precompute sparse weight matrix
-    num_points = problem.num_points;
-    row_index = kron((1:num_points)', ones(k, 1));
-    weights = sparse(row_index, nearest_neighbors(:), similarities(:), ...
-      num_points, num_points);
+      write_knn_graph(graph_file, weights, nearest_neighbors, ...
+        similarities, filename);
+    end
     
     labels = 2*ones(problem.num_points, 1);
     rand_label = (data_name(end) == '1');
@@ -55,39 +62,45 @@ switch data_name
     problem.points      = (1:num_points)';
     problem.num_points  = num_points;
     
+    k = 50;
+    graph_file = fullfile(data_dir, sprintf('citeseer_data_k%d.knng', k));
     filename = fullfile(data_dir, 'citeseer_data_nearest_neigbors.mat');
-    
-    if exist(filename, 'file')
-      load(filename);
-    else
-      [nearest_neighbors, distances] = ...
-        knnsearch(x, x, ...
-        'k', max_k + 1);
+    [weights, nearest_neighbors, similarities, found] = ...
+      read_knn_graph(graph_file, filename);
+    if ~found
+      if exist(filename, 'file')
+        load(filename);
+      else
+        [nearest_neighbors, distances] = ...
+          find_nearest_neighbors(full(double(x)), max_k);
       
-      save(filename, 'nearest_neighbors', 'distances');
-    end
+        save(filename, 'nearest_neighbors', 'distances');
+      end
     
-    %% there are duplicates in the data
-    % e.g. nearest_neighbors(160, 1:2) = [18, 160]
-    % that means x(160,:) and x(18,:) are identical
-    for i = 1:num_points
-      if nearest_neighbors(i, 1) ~= i
-        dup_idx = find(nearest_neighbors(i, 2:end) == i);
-        nearest_neighbors(i, 1+dup_idx) = nearest_neighbors(i, 1);
-        nearest_neighbors(i, 1) = i;
+      %% there are duplicates in the data
+      % e.g. nearest_neighbors(160, 1:2) = [18, 160]
+      % that means x(160,:) and x(18,:) are identical
+      for i = 1:num_points
+        if nearest_neighbors(i, 1) ~= i
+          dup_idx = find(nearest_neighbors(i, 2:end) == i);
+          nearest_neighbors(i, 1+dup_idx) = nearest_neighbors(i, 1);
+          nearest_neighbors(i, 1) = i;
+        end
       end
-    end
 
-    % limit to only top k
-    k = 50;
-    nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
-    % distances = distances(:, 2:(k + 1))';
-    similarities = ones(size(nearest_neighbors));
+      % limit to only top k
+      nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
+      % distances = distances(:, 2:(k + 1))';
+      similarities = ones(size(nearest_neighbors));
     
-    % precompute sparse weight matrix
-    row_index = kron((1:num_points)', ones(k, 1));
-    weights = sparse(row_index, nearest_neighbors(:), 1, ... %1 / distances(:), ...
-      num_points, num_points);
+      % precompute sparse weight matrix
+      row_index = kron((1:num_points)', ones(k, 1));
+      weights = sparse(row_index, nearest_neighbors(:), 1, ... %1 / distances(:), ...
+        num_points, num_points);
+    
+      write_knn_graph(graph_file, weights, nearest_neighbors, ...
+        similarities, filename);
+    end
     
     % create label vector
     labels = 2 * ones(size(x, 1), 1);
@@ -133,36 +146,43 @@ switch data_name
     problem.num_classes = 2;
     problem.num_points  = num_points;
     
+    k = 50;
+    graph_file = fullfile(data_dir, sprintf('bmg_k%d.knng', k));
     filename = fullfile(data_dir, 'bmg_nearest_neighbors.mat');
     %     filename = fullfile(data_dir, 'bmg_nearest_neigbors.mat');
-    
-    if exist(filename, 'file')
-      load(filename, 'nearest_neighbors', 'distances');
-    else
-      [nearest_neighbors, distances] = ...
-        knnsearch(problem.points, problem.points, ...
-        'k', max_k + 1);
+    [weights, nearest_neighbors, similarities, found] = ...
+      read_knn_graph(graph_file, filename);
+    if ~found
+
+      if exist(filename, 'file')
+        load(filename, 'nearest_neighbors', 'distances');
+      else
+        [nearest_neighbors, distances] = ...
+          find_nearest_neighbors(problem.points, max_k);
       
-      % deal with a small number of ties in dataset
-      for i = 1:num_points
-        if (nearest_neighbors(i, 1) ~= i)
-          ind = find(nearest_neighbors(i, :) == i);
-          nearest_neighbors(i, ind) = nearest_neighbors(i, 1);
-          nearest_neighbors(i, 1)   = i;
+        % deal with a small number of ties in dataset
+        for i = 1:num_points
+          if (nearest_neighbors(i, 1) ~= i)
+            ind = find(nearest_neighbors(i, :) == i);
+            nearest_neighbors(i, ind) = nearest_neighbors(i, 1);
+            nearest_neighbors(i, 1)   = i;
+          end
         end
-      end
       
-      save(filename, 'nearest_neighbors', 'distances');
-    end
+        save(filename, 'nearest_neighbors', 'distances');
+      end
 
-    % limit to only top k
-    k = 50;
-    nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
-    similarities = ones(size(nearest_neighbors));
-    % precompute sparse weight matrix
-    row_index = kron((1:num_points)', ones(k, 1));
-    weights = sparse(row_index, nearest_neighbors(:), 1, ...
-      num_points, num_points);
+      % limit to only top k
+      nearest_neighbors = nearest_neighbors(:, 2:(k + 1))';
+      similarities = ones(size(nearest_neighbors));
+      % precompute sparse weight matrix
+      row_index = kron((1:num_points)', ones(k, 1));
+      weights = sparse(row_index, nearest_neighbors(:), 1, ...
+        num_points, num_points);
+    
+      write_knn_graph(graph_file, weights, nearest_neighbors, ...
+        similarities, filename);
+    end
     
     alpha = [0.05, 1];
     
@@ -181,9 +201,16 @@ switch data_name
     
     data_dir = fullfile(data_dir, fingerprint);
     data_path = fullfile(data_dir, filename);
-    load(data_path);
-    
-    num_points = size(nearest_neighbors, 1);
+    k = 100;
+    graph_file = [data_path(1:(end - 4)) sprintf('_k%d.knng', k)];
+    [weights, nearest_neighbors, similarities, found] = ...
+      read_knn_graph(graph_file, data_path);
+    if found
+      num_points = size(weights, 1);
+    else
+      load(data_path);
+      num_points = size(nearest_neighbors, 1);
+    end
     num_active = num_points - num_inactive;
     
     problem.points = (1:num_points)';
@@ -194,16 +221,60 @@ switch data_name
     labels = ones(num_points, 1);
     labels(1:num_inactive) = 2;
     
-    
-    % limit to k-nearest neighbors
-    k = 100;
-    nearest_neighbors = nearest_neighbors(:, 1:k)';
-    similarities      = similarities(:, 1:k)';
-    
-    % precompute sparse weight matrix
-    row_index = kron((1:num_points)', ones(k, 1));
-    weights = sparse(row_index, nearest_neighbors(:), similarities(:), ...
-      num_points, num_points);
+    if ~found
+      % limit to k-nearest neighbors
+      nearest_neighbors = nearest_neighbors(:, 1:k)';
+      similarities      = similarities(:, 1:k)';
+      
+      % precompute sparse weight matrix
+      row_index = kron((1:num_points)', ones(k, 1));
+      weights = sparse(row_index, nearest_neighbors(:), similarities(:), ...
+        num_points, num_points);
+      
+      write_knn_graph(graph_file, weights, nearest_neighbors, ...
+        similarities, data_path);
+    end
 end
 
 problem.max_num_influence = max(sum(weights > 0, 1));  % used for pruning
+problem.alpha = alpha;  % used by the native k-NN model (use_native_ens)
+
+function [weights, nearest_neighbors, similarities, found] = ...
+  read_knn_graph(graph_file, source_file)
+% read the k-NN graph saved by an earlier run (see native/knn_graph_file.h)
+% instead of loading the nearest neighbor cache and calling sparse; a graph
+% built from another version of source_file (the hash in its header does
+% not match the file) is stale and not found, so it gets rebuilt. Without
+% source_file, or a recorded hash, the graph is used as it is.
+found = exist(graph_file, 'file') && exist('load_knn_graph', 'file') == 3;
+if found
+  [weights, nearest_neighbors, similarities, info] = ...
+    load_knn_graph(graph_file, source_file);
+  if info.dataset_hash ~= 0 && info.source_hash ~= 0 && ...
+      info.dataset_hash ~= info.source_hash
+    fprintf('%s is stale (%s changed), rebuilding it\n', graph_file, ...
+      source_file);
+    found = false;
+  end
+end
+if ~found
+  weights = [];
+  nearest_neighbors = [];
+  similarities = [];
+end
+
+function write_knn_graph(graph_file, weights, nearest_neighbors, ...
+  similarities, source_file)
+if exist('save_knn_graph', 'file') == 3
+  save_knn_graph(graph_file, weights, nearest_neighbors, similarities, ...
+    source_file);
+end
+
+function [nearest_neighbors, distances] = find_nearest_neighbors(x, k)
+% knnsearch(x, x, 'k', k + 1), with the native builder when compiled
+% (util/knn_search.cpp); it keeps each point first even with duplicates
+if exist('knn_search', 'file') == 3
+  [nearest_neighbors, distances] = knn_search(x, k);
+else
+  [nearest_neighbors, distances] = knnsearch(x, x, 'k', k + 1);
+end
@@ -0,0 +1,93 @@
+#include "mex.h"
+#include <cstring>
+#include <string>
+#include "../native/knn_graph_file.h"
+
+/*
+ * [weights, nearest_neighbors, similarities, info] = ...
+ *     load_knn_graph(filename, source_file)
+ *
+ * Reads a k-NN graph written by save_knn_graph (or the native tools, see
+ * native/knn_graph_file.h). The file is memory mapped and the sparse
+ * weights are filled with one copy per array, without sorting.
+ * nearest_neighbors and similarities are (k x num_points) as in
+ * load_data.m, padded with zeros for points with fewer than k neighbors;
+ * info has the fields k, dataset_hash (the hash recorded when the graph
+ * was written, 0 if unknown) and source_hash, the hash of source_file
+ * now (0 if it is not given or cannot be read), so that a graph built
+ * from an older version of source_file can be told apart.
+ */
+
+#define FILENAME_ARG    prhs[0]
+#define SOURCE_ARG      prhs[1]
+
+#define WEIGHTS_ARG     plhs[0]
+#define NEIGHBORS_ARG   plhs[1]
+#define SIMILARITY_ARG  plhs[2]
+#define INFO_ARG        plhs[3]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  uint64_t n, k, nnz, i, e;
+  std::string error;
+  Knn_graph_map map;
+
+  if (nrhs < 1)
+    mexErrMsgIdAndTxt("load_knn_graph:nargin", "filename required");
+  if (sizeof(mwIndex) != sizeof(uint64_t))
+    mexErrMsgIdAndTxt("load_knn_graph:index", "64-bit Matlab required");
+
+  char *filename = mxArrayToString(FILENAME_ARG);
+  bool ok = knn_graph_map_open(map, filename, &error);
+  mxFree(filename);
+  if (!ok)
+    mexErrMsgIdAndTxt("load_knn_graph:read", "%s", error.c_str());
+
+  const Knn_graph_view &g = map.view;
+  n = g.num_points;
+  k = g.k;
+  nnz = g.influence_ptr[n];
+
+  WEIGHTS_ARG = mxCreateSparse(n, n, nnz > 0 ? nnz : 1, mxREAL);
+  memcpy(mxGetJc(WEIGHTS_ARG), g.influence_ptr, (n + 1) * sizeof(mwIndex));
+  memcpy(mxGetIr(WEIGHTS_ARG), g.influence_ind, nnz * sizeof(mwIndex));
+  memcpy(mxGetPr(WEIGHTS_ARG), g.influence_val, nnz * sizeof(double));
+
+  if (nlhs > 1){
+    NEIGHBORS_ARG = mxCreateDoubleMatrix(k, n, mxREAL);
+    double *nearest_neighbors = mxGetPr(NEIGHBORS_ARG);
+    for (i = 0; i < n; i++){
+      double *column = nearest_neighbors + i*k;
+      const uint32_t *ind = g.neighbor_ind + g.neighbor_ptr[i];
+      for (e = 0; e < g.neighbor_ptr[i+1] - g.neighbor_ptr[i]; e++)
+        column[e] = ind[e] + 1;
+    }
+  }
+  if (nlhs > 2){
+    SIMILARITY_ARG = mxCreateDoubleMatrix(k, n, mxREAL);
+    double *similarities = mxGetPr(SIMILARITY_ARG);
+    for (i = 0; i < n; i++){
+      memcpy(similarities + i*k, g.neighbor_val + g.neighbor_ptr[i],
+              (g.neighbor_ptr[i+1] - g.neighbor_ptr[i]) * sizeof(double));
+    }
+  }
+  if (nlhs > 3){
+    const char *fields[] = {"k", "dataset_hash", "source_hash"};
+    uint64_t source_hash = 0;
+    if (nrhs > 1 && !mxIsEmpty(SOURCE_ARG)){
+      char *source = mxArrayToString(SOURCE_ARG);
+      if (!knn_graph_hash_file(source, &source_hash))
+        source_hash = 0;
+      mxFree(source);
+    }
+    INFO_ARG = mxCreateStructMatrix(1, 1, 3, fields);
+    mxSetField(INFO_ARG, 0, "k", mxCreateDoubleScalar((double)k));
+    mxArray *hash = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+    *(uint64_t*)mxGetData(hash) = g.dataset_hash;
+    mxSetField(INFO_ARG, 0, "dataset_hash", hash);
+    hash = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+    *(uint64_t*)mxGetData(hash) = source_hash;
+    mxSetField(INFO_ARG, 0, "source_hash", hash);
+  }
+}
@@ -0,0 +1,60 @@
+% function runs = read_experiment_log(path)
+%
+% Reads the log of native/experiment_runner.cpp (see native/experiment.h)
+% into a struct array with one element per experiment:
+%
+%          dataset: name of the dataset (graph_file:label_file)
+%           policy: name of the policy
+%             seed: seed of the experiment
+%        train_ind: initial points (1-based)
+%       chosen_ind: chosen points in order (1-based)
+%    chosen_labels: their labels (1 for targets, 2 otherwise)
+%
+% Example: runs = read_experiment_log('runs.bin');
+%          cost = arrayfun(@(r) numel(r.chosen_ind), runs);
+
+function runs = read_experiment_log(path)
+
+f = fopen(path, 'r', 'ieee-le');
+if f < 0
+  error('read_experiment_log:open', 'cannot open %s', path);
+end
+cleanup = onCleanup(@() fclose(f));
+
+magic = fread(f, [1, 8], '*char');
+header = fread(f, 4, 'uint32=>double');
+if ~strcmp(magic, 'ASRUNLOG') || header(1) ~= 1
+  error('read_experiment_log:format', '%s is not an experiment log', path);
+end
+num_datasets = header(2);
+num_policies = header(3);
+num_runs     = header(4);
+num_rows     = fread(f, 1, 'uint64=>double');
+
+names = cell(num_datasets + num_policies, 1);
+for i = 1:numel(names)
+  len = fread(f, 1, 'uint32=>double');
+  names{i} = fread(f, [1, len], '*char');
+end
+
+dataset     = fread(f, num_runs, 'uint32=>double');
+policy      = fread(f, num_runs, 'uint32=>double');
+seed        = fread(f, num_runs, 'uint64=>double');
+num_initial = fread(f, num_runs, 'uint32=>double');
+offset      = fread(f, num_runs + 1, 'uint64=>double');
+points      = fread(f, num_rows, 'uint32=>double') + 1;
+labels      = fread(f, num_rows, 'uint8=>double');
+labels(labels ~= 1) = 2;
+
+runs = struct('dataset', {}, 'policy', {}, 'seed', {}, 'train_ind', {}, ...
+  'chosen_ind', {}, 'chosen_labels', {});
+for r = 1:num_runs
+  first = offset(r) + 1;
+  chosen = (first + num_initial(r)):offset(r + 1);
+  runs(r).dataset       = names{dataset(r) + 1};
+  runs(r).policy        = names{num_datasets + policy(r) + 1};
+  runs(r).seed          = seed(r);
+  runs(r).train_ind     = points(first:(first + num_initial(r) - 1));
+  runs(r).chosen_ind    = points(chosen);
+  runs(r).chosen_labels = labels(chosen);
+end
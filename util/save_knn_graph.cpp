@@ -0,0 +1,76 @@
+#include "mex.h"
+#include <string>
+#include <vector>
+#include "../native/knn_graph_file.h"
+
+/*
+ * save_knn_graph(filename, weights, nearest_neighbors, similarities, ...
+ *     source_file)
+ *
+ * Writes the k-NN graph built by load_data.m in the binary format of
+ * native/knn_graph_file.h: nearest_neighbors and similarities are
+ * (k x num_points) as in load_data.m, and weights the sparse matrix
+ * built from them. source_file (optional) is the file the graph was
+ * built from; its hash is stored in the header.
+ */
+
+#define FILENAME_ARG    prhs[0]
+#define WEIGHTS_ARG     prhs[1]
+#define NEIGHBORS_ARG   prhs[2]
+#define SIMILARITY_ARG  prhs[3]
+#define SOURCE_ARG      prhs[4]
+
+void mexFunction(int nlhs,       mxArray *plhs[],
+        int nrhs, const mxArray *prhs[]) {
+
+  double *nearest_neighbors, *similarities;
+  uint64_t n, k, i, e;
+  std::string error;
+
+  if (nrhs < 4)
+    mexErrMsgIdAndTxt("save_knn_graph:nargin", "at least 4 inputs required");
+  if (!mxIsSparse(WEIGHTS_ARG))
+    mexErrMsgIdAndTxt("save_knn_graph:weights", "weights must be sparse");
+  if (sizeof(mwIndex) != sizeof(uint64_t))
+    mexErrMsgIdAndTxt("save_knn_graph:index", "64-bit Matlab required");
+
+  /* get input */
+  char *filename = mxArrayToString(FILENAME_ARG);
+  n = mxGetN(WEIGHTS_ARG);
+  k = mxGetM(NEIGHBORS_ARG);
+  if (mxGetN(NEIGHBORS_ARG) != n ||
+          mxGetNumberOfElements(SIMILARITY_ARG) != k * n)
+    mexErrMsgIdAndTxt("save_knn_graph:size",
+            "nearest_neighbors and similarities must be k x num_points");
+  nearest_neighbors = mxGetPr(NEIGHBORS_ARG);
+  similarities = mxGetPr(SIMILARITY_ARG);
+
+  /* neighbor lists, Matlab indices are 1-based */
+  std::vector<uint64_t> neighbor_ptr(n + 1);
+  std::vector<uint32_t> neighbor_ind(k * n);
+  for (i = 0; i <= n; i++)
+    neighbor_ptr[i] = i * k;
+  for (e = 0; e < k * n; e++)
+    neighbor_ind[e] = (uint32_t)nearest_neighbors[e] - 1;
+
+  Knn_graph_view g;
+  g.num_points = n;
+  g.k = k;
+  g.neighbor_ptr = neighbor_ptr.data();
+  g.neighbor_ind = neighbor_ind.data();
+  g.neighbor_val = similarities;
+  g.influence_ptr = (const uint64_t*)mxGetJc(WEIGHTS_ARG);
+  g.influence_ind = (const uint64_t*)mxGetIr(WEIGHTS_ARG);
+  g.influence_val = mxGetPr(WEIGHTS_ARG);
+  if (nrhs > 4 && !mxIsEmpty(SOURCE_ARG)){
+    char *source = mxArrayToString(SOURCE_ARG);
+    if (!knn_graph_hash_file(source, &g.dataset_hash))
+      mexWarnMsgIdAndTxt("save_knn_graph:source", "cannot read %s", source);
+    mxFree(source);
+  }
+
+  bool ok = knn_graph_write(filename, g, &error);
+  mxFree(filename);
+  if (!ok)
+    mexErrMsgIdAndTxt("save_knn_graph:write", "%s", error.c_str());
+}